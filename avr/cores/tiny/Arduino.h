@@ -60,11 +60,13 @@ void init(void);
 
 int main() __attribute__((weak));
 
-void pinMode(uint8_t pinNumber, uint8_t mode);
-void digitalWrite(uint8_t pinNumber, uint8_t val);
-int8_t digitalRead(uint8_t pinNumber);
+/* pinMode(), digitalWrite(), digitalRead() and openDrain() themselves are inline, further down -
+ * these are what they call when the pin isn't known at compile time. */
+void _pinMode(uint8_t pinNumber, uint8_t mode);
+void _digitalWrite(uint8_t pinNumber, uint8_t val);
+int8_t _digitalRead(uint8_t pinNumber);
 /* Copy of the ones on the modern AVR cores I maintain */
-void openDrain(uint8_t pin, uint8_t mode);
+void _openDrain(uint8_t pin, uint8_t mode);
 
 
 
@@ -76,18 +78,61 @@ int analogRead(uint8_t pinNumber);
 #else
   int _analogRead(uint8_t pin);
 #endif
+int analogReadStart(uint8_t pin);
+bool analogReadReady(void);
+int analogReadResult(void);
+/* Errors from analogReadEnh() - same values as on the modern AVR cores, and far outside anything it can read */
+#define ADC_ENH_ERROR_BAD_PIN_OR_CHANNEL  (-2100000000)
+#define ADC_ENH_ERROR_BUSY                (-2100000001)
+#define ADC_ENH_ERROR_RES_TOO_LOW         (-2100000003)
+#define ADC_ENH_ERROR_RES_TOO_HIGH        (-2100000004)
+#define ADC_ENH_ERROR_NOT_SUPPORTED       (-2100000005)
+#define ADC_ENH_ERROR_DISABLED            (-2100000007)
+int32_t analogReadEnh(uint8_t pin, uint8_t res, uint8_t gain);
 void analogReference(uint8_t mode);
-void analogWrite(uint8_t pinNumber, int16_t val);
+void _analogWrite(uint8_t pinNumber, int16_t val);
 
 void setADCDiffMode(bool bipolar);
 void analogGain(uint8_t gain);
 
+/* Continuous sampling - see wiring_analog_stream.c. The trigger is the value for the ADTS bits;
+ * these are the same on every part that has them, 5-7 differ (see the datasheet), and the tiny26
+ * can only free run. */
+#define ADC_TRIGGER_FREE_RUNNING  (0)
+#define ADC_TRIGGER_COMPARATOR    (1)
+#define ADC_TRIGGER_INT0          (2)
+#define ADC_TRIGGER_TIMER0_COMPA  (3)
+#define ADC_TRIGGER_TIMER0_OVF    (4)
+bool analogStreamBegin(const uint8_t *pins, uint8_t pinCount, uint16_t *buffer, uint8_t length, uint8_t trigger, void (*callback)(uint16_t *samples, uint8_t count));
+void analogStreamEnd(void);
+uint8_t analogStreamAvailable(void);
+int analogStreamRead(void);
+
 unsigned long millis(void);
 unsigned long micros(void);
 
 void yield(void);
 void delay(unsigned long);
 
+#if !defined(DISABLEMILLIS)
+  /* Software timers (wiring_timers.c): callbacks run from yield() - so during delay() - and after
+   * each pass through loop(). Both return a handle for timerCancel(), or 0 if all TIMER_POOL_SIZE
+   * timers are in use. If you write your own yield(), call timerDispatch() from it. */
+  #ifndef TIMER_POOL_SIZE
+    #if (RAMEND < 250)
+      #define TIMER_POOL_SIZE 2
+    #elif (RAMEND < 500)
+      #define TIMER_POOL_SIZE 4
+    #else
+      #define TIMER_POOL_SIZE 8
+    #endif
+  #endif
+  uint8_t timerOnce(uint32_t ms, void (*callback)(void));
+  uint8_t timerEvery(uint32_t ms, void (*callback)(void));
+  bool timerCancel(uint8_t handle);
+  void timerDispatch(void);
+#endif
+
 // Shamelessly stolen from @nerdralph's picoCore
 // delays a specified number of microseconds
 // works for clock frequencies of 1Mhz and up
@@ -116,8 +161,11 @@ static inline void delayMicroseconds(uint16_t us)
 unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout);
 unsigned long pulseInLong(uint8_t pin, uint8_t state, unsigned long timeout);
 
-void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val);
-uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder);
+/* shiftOut() and shiftIn() are inline too, and call these unless the pins and bit order are constant */
+void _shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val);
+uint8_t _shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder);
+void shiftOutBuf(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, const uint8_t *buffer, size_t length);
+void shiftInBuf(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t *buffer, size_t length);
 
 void attachInterrupt(uint8_t interrupt, void (*)(void), int mode);
 void detachInterrupt(uint8_t interrupt);
@@ -200,7 +248,7 @@ extern const uint8_t PROGMEM digital_pin_to_timer_PGM[];
   1 for andi 0xF0/0x0F (depending on direction of shift).
 
   So timer number = TOCCn & 0x07, and
-  TOCC mask = TOCCn & 0xF0 >> (TOCCn & 0x08)?4:0
+  TOCC mask = (TOCCn & 0xF0) >> ((TOCCn & 0x08) ? 0 : 4)
 */
 #if defined(TOCPMCOE)
   #define TOCC0  (0x10)
@@ -388,6 +436,27 @@ inline __attribute__((always_inline)) uint8_t check_valid_digital_pin(uint8_t pi
   }
   return 1;
 }
+/* Sets or clears the bits in mask. Where the register is known at compile time and is one of the low 32 I/O registers
+ * (so it has SBI and CBI - true of every PORTx, DDRx and PINx on these parts, but not the x41's PUEx), and mask is a
+ * single bit, that's one atomic instruction; otherwise, interrupts are disabled around the read-modify-write. */
+inline __attribute__((always_inline)) void _ioBitWrite(volatile uint8_t *reg, uint8_t mask, uint8_t set) {
+  if (__builtin_constant_p((uint16_t)reg) && (uint16_t)reg < (0x20 + __SFR_OFFSET) && __builtin_constant_p(mask) && !(mask & (mask - 1))) {
+    if (set) {
+      *reg |= mask;
+    } else {
+      *reg &= ~mask;
+    }
+  } else {
+    uint8_t oldSREG = SREG;
+    cli();
+    if (set) {
+      *reg |= mask;
+    } else {
+      *reg &= ~mask;
+    }
+    SREG = oldSREG;
+  }
+}
 inline __attribute__((always_inline)) void pinModeFast(uint8_t pin, uint8_t mode) {
   check_constant_pin(pin);
   if (pin > 127) {
@@ -495,11 +564,11 @@ inline __attribute__((always_inline)) void digitalWriteFast(uint8_t pin, uint8_t
       }
     } else {                          // total subtotal 8/10 in 5/9
       if (*mode & mask) {             // 1/1
-        *out &= ~mask;                // 1/1
+        *out |= mask;                 // 1/1
       } else {                        // 1/1 in 2
         uint8_t oldSREG = SREG;       // 1/1
         cli();                        // 1/1
-        *pue &= ~mask;                // 3/5 in 5
+        *pue |= mask;                 // 3/5 in 5
         SREG = oldSREG;               // 1/1
       }                               // 17 instruction, 21 word, and and execution time of 8-12 clocks?
                                       // A whole new definition of fast (now it means "slow") - who wants to inline that!?
@@ -512,8 +581,8 @@ inline __attribute__((always_inline)) void digitalWriteFast(uint8_t pin, uint8_t
       *pue &= ~mask;                  // 1/1
       *out &= ~mask;                  // 1/1
     } else {                          // 1/1
-      *pue &= ~mask;                  // 1/1
-      *out &= ~mask;                  // 1/1
+      *pue |= mask;                   // 1/1
+      *out |= mask;                   // 1/1
     }
       // constant pin -> constant out register.
       // constant val -> constant mask. Combined with above means we will get CBI/SBI (only one bit at a time will be set in the mask
@@ -521,7 +590,7 @@ inline __attribute__((always_inline)) void digitalWriteFast(uint8_t pin, uint8_t
     if (val == LOW) {
       *out &= ~mask;                  // 1/1
     } else {                          // 1/1
-      *out &= ~mask;                  // 1/1
+      *out |= mask;                   // 1/1
     }   // and we know which one at compile time, so
   #endif
 }
@@ -556,6 +625,520 @@ inline __attribute__((always_inline)) void digitalWriteFast(uint8_t pin, uint8_t
   }
 #endif
 
+/* Several pins or a whole port at once
+ *
+ * digitalReadPort(port) - returns PINx for port PA, PB, PC or PD (as from digitalPinToPort()), 0 for NOT_A_PORT
+ * portWrite(port, value, mask) - sets the bits of PORTx that are set in mask to the corresponding bits of value, in one
+ *      atomic read-modify-write (just an SBI or CBI if port, value and mask are constant and mask is a single bit). Like
+ *      digitalWrite(), on parts with PUEx registers, the pullups of the masked bits are set to match.
+ * digitalWriteMulti(pins, count, values) - digitalWrite(pins[i], bit i of values) for i < count, except that it's only one
+ *      portWrite() per port - when the pins and count are constant, the pin tables are looked up at compile time, leaving
+ *      just those writes. PWM is turned off on any of the pins that have it, as with digitalWrite().
+ */
+inline __attribute__((always_inline)) uint8_t digitalReadPort(uint8_t port) {
+  if (port == NOT_A_PORT) return 0;
+  return *portInputRegister(port);
+}
+
+inline __attribute__((always_inline)) void portWrite(uint8_t port, uint8_t value, uint8_t mask) {
+  if (port == NOT_A_PORT || mask == 0) return;
+  volatile uint8_t *out = portOutputRegister(port);
+  #if defined(PUEA)
+    volatile uint8_t *pue = portPullupRegister(port);
+  #endif
+  if (__builtin_constant_p(port) && __builtin_constant_p(value) && __builtin_constant_p(mask) && !(mask & (mask - 1))) {
+    // one bit to a register we know - SBI/CBI
+    #if defined(PUEA)
+      _ioBitWrite(pue, mask, value & mask);
+    #endif
+    _ioBitWrite(out, mask, value & mask);
+  } else {
+    value &= mask;
+    uint8_t oldSREG = SREG;
+    cli();
+    #if defined(PUEA)
+      *pue = (*pue & ~mask) | value;
+    #endif
+    *out = (*out & ~mask) | value;
+    SREG = oldSREG;
+  }
+}
+
+void turnOffPWM(uint8_t timer);
+
+/* turnOffPWM() itself, so that with a constant timer, it comes down to clearing the one COM bit. */
+inline __attribute__((always_inline)) void turnOffPWMFast(uint8_t timer) {
+  #if defined(TOCPMCOE)
+    // No need to change the timer, just flip the bit in TOCPMCOE
+    if (timer) {                          //          All PWM on these parts is controlled like this (unlike the x7)
+      uint8_t bitmask = timer & 0xF0;     // mov andi Copy the portion that contains the bitmask;
+      if (!(timer & 0x08)) {              // sbrs     0x08 is set for the higher 4 bits, so we want to swap only if it's not set
+        if (__builtin_constant_p(bitmask)) {
+          bitmask >>= 4;                  //          the compiler can't see through the swap
+        } else {
+          _SWAP(bitmask);                 // swp
+        }
+      }
+      TOCPMCOE &= ~bitmask;               // com, sts
+    }
+  #else
+
+    #if defined(TCCR0A) && defined(COM0A1)
+      if( timer == TIMER0A) {
+        TCCR0A &= ~(1 << COM0A1);
+        // TCCR0A &= ~(1 << COM0A0); /* We do not clean up after user code that may have shat on a timer. */
+      } else
+    #endif
+    #if defined(TCCR0A) && defined(COM0B1)
+      if( timer == TIMER0B){
+        TCCR0A &= ~(1 << COM0B1);
+        // TCCR0A &= ~(1 << COM0B0); /* We do not clean up after user code that may have shat on a timer. */
+      } else
+    #endif
+    #ifdef __AVR_ATtinyX7__
+      if (timer & 0xF1) {               // It's one of the flex pins on timer1
+      // Timer1 on x7                   // Likely implementation:
+      uint8_t bitmask = timer & 0xF0;   // mov, andi
+      if (!(timer & 0x04)){             // sbrs
+        if (__builtin_constant_p(bitmask)) {
+          bitmask >>= 4;
+        } else {
+          _SWAP(bitmask);               // swp
+        }
+      }
+        TCCR1D &= (~bitmask);           // com, sts
+      }
+      // Using the swp instruction results in MUCH better code. The old way had a variable shift, which gets implemented as a tiny loop.
+      // Not terrible on code size or anything, but it can add two microseconds to execution time - unlike the modern AVRs where this
+      // function takes forever and a day to return, on classic parts, turnOffPWM otherwise takes **maybe** a microsecond.
+    #elif defined(TCCR1E)
+      // ATtiny x61
+      if( timer == TIMER1A) {
+        // disconnect pwm to pin on timer 1, channel A
+        TCCR1C &= ~(1 << COM1A1S);
+      } else if (timer == TIMER1B) {
+        // disconnect pwm to pin on timer 1, channel B
+        TCCR1C &= ~(1 << COM1B1S);
+      } else if (timer == TIMER1D) {
+        // disconnect pwm to pin on timer 1, channel D
+        TCCR1C &= ~(1 << COM1D1);
+      } else
+    #else
+      // Timer1 for non-x61/x7
+      #if defined(TCCR1) && defined(COM1A1) // x5
+        if(timer == TIMER1A) {
+          TCCR1 &= ~(1 << COM1A1);
+        } else
+      #endif
+      #if defined(TCCR1) && defined(COM1B1) // x5
+        if(timer == TIMER1B) {
+          GTCCR &= ~(1 << COM1B1);
+        } else
+      #endif
+      #if defined(TCCR1A) && defined(COM1A1) // civilized parts
+        if(timer == TIMER1A) {
+          TCCR1A &= ~(1 << COM1A1);
+        } else
+      #endif
+
+      #if defined(TCCR1A) && defined(COM1B1) // civilized parts
+        if(timer == TIMER1B) {
+          TCCR1A &= ~(1 << COM1B1);
+        } else
+      #endif
+    #endif
+    {
+      // dummy block to fill in the else statement
+    }
+  #endif
+}
+
+void turnOnPWM(uint8_t timer);
+volatile uint8_t *timerToOCR(uint8_t timer);
+uint8_t _pwmAttach(uint8_t pin);
+
+/* The reverse of turnOffPWMFast(): connects the compare output to the pin. */
+inline __attribute__((always_inline)) void turnOnPWMFast(uint8_t timer) {
+  #if defined(TOCPMCOE)
+    if (timer) {
+      uint8_t bitmask = timer & 0xF0;
+      if (!(timer & 0x08)) {
+        if (__builtin_constant_p(bitmask)) {
+          bitmask >>= 4;
+        } else {
+          _SWAP(bitmask);
+        }
+      }
+      TOCPMCOE |= bitmask;
+    }
+  #else
+    #if defined(TCCR0A) && defined(COM0A1)
+      if (timer == TIMER0A) {
+        TCCR0A |= (1 << COM0A1);
+      } else
+    #endif
+    #if defined(TCCR0A) && defined(COM0B1)
+      if (timer == TIMER0B) {
+        TCCR0A |= (1 << COM0B1);
+      } else
+    #endif
+    #ifdef __AVR_ATtinyX7__
+      if (timer & 0xF0) {               // the COM1xn bits are set in init(), so it's just the output enable bit
+        uint8_t bitmask = timer & 0xF0;
+        if (!(timer & 0x04)) {
+          if (__builtin_constant_p(bitmask)) {
+            bitmask >>= 4;
+          } else {
+            _SWAP(bitmask);
+          }
+        }
+        TCCR1D |= bitmask;
+      }
+    #elif defined(TCCR1E)
+      // ATtiny x61
+      if (timer == TIMER1A) {
+        TCCR1C |= (1 << COM1A1S);
+      } else if (timer == TIMER1B) {
+        TCCR1C |= (1 << COM1B1S);
+      } else if (timer == TIMER1D) {
+        TCCR1C |= (1 << COM1D1);
+      } else
+    #else
+      #if defined(TCCR1) && defined(COM1A1) // x5
+        if (timer == TIMER1A) {
+          TCCR1 |= (1 << COM1A1);
+        } else
+      #endif
+      #if defined(TCCR1) && defined(COM1B1) // x5
+        if (timer == TIMER1B) {
+          GTCCR |= (1 << COM1B1);
+        } else
+      #endif
+      #if defined(TCCR1A) && defined(COM1A1)
+        if (timer == TIMER1A) {
+          TCCR1A |= (1 << COM1A1);
+        } else
+      #endif
+      #if defined(TCCR1A) && defined(COM1B1)
+        if (timer == TIMER1B) {
+          TCCR1A |= (1 << COM1B1);
+        } else
+      #endif
+    #endif
+    {
+    }
+  #endif
+}
+
+/* The (low byte of the) compare register behind a timer from digitalPinToTimer(). For NOT_ON_TIMER, a byte of RAM
+ * that nothing reads, so that a write through it always goes somewhere harmless. */
+extern volatile uint8_t _pwm_nowhere[2];
+
+inline __attribute__((always_inline)) volatile uint8_t *timerToOCRFast(uint8_t timer) {
+  switch (timer & 0x07) { // the rest is the output enable bit on the x41, 828 and x7
+    #if defined(OCR0A)
+      case TIMER0A:
+        return &OCR0A;
+    #endif
+    #if defined(OCR0B)
+      case TIMER0B:
+        return &OCR0B;
+    #endif
+    #if defined(OCR1AL)
+      case TIMER1A:
+        return &OCR1AL;
+      case TIMER1B:
+        return &OCR1BL;
+    #else
+      case TIMER1A:
+        return &OCR1A;
+      case TIMER1B:
+        return &OCR1B;
+    #endif
+    #if defined(OCR2AL)
+      case TIMER2A:
+        return &OCR2AL;
+      case TIMER2B:
+        return &OCR2BL;
+    #endif
+    #if defined(OCR1D)
+      case TIMER1D:
+        return &OCR1D;
+    #endif
+  }
+  return _pwm_nowhere;
+}
+
+/* Whether the timer's compare registers are 16 bits. Writing just the low byte of one of those would write the
+ * high byte from the timer's TEMP register, which any other 16-bit access to the timer leaves behind. */
+inline __attribute__((always_inline)) bool timerIs16Bit(uint8_t timer) {
+  #if defined(OCR1AH)
+    return (timer & 0x07) >= TIMER1A; // Timer1, or Timer2 on the x41
+  #else
+    (void) timer;
+    return false;
+  #endif
+}
+
+/* digitalPinToTimer(), but NOT_ON_TIMER for the x41's pins with a TOCC number and no channel assigned, and the Timer0
+ * channels when tickless millis has that timer to itself */
+inline __attribute__((always_inline)) uint8_t digitalPinToPWMTimer(uint8_t pin) {
+  uint8_t timer = digitalPinToTimer(pin);
+  uint8_t channel = timer & 0x07;
+  #if defined(MILLIS_TICKLESS)
+    // Timer0 is a plain counter for tickless millis, and compare channel A is the delay() deadline.
+    if (channel == TIMER0A || channel == TIMER0B) {
+      channel = NOT_ON_TIMER;
+    }
+  #endif
+  return (channel == NOT_ON_TIMER ? NOT_ON_TIMER : timer);
+}
+
+/* Writes the compare register, without disturbing TEMP for anything interrupted - a single STS for 8 bit timers. */
+inline __attribute__((always_inline)) void _pwmWriteOCR(uint8_t timer, volatile uint8_t *ocr, uint16_t val) {
+  if (timerIs16Bit(timer)) {
+    uint8_t oldSREG = SREG;
+    cli();
+    ocr[1] = val >> 8;
+    ocr[0] = val;
+    SREG = oldSREG;
+  #if defined(TC1H)
+  } else if ((timer == TIMER1A || timer == TIMER1B || timer == TIMER1D) && (val >> 8)) {
+    // x61: the high bits of Timer1's 10-bit registers go through TC1H, which is otherwise kept 0
+    uint8_t oldSREG = SREG;
+    cli();
+    TC1H = val >> 8;
+    *ocr = val;
+    TC1H = 0;
+    SREG = oldSREG;
+  #endif
+  } else {
+    *ocr = val;
+  }
+}
+
+void _digitalWriteMulti(const uint8_t *pins, uint8_t count, uint32_t values);
+
+inline __attribute__((always_inline)) void digitalWriteMulti(const uint8_t *pins, uint8_t count, uint32_t values) {
+  if (!(__builtin_constant_p(count) && count && __builtin_constant_p(pins[0]) && __builtin_constant_p(pins[count - 1]))) {
+    _digitalWriteMulti(pins, count, values);
+    return;
+  }
+  // Everything below is folded at compile time, except for the writes themselves and turning off PWM
+  uint8_t mask[PD + 1] = {0};
+  uint8_t value[PD + 1] = {0};
+  #pragma GCC unroll 32
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t pin = pins[i];
+    if (pin > 127) {
+      pin = analogInputToDigitalPin((pin & 127));
+    }
+    check_valid_digital_pin(pin);
+    uint8_t port = digitalPinToPort(pin);
+    if (port == NOT_A_PORT) continue;
+    uint8_t timer = digitalPinToTimer(pin);
+    if (timer != NOT_ON_TIMER) turnOffPWMFast(timer);
+    mask[port] |= digitalPinToBitMask(pin);
+    if (values & ((uint32_t)1 << i)) {
+      value[port] |= digitalPinToBitMask(pin);
+    }
+  }
+  #pragma GCC unroll 4
+  for (uint8_t port = PA; port <= PD; port++) {
+    portWrite(port, value[port], mask[port]);
+  }
+}
+
+/* The standard digital I/O functions. Given a constant pin, the pin tables are looked up at compile time, and what's
+ * left is the same SBI/CBI (or SBIC/SBIS) the Fast versions use - plus, for digitalWrite() and openDrain() on a pin
+ * that has PWM, clearing its COM bit - so digitalWrite(PIN_PA3, HIGH) on a pin without PWM is a single instruction.
+ * Only when the pin isn't known at compile time (or, for pinMode(), the mode) are the functions in wiring_digital.c
+ * called. Unlike the Fast versions, NOT_A_PIN is accepted (and ignored) either way, and PWM is turned off.
+ */
+inline __attribute__((always_inline)) void pinMode(uint8_t pin, uint8_t mode) {
+  if (!(__builtin_constant_p(pin) && __builtin_constant_p(mode))) {
+    _pinMode(pin, mode);
+    return;
+  }
+  if (pin == NOT_A_PIN) return;
+  if (pin > 127) {
+    pin = analogInputToDigitalPin((pin & 127));
+  }
+  if (!check_valid_digital_pin(pin)) return;
+  uint8_t mask = digitalPinToBitMask(pin);
+  uint8_t port = digitalPinToPort(pin);
+  #if defined(PUEA)
+    volatile uint8_t *out = portPullupRegister(port);
+  #else
+    volatile uint8_t *out = portOutputRegister(port);
+  #endif
+  if (mode == INPUT || mode == INPUT_PULLUP) {
+    _ioBitWrite(portModeRegister(port), mask, 0);
+    _ioBitWrite(out, mask, mode == INPUT_PULLUP);
+  } else {
+    _ioBitWrite(portModeRegister(port), mask, 1);
+  }
+}
+
+inline __attribute__((always_inline)) void digitalWrite(uint8_t pin, uint8_t val) {
+  if (!__builtin_constant_p(pin)) {
+    _digitalWrite(pin, val);
+    return;
+  }
+  if (pin == NOT_A_PIN) return;
+  if (pin > 127) {
+    pin = analogInputToDigitalPin((pin & 127));
+  }
+  if (!check_valid_digital_pin(pin)) return;
+  uint8_t timer = digitalPinToTimer(pin);
+  if (timer != NOT_ON_TIMER) turnOffPWMFast(timer);
+  uint8_t mask = digitalPinToBitMask(pin);
+  uint8_t port = digitalPinToPort(pin);
+  #if defined(PUEA)
+    _ioBitWrite(portPullupRegister(port), mask, val != LOW);
+  #endif
+  _ioBitWrite(portOutputRegister(port), mask, val != LOW);
+}
+
+inline __attribute__((always_inline)) void openDrain(uint8_t pin, uint8_t val) {
+  if (!__builtin_constant_p(pin)) {
+    _openDrain(pin, val);
+    return;
+  }
+  if (pin == NOT_A_PIN) return;
+  if (pin > 127) {
+    pin = analogInputToDigitalPin((pin & 127));
+  }
+  if (!check_valid_digital_pin(pin)) return;
+  uint8_t timer = digitalPinToTimer(pin);
+  if (timer != NOT_ON_TIMER) turnOffPWMFast(timer);
+  uint8_t mask = digitalPinToBitMask(pin);
+  uint8_t port = digitalPinToPort(pin);
+  _ioBitWrite(portOutputRegister(port), mask, 0);
+  _ioBitWrite(portModeRegister(port), mask, val == LOW);
+}
+
+inline __attribute__((always_inline)) int8_t digitalRead(uint8_t pin) {
+  if (!__builtin_constant_p(pin)) {
+    return _digitalRead(pin);
+  }
+  if (pin == NOT_A_PIN) return NOT_A_PIN;
+  if (pin > 127) {
+    pin = analogInputToDigitalPin((pin & 127));
+  }
+  if (!check_valid_digital_pin(pin)) return NOT_A_PIN;
+  return (*portInputRegister(digitalPinToPort(pin)) & digitalPinToBitMask(pin)) ? HIGH : LOW;
+}
+
+/* analogWrite() - given a constant pin with PWM, this is the store to its compare register, setting its COM bit and
+ * setting the pin OUTPUT: the same thing _analogWrite() does, less the table lookups and the search for the
+ * register. val of 0 or 255 and up is digitalWrite() LOW or HIGH, as usual.
+ */
+inline __attribute__((always_inline)) void analogWrite(uint8_t pin, int16_t val) {
+  if (!__builtin_constant_p(pin)) {
+    _analogWrite(pin, val);
+    return;
+  }
+  // No stupid exception here - nobody analogWrite()'s to pins that don't exist!
+  if (pin >= NUM_DIGITAL_PINS) badArg("analogWrite to constant pin number that is not a valid pin");
+  uint8_t timer = digitalPinToPWMTimer(pin);
+  if (val <= 0 || (timer == NOT_ON_TIMER && val < 128)) {
+    digitalWrite(pin, LOW);
+  } else if (val >= 255 || timer == NOT_ON_TIMER) {
+    digitalWrite(pin, HIGH);
+  } else {
+    _pwmWriteOCR(timer, timerToOCRFast(timer), val);
+    turnOnPWMFast(timer);
+  }
+  pinMode(pin, OUTPUT);
+}
+
+/* shiftOut(dataPin, clockPin, bitOrder, val) and shiftIn(dataPin, clockPin, bitOrder)
+ *
+ * With constant pins and bit order, these are unrolled into SBI/CBI (and SBIC/SBIS) on the two pins - around 9 clocks
+ * a bit, rather than well over 100 through digitalWrite() - at a cost of roughly 50 words of flash per call. PWM
+ * is turned off on either pin first, like digitalWrite() would. shiftIn() raises the clock, waits 2 clocks for the
+ * device to respond, reads the bit, and lowers the clock again.
+ * If the pins are the data out (or in) and clock pins of the SPI module - or of the USI, on parts without SPI - and
+ * that isn't in use (SPI.begin() hasn't been called), the out-of-line versions use its shift register instead, at
+ * F_CPU/2 out and F_CPU/4 in; so do shiftOutBuf() and shiftInBuf(), which shift out or in length bytes, buffer[0]
+ * first, for daisy chained shift registers.
+ */
+#if defined(SPDR)
+  #define SHIFT_HW_DO   MOSI
+  #define SHIFT_HW_DI   MISO
+  #define SHIFT_HW_SCK  SCK
+#elif defined(USIDR)
+  #define SHIFT_HW_DO   USI_DO
+  #define SHIFT_HW_DI   USI_DI
+  #define SHIFT_HW_SCK  USI_SCK
+#endif
+
+inline __attribute__((always_inline)) void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val) {
+  if (!(__builtin_constant_p(dataPin) && __builtin_constant_p(clockPin) && __builtin_constant_p(bitOrder))
+    #if defined(SHIFT_HW_DO)
+      || (dataPin == SHIFT_HW_DO && clockPin == SHIFT_HW_SCK)
+    #endif
+    ) {
+    _shiftOut(dataPin, clockPin, bitOrder, val);
+    return;
+  }
+  if (dataPin == NOT_A_PIN || clockPin == NOT_A_PIN) return;
+  if (dataPin > 127) {
+    dataPin = analogInputToDigitalPin((dataPin & 127));
+  }
+  if (clockPin > 127) {
+    clockPin = analogInputToDigitalPin((clockPin & 127));
+  }
+  if (!check_valid_digital_pin(dataPin) || !check_valid_digital_pin(clockPin)) return;
+  if (digitalPinToTimer(dataPin) != NOT_ON_TIMER) turnOffPWMFast(digitalPinToTimer(dataPin));
+  if (digitalPinToTimer(clockPin) != NOT_ON_TIMER) turnOffPWMFast(digitalPinToTimer(clockPin));
+  volatile uint8_t *dout = portOutputRegister(digitalPinToPort(dataPin));
+  volatile uint8_t *cout = portOutputRegister(digitalPinToPort(clockPin));
+  uint8_t dmask = digitalPinToBitMask(dataPin);
+  uint8_t cmask = digitalPinToBitMask(clockPin);
+  #pragma GCC unroll 8
+  for (uint8_t i = 0; i < 8; i++) {
+    _ioBitWrite(dout, dmask, val & (bitOrder == LSBFIRST ? (1 << i) : (0x80 >> i)));
+    _ioBitWrite(cout, cmask, 1);
+    _ioBitWrite(cout, cmask, 0);
+  }
+}
+
+inline __attribute__((always_inline)) uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder) {
+  if (!(__builtin_constant_p(dataPin) && __builtin_constant_p(clockPin) && __builtin_constant_p(bitOrder))
+    #if defined(SHIFT_HW_DI)
+      || (dataPin == SHIFT_HW_DI && clockPin == SHIFT_HW_SCK)
+    #endif
+    ) {
+    return _shiftIn(dataPin, clockPin, bitOrder);
+  }
+  if (dataPin == NOT_A_PIN || clockPin == NOT_A_PIN) return 0;
+  if (dataPin > 127) {
+    dataPin = analogInputToDigitalPin((dataPin & 127));
+  }
+  if (clockPin > 127) {
+    clockPin = analogInputToDigitalPin((clockPin & 127));
+  }
+  if (!check_valid_digital_pin(dataPin) || !check_valid_digital_pin(clockPin)) return 0;
+  if (digitalPinToTimer(clockPin) != NOT_ON_TIMER) turnOffPWMFast(digitalPinToTimer(clockPin));
+  volatile uint8_t *din  = portInputRegister(digitalPinToPort(dataPin));
+  volatile uint8_t *cout = portOutputRegister(digitalPinToPort(clockPin));
+  uint8_t dmask = digitalPinToBitMask(dataPin);
+  uint8_t cmask = digitalPinToBitMask(clockPin);
+  uint8_t value = 0;
+  #pragma GCC unroll 8
+  for (uint8_t i = 0; i < 8; i++) {
+    _ioBitWrite(cout, cmask, 1);
+    _NOP2();
+    if (*din & dmask) {
+      value |= (bitOrder == LSBFIRST ? (1 << i) : (0x80 >> i));
+    }
+    _ioBitWrite(cout, cmask, 0);
+  }
+  return value;
+}
+
 #ifdef __cplusplus
   } // extern "C"
 #endif
@@ -576,6 +1159,51 @@ inline __attribute__((always_inline)) void digitalWriteFast(uint8_t pin, uint8_t
   void tone(uint8_t _pin, unsigned long frequency, unsigned long duration = 0);
   void noTone(uint8_t _pin = 255);
 
+  /* PWM through a handle: pwmAttach() looks up the pin's timer and compare register, connects it to the pin and sets
+   * the pin OUTPUT, once; after that, write() is just a store of the compare value - one instruction on an 8-bit
+   * timer. Unlike analogWrite(), 0 and 255 are compare values too: 255 is always on, but in fast PWM, which Timer0
+   * uses, 0 still gives a pulse 1/256 long - use detach() and digitalWrite() to turn the pin off. write16() is for
+   * Timer1 with a TOP above 255 (the x61's 10-bit mode, or a 16-bit Timer1 set up for it). On a pin without PWM,
+   * attached() is false, and writes go nowhere. */
+  class PwmChannel {
+    public:
+      PwmChannel() : _ocr(_pwm_nowhere), _timer(NOT_ON_TIMER) {}
+      inline __attribute__((always_inline)) PwmChannel(uint8_t timer, volatile uint8_t *ocr) : _ocr(ocr), _timer(timer) {}
+      inline __attribute__((always_inline)) void write(uint8_t duty) {
+        _pwmWriteOCR(_timer, _ocr, duty);
+      }
+      inline __attribute__((always_inline)) void write16(uint16_t duty) {
+        _pwmWriteOCR(_timer, _ocr, duty);
+      }
+      inline __attribute__((always_inline)) void detach() {
+        if (__builtin_constant_p(_timer)) {
+          turnOffPWMFast(_timer);
+        } else {
+          turnOffPWM(_timer);
+        }
+      }
+      bool attached() const { return _timer != NOT_ON_TIMER; }
+      uint8_t timer() const { return _timer; }
+    private:
+      volatile uint8_t *_ocr;
+      uint8_t _timer;
+  };
+
+
+  inline __attribute__((always_inline)) PwmChannel pwmAttach(uint8_t pin) {
+    if (!__builtin_constant_p(pin)) {
+      uint8_t timer = _pwmAttach(pin);
+      return PwmChannel(timer, timerToOCR(timer));
+    }
+    if (pin >= NUM_DIGITAL_PINS) badArg("pwmAttach to constant pin number that is not a valid pin");
+    uint8_t timer = digitalPinToPWMTimer(pin);
+    if (timer != NOT_ON_TIMER) {
+      turnOnPWMFast(timer);
+      pinMode(pin, OUTPUT);
+    }
+    return PwmChannel(timer, timerToOCRFast(timer));
+  }
+
   // WMath prototypes
   long random(long);
   long random(long, long);
@@ -37,29 +37,11 @@
   //from here on out we rely on the normalized register names!
 
 
-  // Constructors ////////////////////////////////////////////////////////////////
-
-  HardwareSerial::HardwareSerial(ring_buffer *rx_buffer, ring_buffer *tx_buffer
-  #if ( defined(UBRRH) || defined(UBRR0H) || defined(UBRR1H))
-    ,volatile uint8_t *ubrrh, volatile uint8_t *ubrrl,
-    volatile uint8_t *ucsra, volatile uint8_t *ucsrb,
-    volatile uint8_t *udr) {
-    _rx_buffer = rx_buffer;
-    _tx_buffer = tx_buffer;
-  }
-  #else
-  ) {
-    _rx_buffer = rx_buffer;
-    _tx_buffer = tx_buffer;
-  }
-  #endif
-
-
-  // Public Methods //////////////////////////////////////////////////////////////
-
-  void HardwareSerial::begin(long baud) {
+  // Only for a baud rate that isn't known at compile time; otherwise begin() uses serial_baud().
+  serial_baud_t serial_baud_runtime(uint32_t baud) {
+    serial_baud_t setting;
+    setting.error = 0; // not worked out
   #if (defined(UBRR0H) || defined(UBRR1H))
-    uint16_t baud_setting;
     bool use_u2x = true;
   /*
   #if F_CPU == 16000000UL
@@ -75,21 +57,40 @@
   try_again:
 
     if (use_u2x) {
-      *_ucsra = _u2x;
-      baud_setting = (F_CPU / 4 / baud - 1) / 2;
+      setting.mode = _u2x;
+      setting.brr = (F_CPU / 4 / baud - 1) / 2;
     } else {
-      baud_setting = (F_CPU / 8 / baud - 1) / 2;
+      setting.mode = 0;
+      setting.brr = (F_CPU / 8 / baud - 1) / 2;
     }
 
-    if ((baud_setting > 4095) && use_u2x) {
+    if ((setting.brr > 4095) && use_u2x) {
       use_u2x = false;
       goto try_again;
     }
+  #else
+    setting.mode = 16;
+    setting.brr = (((F_CPU * 10L / 16L / baud) + 5L) / 10L) - 1;
+  #endif
+    return setting;
+  }
+
+  // begin() only calls this where it has something to warn about, and then it need only exist.
+  void badBaud() {}
+
+  // Public Methods //////////////////////////////////////////////////////////////
+
+  template <uint8_t PORT>
+  void HardwareSerialT<PORT>::_begin(uint16_t brr, uint8_t mode) {
+  #if (defined(UBRR0H) || defined(UBRR1H))
+    port::ucsra() = mode; // U2X, or not
     // assign the baud_setting, a.k.a. ubbr (USART Baud Rate Register)
-    *_ubrrh = baud_setting >> 8;
-    *_ubrrl = baud_setting;
-    *_ucsrb = (_rxen | _txen | _rxcie);
+    port::ubrrh() = brr >> 8;
+    port::ubrrl() = brr;
+    port::ucsrb() = (_rxen | _txen | _rxcie);
 
+    // When the registers were pointers in the object, it looked like what follows; now that they come
+    // from SerialPort<PORT>, each of these is a single sts (or an out), and the bits are constants.
     // For fucks sake, the USART registers aren't in low I/O space!
     // Even if they WERE, SBI and CBI only work when both arguments are compiletimne known
     // here they *would* be except that classes completely stymie LTO. the 4 lines of SBI and CBI that were here got turned into this:
@@ -152,8 +153,8 @@
     */
   #else
     LINCR = (1 << LSWRES);
-    LINBRR = (((F_CPU * 10L / 16L / baud) + 5L) / 10L) - 1;
-    LINBTR = (1 << LDISR) | (16 << LBT0);
+    LINBRR = brr;
+    LINBTR = (1 << LDISR) | (mode << LBT0);
     LINCR = _BV(LENA) | _BV(LCMD2) | _BV(LCMD1) | _BV(LCMD0);
     LINENIR =_BV(LENRXOK);
   #endif
@@ -161,10 +162,9 @@
 
   }
 
-  void HardwareSerial::end() {
-    while (_tx_buffer->head != _tx_buffer->tail) {
-      ; // wait for buffer to end.
-    }
+  template <uint8_t PORT>
+  void HardwareSerialT<PORT>::end() {
+    flush(); // wait for buffer to end.
     #if (defined(UBRR0H) || defined(UBRR1H))
      /*
       cbi(*_ucsrb, _rxen);
@@ -172,7 +172,7 @@
       cbi(*_ucsrb, _rxcie);
       cbi(*_ucsrb, _udrie);
      */
-      *_ucsrb = 0; //
+      port::ucsrb() = 0; //
     #else
       /*
       cbi(LINENIR,LENTXOK);
@@ -187,63 +187,116 @@
 
 
     #endif
-    _rx_buffer->head = _rx_buffer->tail;
+    while (read() >= 0); // and throw away whatever we received
   }
 
-  int HardwareSerial::available(void) {
-    return (unsigned int)(SERIAL_BUFFER_SIZE + _rx_buffer->head - _rx_buffer->tail) & (SERIAL_BUFFER_SIZE - 1);
+  template <uint8_t PORT>
+  int HardwareSerialT<PORT>::available(void) {
+    return _rx_buffer.available();
   }
 
-  int HardwareSerial::peek(void) {
-    if (_rx_buffer->head == _rx_buffer->tail) {
-      return -1;
-    } else {
-      return _rx_buffer->buffer[_rx_buffer->tail];
-    }
+  template <uint8_t PORT>
+  int HardwareSerialT<PORT>::peek(void) {
+    return _rx_buffer.peek();
   }
 
-  int HardwareSerial::read(void) {
-    // if the head isn't ahead of the tail, we don't have any characters
-    if (_rx_buffer->head == _rx_buffer->tail) {
+  template <uint8_t PORT>
+  int HardwareSerialT<PORT>::read(void) {
+    uint8_t c;
+    if (!_rx_buffer.pop(c)) {
       return -1;
-    } else {
-      unsigned char c = _rx_buffer->buffer[_rx_buffer->tail];
-      _rx_buffer->tail = (_rx_buffer->tail + 1)  & (SERIAL_BUFFER_SIZE - 1);
-      return c;
     }
+    return c;
   }
 
-  void HardwareSerial::flush() {
-    while (_tx_buffer->head != _tx_buffer->tail)
+  template <uint8_t PORT>
+  void HardwareSerialT<PORT>::flush() {
+    while (!_tx_buffer.empty())
       ;
   }
 
-  size_t HardwareSerial::write(uint8_t c) {
-    byte i = (_tx_buffer->head + 1)  & (SERIAL_BUFFER_SIZE - 1);
+  // Unbuffered: wait for the USART and hand it the byte ourselves. No UDRE interrupt is involved.
+  template <uint8_t PORT>
+  inline __attribute__((always_inline)) void HardwareSerialT<PORT>::_write_unbuffered(uint8_t c) {
+    #if (defined(UBRR0H) || defined(UBRR1H))
+      while (!(port::ucsra() & _udre))
+        ;
+      port::udr() = c;
+    #else
+      while (LINSIR & _BV(LBUSY))
+        ;
+      LINDAT = c;
+    #endif
+  }
+
+  // Make sure the ISR is draining the TX buffer, after something has been put in it.
+  template <uint8_t PORT>
+  inline __attribute__((always_inline)) void HardwareSerialT<PORT>::_start_tx() {
+    #if (defined(UBRR0H) || defined(UBRR1H) )
+      port::ucsrb() |= _udrie;
+    #else
+      if (!(LINENIR & _BV(LENTXOK))) {
+        // The transmitter is idle, and LIN_TC_vect leaves the TX side alone while LENTXOK is off,
+        // so for now we are the consumer: load the first byte, then turn on the TX Complete interrupt.
+        uint8_t d;
+        _tx_buffer.pop(d); // can't fail, the caller just pushed something
+        LINDAT = d;
+        LINSIR = _BV(LTXOK); // clear the one left over from the last byte, or the ISR would fire right away
+        LINENIR = _BV(LENTXOK) | _BV(LENRXOK);
+      }
+    #endif
+  }
 
+  template <uint8_t PORT>
+  size_t HardwareSerialT<PORT>::write(uint8_t c) {
+    if (port::TX_SIZE == 0) {
+      _write_unbuffered(c);
+      return 1;
+    }
     // If the output buffer is full, there's nothing for it other than to
     // wait for the interrupt handler to empty it a bit
     // ???: return 0 here instead?
-    while (i == _tx_buffer->tail)
+    while (!_tx_buffer.push(c))
       ;
+    _start_tx();
+    return 1;
+  }
 
-    _tx_buffer->buffer[_tx_buffer->head] = c;
-    _tx_buffer->head = i;
-
-    #if (defined(UBRR0H) || defined(UBRR1H) )
-      *_ucsrb |= _udrie;
-    #else
-      if(!(LINENIR & _BV(LENTXOK))){
-        //The buffer was previously empty, so enable TX Complete interrupt and load first byte.
-        LINENIR = _BV(LENTXOK) | _BV(LENRXOK);
-        unsigned char c = _tx_buffer->buffer[_tx_buffer->tail];
-        _tx_buffer->tail = (_tx_buffer->tail + 1) & (SERIAL_BUFFER_SIZE - 1);
-        LINDAT = c;
+  template <uint8_t PORT>
+  size_t HardwareSerialT<PORT>::write(const uint8_t *buffer, size_t size) {
+    size_t left = size;
+    if (port::TX_SIZE == 0) {
+      while (left--) {
+        _write_unbuffered(*buffer++);
       }
-    #endif
+      return size;
+    }
+    /* Copy in as much as there's room for in one go, and start the ISR on it; after that,
+     * we only wait as long as it takes for room to free up for the rest. The ring buffer
+     * needs no cli() for this, since we only ever move the head and the ISR only the tail. */
+    while (left) {
+      uint8_t n = _tx_buffer.push_n(buffer, left);
+      if (n) {
+        buffer += n;
+        left -= n;
+        _start_tx();
+      }
+    }
+    return size;
+  }
 
+  /* The methods above are only compiled for the ports that are actually in use */
+  #if (defined(UBRR0H) || defined(LINBRRH)) && !DISABLE_UART0
+    template class HardwareSerialT<0>;
+  #endif
+  #if defined(UBRR1H) && !DISABLE_UART1
+    template class HardwareSerialT<1>;
+  #endif
 
-    return 1;
+  // Serial.begin() with a constant baud rate never comes here, so this is the only caller of serial_baud_runtime().
+  void HardwareSerial::begin(long baud) {
+    serial_baud_t setting = serial_baud_runtime(baud);
+    _begin(setting.brr, setting.mode);
   }
 
   HardwareSerial::operator bool() {
@@ -25,6 +25,7 @@
 
   #include <inttypes.h>
   #include "Stream.h"
+  #include "RingBuffer.h"
   // Register names for USART0 normalized to the names with 0 in them.
   #if defined(UBRRH) // if we have a UART0 (and only a UART0)
     #define UBRR0H    UBRRH
@@ -57,6 +58,7 @@
     #define TXEN  TXEN0
     #define RXCIE RXCIE0
     #define UDRIE  UDRIE0
+    #define UDRE  UDRE0
     #define U2X   U2X0
   #endif
   #if defined (UBRR0H)
@@ -64,64 +66,163 @@
     const uint8_t _txen   = (1 << TXEN);
     const uint8_t _rxcie  = (1 << RXCIE);
     const uint8_t _udrie  = (1 << UDRIE);
+    const uint8_t _udre   = (1 << UDRE);
     const uint8_t _u2x    = (1 << U2X);
   #endif
+  /* Buffer sizes - per port, per direction.
+   * SERIAL_BUFFER_SIZE is the default for both directions, by how much RAM there is. The Serial
+   * Buffers menu can trade TX for RX (SERIAL_BUFFERS_RX_HEAVY), or drop the TX buffer entirely, in
+   * which case write() waits for the USART and sends the byte itself. Any of the four sizes can
+   * also be set with a define; Serial1 gets what Serial gets unless told otherwise.
+   * Sizes must be powers of two, 2 to 256 (a buffer holds one less than its size) - or 0 for TX. */
   #if (RAMEND < 1000)
     #define SERIAL_BUFFER_SIZE 16
   #else
     #define SERIAL_BUFFER_SIZE 64
   #endif
-  /* WARNING
-   * BUFFER SIZES MUST BE POWERS OF TWO - The compiler misses some of the
-   * optimization possible with the % opperator. only a small portion of it, but as there's no compelling reason NOT
-   * to use a power of two size, and there are some extrenely flash-constrained parts that have a USART (I'm thinking of the 2313 in particular
-   * I couldn't justify not explicitly optimizing the % SERIAL_BUFFER_SIZE to a & (SERIAL_BUFFER_SIZE -1))
-   */
-
+  #ifndef SERIAL_RX_BUFFER_SIZE
+    #if defined(SERIAL_BUFFERS_RX_HEAVY)
+      #define SERIAL_RX_BUFFER_SIZE (SERIAL_BUFFER_SIZE * 2)
+    #else
+      #define SERIAL_RX_BUFFER_SIZE SERIAL_BUFFER_SIZE
+    #endif
+  #endif
+  #ifndef SERIAL_TX_BUFFER_SIZE
+    #if defined(SERIAL_BUFFERS_RX_HEAVY)
+      #define SERIAL_TX_BUFFER_SIZE (SERIAL_BUFFER_SIZE / 4)
+    #else
+      #define SERIAL_TX_BUFFER_SIZE SERIAL_BUFFER_SIZE
+    #endif
+  #endif
+  #ifndef SERIAL1_RX_BUFFER_SIZE
+    #define SERIAL1_RX_BUFFER_SIZE SERIAL_RX_BUFFER_SIZE
+  #endif
+  #ifndef SERIAL1_TX_BUFFER_SIZE
+    #define SERIAL1_TX_BUFFER_SIZE SERIAL_TX_BUFFER_SIZE
+  #endif
+  #if (SERIAL_RX_BUFFER_SIZE < 2 || SERIAL_RX_BUFFER_SIZE > 256 || (SERIAL_RX_BUFFER_SIZE & (SERIAL_RX_BUFFER_SIZE - 1)))
+    #error "SERIAL_RX_BUFFER_SIZE must be a power of two from 2 to 256"
+  #endif
+  #if (SERIAL_TX_BUFFER_SIZE == 1 || SERIAL_TX_BUFFER_SIZE > 256 || (SERIAL_TX_BUFFER_SIZE & (SERIAL_TX_BUFFER_SIZE - 1)))
+    #error "SERIAL_TX_BUFFER_SIZE must be 0 (unbuffered) or a power of two from 2 to 256"
+  #endif
+  #if defined(UBRR1H)
+    #if (SERIAL1_RX_BUFFER_SIZE < 2 || SERIAL1_RX_BUFFER_SIZE > 256 || (SERIAL1_RX_BUFFER_SIZE & (SERIAL1_RX_BUFFER_SIZE - 1)))
+      #error "SERIAL1_RX_BUFFER_SIZE must be a power of two from 2 to 256"
+    #endif
+    #if (SERIAL1_TX_BUFFER_SIZE == 1 || SERIAL1_TX_BUFFER_SIZE > 256 || (SERIAL1_TX_BUFFER_SIZE & (SERIAL1_TX_BUFFER_SIZE - 1)))
+      #error "SERIAL1_TX_BUFFER_SIZE must be 0 (unbuffered) or a power of two from 2 to 256"
+    #endif
+  #endif
 
+  /* Baud rate solver.
+   * For a USART, the choice is UBRR and whether to use U2X; for the LIN UART on the x7, it is
+   * LINBRR and how many clocks per bit (LBT, 8 to 63). serial_baud() tries every one of those
+   * and keeps the setting whose baud rate is closest to the one asked for, preferring more
+   * samples per bit when it's a tie. It is meant for a constant baud rate - then all of this
+   * folds away to the two or three register values and begin() never divides at all - and
+   * HardwareSerialT::begin() only uses it then. With a baud rate only known at runtime,
+   * serial_baud_runtime() in HardwareSerial.cpp does it the old way (U2X if UBRR fits, LBT 16).
+   * If even the best setting is more than SERIAL_BAUD_ERROR_WARN hundredths of a percent off,
+   * begin() gives a compile warning, since the other end may not understand us. */
+  #ifndef SERIAL_BAUD_ERROR_WARN
+    #define SERIAL_BAUD_ERROR_WARN 200
+  #endif
+  void badBaud() __attribute__((warning("Serial baud rate is more than SERIAL_BAUD_ERROR_WARN (in 0.01% units) off at this F_CPU")));
 
-  struct ring_buffer;
+  typedef struct {
+    uint16_t brr;     // UBRR or LINBRR
+    uint8_t  mode;    // UCSRA value (U2X or not) or LBT
+    uint16_t error;   // hundredths of a percent
+  } serial_baud_t;
 
-  struct ring_buffer
-    {
-      unsigned char buffer[SERIAL_BUFFER_SIZE];
-      byte head;
-      byte tail;
-    };
-  inline void store_char(unsigned char c, ring_buffer *buffer) {
-    byte i = (buffer->head + 1) % SERIAL_BUFFER_SIZE;
-
-    // if we should be storing the received character into the location
-    // just before the tail (meaning that the head would advance to the
-    // current location of the tail), we're about to overflow the buffer
-    // and so we don't write the character or advance the head.
-    if (i != buffer->tail) {
-      buffer->buffer[buffer->head] = c;
-      buffer->head = i;
+  // How far F_CPU / ticks (ticks = clocks per bit) is from baud.
+  constexpr __attribute__((always_inline)) uint16_t serial_baud_error(uint32_t baud, uint32_t ticks) {
+    uint64_t actual = (uint64_t)baud * ticks;
+    uint64_t diff = actual > F_CPU ? actual - F_CPU : F_CPU - actual;
+    uint64_t error = diff * 10000 / actual;
+    return error > 0xFFFF ? 0xFFFF : (uint16_t)error;
+  }
+  constexpr __attribute__((always_inline)) serial_baud_t serial_baud_candidate(uint32_t baud, uint8_t divisor, uint8_t mode) {
+    uint32_t per_bit = (F_CPU + baud * divisor / 2) / (baud * divisor); // brr + 1, rounded
+    if (per_bit > 4096) {
+      per_bit = 4096;
+    } else if (per_bit == 0) {
+      per_bit = 1;
     }
+    return serial_baud_t{(uint16_t)(per_bit - 1), mode, serial_baud_error(baud, per_bit * divisor)};
   }
+  // a unless b is strictly better, so whichever is passed first wins a tie.
+  constexpr __attribute__((always_inline)) serial_baud_t serial_baud_better(serial_baud_t a, serial_baud_t b) {
+    return b.error < a.error ? b : a;
+  }
+  #if defined(UBRR0H)
+    constexpr __attribute__((always_inline)) serial_baud_t serial_baud(uint32_t baud) {
+      return serial_baud_better(serial_baud_candidate(baud, 16, 0), serial_baud_candidate(baud, 8, _u2x));
+    }
+  #elif defined(LINBRRH)
+    // One instantiation per LBT, each forced inline, so that with a constant baud rate the whole search folds away.
+    template <uint8_t LBT> struct serial_lin_baud {
+      static constexpr __attribute__((always_inline)) serial_baud_t best(uint32_t baud) {
+        return serial_baud_better(serial_lin_baud<LBT + 1>::best(baud), serial_baud_candidate(baud, LBT, LBT));
+      }
+    };
+    template <> struct serial_lin_baud<64> {
+      static constexpr __attribute__((always_inline)) serial_baud_t best(uint32_t) {
+        return serial_baud_t{0, 0, 0xFFFF};
+      }
+    };
+    constexpr __attribute__((always_inline)) serial_baud_t serial_baud(uint32_t baud) {
+      return serial_lin_baud<8>::best(baud);
+    }
+  #endif
+  serial_baud_t serial_baud_runtime(uint32_t baud);
+
+  /* Everything about a port that doesn't change at runtime: the registers and the buffer sizes.
+   * HardwareSerialT gets them from here by port number, so that with the port a template
+   * parameter, every register access is a plain in/out or lds/sts, and every bit a constant,
+   * rather than a load through a pointer kept in the object (see HardwareSerialT::begin()). */
+  template <uint8_t PORT> struct SerialPort;
+  #if defined(UBRR0H)
+    template <> struct SerialPort<0> {
+      static const uint16_t RX_SIZE = SERIAL_RX_BUFFER_SIZE;
+      static const uint16_t TX_SIZE = SERIAL_TX_BUFFER_SIZE;
+      static inline __attribute__((always_inline)) volatile uint8_t &ubrrh() { return UBRR0H; }
+      static inline __attribute__((always_inline)) volatile uint8_t &ubrrl() { return UBRR0L; }
+      static inline __attribute__((always_inline)) volatile uint8_t &ucsra() { return UCSR0A; }
+      static inline __attribute__((always_inline)) volatile uint8_t &ucsrb() { return UCSR0B; }
+      static inline __attribute__((always_inline)) volatile uint8_t &udr()   { return UDR0;   }
+    };
+  #elif defined(LINBRRH)
+    // The LIN UART on the x7 has only the one set of registers, which are used by name.
+    template <> struct SerialPort<0> {
+      static const uint16_t RX_SIZE = SERIAL_RX_BUFFER_SIZE;
+      static const uint16_t TX_SIZE = SERIAL_TX_BUFFER_SIZE;
+    };
+  #endif
+  #if defined(UBRR1H)
+    template <> struct SerialPort<1> {
+      static const uint16_t RX_SIZE = SERIAL1_RX_BUFFER_SIZE;
+      static const uint16_t TX_SIZE = SERIAL1_TX_BUFFER_SIZE;
+      static inline __attribute__((always_inline)) volatile uint8_t &ubrrh() { return UBRR1H; }
+      static inline __attribute__((always_inline)) volatile uint8_t &ubrrl() { return UBRR1L; }
+      static inline __attribute__((always_inline)) volatile uint8_t &ucsra() { return UCSR1A; }
+      static inline __attribute__((always_inline)) volatile uint8_t &ucsrb() { return UCSR1B; }
+      static inline __attribute__((always_inline)) volatile uint8_t &udr()   { return UDR1;   }
+    };
+  #endif
+
+  /* HardwareSerial is what the sketch and libraries see, and what they take a reference to:
+   * begin() and end(), and printHex(). It holds nothing; Serial and Serial1 are each a
+   * HardwareSerialT for their port, below, which does all the work. begin() isn't virtual:
+   * HardwareSerialT::begin() works UBRR out at compile time when the baud rate is a constant,
+   * and only code that calls begin() through a HardwareSerial&, or with a variable baud rate,
+   * ends up here and pulls in serial_baud_runtime() and the 32-bit division it needs. */
   class HardwareSerial : public Stream
   {
-    private:
-      volatile ring_buffer *_rx_buffer;
-      volatile ring_buffer *_tx_buffer;
-      volatile uint8_t *_ubrrh;
-      volatile uint8_t *_ubrrl;
-      volatile uint8_t *_ucsra;
-      volatile uint8_t *_ucsrb;
-      volatile uint8_t *_udr;
     public:
-      HardwareSerial(ring_buffer *rx_buffer, ring_buffer *tx_buffer
-      #if ( defined(UBRRH) || defined(UBRR0H) || defined(UBRR1H))
-        ,
-        volatile uint8_t *ubrrh, volatile uint8_t *ubrrl,
-        volatile uint8_t *ucsra, volatile uint8_t *ucsrb,
-        volatile uint8_t *udr);
-      #else
-        );
-      #endif
-      void begin(long);
-      void end();
+      void begin(long baud);
+      virtual void end() = 0;
           // Basic printHex() forms for 8, 16, and 32-bit values
       void                printHex(const     uint8_t              b);
       void                printHex(const    uint16_t  w, bool s = 0);
@@ -139,22 +240,53 @@
       // The pointer-versions for mass printing uint8_t and uint16_t arrays.
       uint8_t *           printHex(          uint8_t* p, uint8_t len, char sep = 0            );
       uint16_t *          printHex(         uint16_t* p, uint8_t len, char sep = 0, bool s = 0);
+      using Print::write; // pull in write(str) and write(buf, size) from Print
+      operator bool();
+    protected:
+      virtual void _begin(uint16_t brr, uint8_t mode) = 0;
+  };
+
+  template <uint8_t PORT>
+  class HardwareSerialT : public HardwareSerial
+  {
+    typedef SerialPort<PORT> port;
+    public:
+      // Public only so that the ISRs in Serial0.cpp and Serial1.cpp can get at them.
+      RingBuffer<port::RX_SIZE> _rx_buffer;
+      RingBuffer<port::TX_SIZE> _tx_buffer;
+      inline __attribute__((always_inline)) void begin(long baud) {
+        if (__builtin_constant_p(baud)) {
+          serial_baud_t setting = serial_baud(baud);
+          if (setting.error > SERIAL_BAUD_ERROR_WARN) {
+            badBaud();
+          }
+          HardwareSerialT::_begin(setting.brr, setting.mode); // qualified, so it's a direct call
+        } else {
+          HardwareSerial::begin(baud);
+        }
+      }
+      virtual void end();
       virtual int available(void);
       virtual int peek(void);
       virtual int read(void);
       virtual void flush(void);
       virtual size_t write(uint8_t);
-      using Print::write; // pull in write(str) and write(buf, size) from Print
-      operator bool();
+      // Fills the TX buffer a block at a time, rather than a virtual write(uint8_t) call per byte.
+      virtual size_t write(const uint8_t *buffer, size_t size);
+      using Print::write; // pull in write(str) from Print
+    private:
+      virtual void _begin(uint16_t brr, uint8_t mode);
+      inline void _write_unbuffered(uint8_t c);
+      inline void _start_tx();
   };
 
   #endif
 
   #if (defined(UBRRH) || defined(UBRR0H) || defined(LINBRRH)) && !USE_SOFTWARE_SERIAL
-    extern HardwareSerial Serial;
+    extern HardwareSerialT<0> Serial;
   #endif
   #if defined(UBRR1H)
-    extern HardwareSerial Serial1;
+    extern HardwareSerialT<1> Serial1;
   #endif
 
 #endif
@@ -0,0 +1,158 @@
+/* RingBuffer.h - lock-free byte FIFO between an ISR and the sketch
+ * Part of ATTinyCore - github.com/SpenceKonde/ATTinyCore
+ *   Free Software - LGPL 2.1, please see LICENCE.md for details
+ *
+ * Every byte that goes between an interrupt and the sketch - HardwareSerial RX
+ * and TX, the builtin software serial, the SoftwareSerial library and the USI
+ * TWI slave - goes through one of these, so the per-byte cost is the same
+ * everywhere and can be measured once.
+ *
+ * There is exactly one producer and one consumer (one of them in an ISR). The
+ * producer only ever writes _head and the consumer only ever writes _tail;
+ * they are single bytes, so each side can read the other's index at any time,
+ * and nothing here ever needs to turn interrupts off. The data byte is stored
+ * before the new head is published, and read before the new tail is, and the
+ * compiler is kept from reordering that with an empty asm memory barrier, which
+ * costs no instructions (the indices are volatile, the buffer is not, so that
+ * copying a block doesn't reload everything each byte).
+ *
+ * SIZE is a power of two from 2 to 256, so wrapping is an andi (or nothing, at
+ * 256) and never a branch - or 0 for no buffer at all (see the end of the file).
+ * One slot is always left empty to tell full from empty, so it holds at most
+ * SIZE - 1 bytes; overhead is the two index bytes. There's no constructor:
+ * these are meant to be globals, and the zeroed .bss is an empty buffer.
+ *
+ * Which side a method belongs to matters: calling a producer method from the
+ * consumer's context (or vice versa) while the other side can run is a race.
+ * reset() belongs to neither, and is only for when the other side is stopped.
+ *---------------------------------------------------------------------------*/
+
+#ifndef RingBuffer_h
+#define RingBuffer_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define RING_BUFFER_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+template <uint16_t SIZE>
+class RingBuffer {
+  static_assert(SIZE >= 2 && SIZE <= 256 && (SIZE & (SIZE - 1)) == 0, "RingBuffer size must be a power of two between 2 and 256");
+  public:
+    static const uint8_t MASK = (uint8_t)(SIZE - 1);
+
+    /* Either side */
+    inline __attribute__((always_inline)) uint8_t available() const {
+      return (uint8_t)(_head - _tail) & MASK;
+    }
+    inline __attribute__((always_inline)) uint8_t space() const {
+      return (uint8_t)(_tail - _head - 1) & MASK;
+    }
+    inline __attribute__((always_inline)) bool empty() const {
+      return _head == _tail;
+    }
+
+    /* Producer side */
+    // Returns false (and drops the byte) if the buffer is full.
+    inline __attribute__((always_inline)) bool push(uint8_t c) {
+      uint8_t head = _head;
+      uint8_t next = (uint8_t)(head + 1) & MASK;
+      if (next == _tail) {
+        return false;
+      }
+      _buffer[head] = c;
+      RING_BUFFER_BARRIER();
+      _head = next;
+      return true;
+    }
+    // Copies as much of src as there's room for, publishes it all at once, and returns how much that was.
+    uint8_t push_n(const uint8_t *src, size_t n) {
+      uint8_t head = _head;
+      uint8_t room = (uint8_t)(_tail - head - 1) & MASK;
+      if (n > room) {
+        n = room;
+      }
+      RING_BUFFER_BARRIER();
+      for (uint8_t i = (uint8_t)n; i; i--) {
+        _buffer[head] = *src++;
+        head = (uint8_t)(head + 1) & MASK;
+      }
+      RING_BUFFER_BARRIER();
+      _head = head;
+      return (uint8_t)n;
+    }
+
+    /* Consumer side */
+    // Returns false if the buffer is empty.
+    inline __attribute__((always_inline)) bool pop(uint8_t &c) {
+      uint8_t tail = _tail;
+      if (tail == _head) {
+        return false;
+      }
+      RING_BUFFER_BARRIER();
+      c = _buffer[tail];
+      RING_BUFFER_BARRIER();
+      _tail = (uint8_t)(tail + 1) & MASK;
+      return true;
+    }
+    // The next byte, or -1 if there isn't one.
+    inline __attribute__((always_inline)) int16_t peek() const {
+      uint8_t tail = _tail;
+      if (tail == _head) {
+        return -1;
+      }
+      RING_BUFFER_BARRIER();
+      return _buffer[tail];
+    }
+    // Copies up to n bytes out to dst, frees them all at once, and returns how many there were.
+    uint8_t pop_n(uint8_t *dst, size_t n) {
+      uint8_t tail = _tail;
+      uint8_t count = (uint8_t)(_head - tail) & MASK;
+      if (n > count) {
+        n = count;
+      }
+      RING_BUFFER_BARRIER();
+      for (uint8_t i = (uint8_t)n; i; i--) {
+        *dst++ = _buffer[tail];
+        tail = (uint8_t)(tail + 1) & MASK;
+      }
+      RING_BUFFER_BARRIER();
+      _tail = tail;
+      return (uint8_t)n;
+    }
+    // Throw away everything that's in it right now.
+    inline __attribute__((always_inline)) void clear() {
+      _tail = _head;
+    }
+
+    /* Neither - only while the other side can't run */
+    inline __attribute__((always_inline)) void reset() {
+      _head = 0;
+      _tail = 0;
+    }
+
+  private:
+    volatile uint8_t _head;
+    volatile uint8_t _tail;
+    uint8_t _buffer[SIZE];
+};
+
+/* A buffer of size 0, for where a build option can leave a direction unbuffered: it is
+ * always empty and always full, so code written against RingBuffer still compiles, and
+ * whatever handles the unbuffered case can test SIZE at compile time. */
+template <>
+class RingBuffer<0> {
+  public:
+    inline __attribute__((always_inline)) uint8_t available() const               { return 0; }
+    inline __attribute__((always_inline)) uint8_t space() const                   { return 0; }
+    inline __attribute__((always_inline)) bool empty() const                      { return true; }
+    inline __attribute__((always_inline)) bool push(uint8_t)                      { return false; }
+    inline __attribute__((always_inline)) uint8_t push_n(const uint8_t *, size_t) { return 0; }
+    inline __attribute__((always_inline)) bool pop(uint8_t &)                     { return false; }
+    inline __attribute__((always_inline)) int16_t peek() const                    { return -1; }
+    inline __attribute__((always_inline)) uint8_t pop_n(uint8_t *, size_t)        { return 0; }
+    inline __attribute__((always_inline)) void clear()                            { }
+    inline __attribute__((always_inline)) void reset()                            { }
+};
+
+#endif
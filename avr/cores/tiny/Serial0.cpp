@@ -6,51 +6,45 @@
     #if !defined(USART0_UDRE_vect) && !defined(LIN_TC_vect)
       #error "Don't know what the Data Register Empty vector is called for the first UART"
     #endif
-    ring_buffer rx_buffer  =  { { 0 }, 0, 0 };
-    ring_buffer tx_buffer  =  { { 0 }, 0, 0 };
-    #if defined(USART0_UDRE_vect)
+    HardwareSerialT<0> Serial;
+    #if defined(USART0_UDRE_vect) && SERIAL_TX_BUFFER_SIZE > 0
       ISR(USART0_UDRE_vect) {
-        if (tx_buffer.head == tx_buffer.tail) {
-          // Buffer empty, so disable interrupts]
-            UCSR0B &= ~(1 << UDRIE);
-        } else {
+        uint8_t c;
+        if (Serial._tx_buffer.pop(c)) {
           // There is more data in the output buffer. Send the next byte
-          unsigned char c = tx_buffer.buffer[tx_buffer.tail];
-          tx_buffer.tail = (tx_buffer.tail + 1) % SERIAL_BUFFER_SIZE;
           UDR0 = c;
+        } else {
+          // Buffer empty, so disable interrupts
+          UCSR0B &= ~(1 << UDRIE);
         }
       }
     #endif
   #endif
   #if defined(USART0_RX_vect)
     ISR(USART0_RX_vect) {
-      unsigned char c  =  UDR0;
-      store_char(c, &rx_buffer);
+      // if the buffer is full, the character is dropped
+      Serial._rx_buffer.push(UDR0);
     }
   #elif defined(LIN_TC_vect)
     // this is for attinyX7
     ISR(LIN_TC_vect) {
-      if(LINSIR & _BV(LRXOK)) {
-          unsigned char c  =  LINDAT;
-          store_char(c, &rx_buffer);
+      if (LINSIR & _BV(LRXOK)) {
+        Serial._rx_buffer.push(LINDAT);
       }
-      if(LINSIR & _BV(LTXOK)) {
-        //PINA |= _BV(PINA5); //debug
-        if (tx_buffer.head == tx_buffer.tail) {
-        // Buffer empty, so disable interrupts
-          LINENIR = LENRXOK; //unset LENTXOK
-        } else {
-          // There is more data in the output buffer. Send the next byte
-          unsigned char c = tx_buffer.buffer[tx_buffer.tail];
-          tx_buffer.tail = (tx_buffer.tail + 1) % SERIAL_BUFFER_SIZE;
-          LINDAT = c;
+      #if SERIAL_TX_BUFFER_SIZE > 0
+        // LTXOK stays set after the last byte, so only look at it while we're transmitting;
+        // otherwise HardwareSerial::write() owns the TX side.
+        if ((LINSIR & _BV(LTXOK)) && (LINENIR & _BV(LENTXOK))) {
+          uint8_t c;
+          if (Serial._tx_buffer.pop(c)) {
+            // There is more data in the output buffer. Send the next byte
+            LINDAT = c;
+          } else {
+            // Buffer empty, so disable interrupts
+            LINENIR = _BV(LENRXOK); //unset LENTXOK
+          }
         }
-      }
+      #endif
     }
   #endif
-  #if defined(UBRR0H)
-    HardwareSerial Serial(&rx_buffer, &tx_buffer, &UBRR0H, &UBRR0L, &UCSR0A, &UCSR0B, &UDR0);
-  #elif defined(LINBRRH)
-    HardwareSerial Serial(&rx_buffer, &tx_buffer);
-  #endif
 #endif
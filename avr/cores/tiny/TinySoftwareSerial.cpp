@@ -33,7 +33,7 @@
 extern "C"{
 
   #ifndef SOFT_TX_ONLY
-    soft_ring_buffer rx_buffer = {{ 0 }, 0, 0};
+    soft_ring_buffer rx_buffer;
     ISR(SOFTSERIAL_vect) {
       register uint8_t DelayCount asm ("r21");
       DelayCount = Serial._delayCount;
@@ -78,23 +78,13 @@ extern "C"{
       #else
         ACSR = (1 << ACBG) | (1 << ACIS1) | (1 << ACIS0) | (1 << ACI) | (1 << ACIE); // ldi, out
       #endif
-      uint8_t i = (uint8_t)(rx_buffer.head + 1) & (SERIAL_BUFFER_SIZE-1); //lds, andi
-
-      // if we should be storing the received character into the location
-      // just before the tail (meaning that the head would advance to the
-      // current location of the tail), we're about to overflow the buffer
-      // and so we don't write the character or advance the head.
-      if (i != rx_buffer.tail) { // lds, cp, breq
-        rx_buffer.buffer[rx_buffer.head] = ch; // ldi, ldi, add, adc, st
-        rx_buffer.head = i; // sts
-      }
-      // total 2 + (2+1) + (2 + 1 + 1) + (1 + 1 + 1 + 1 + 2) = 2 + 3 + 4 + 6 = 15 clocks from sampling last bit
-      // epilogue = prologue only with pop's instead of pushes, same time as prologue on classic AVRs = 11 clocks
-      // reti 4 clocks
-      // total 15 + 11 + 4 = 30 clocks from end of asm to end of ISR. which is 447 + 99 * _delayCount clocks from it's start
-      // 477 + 99 * _delayCount total.
-      // the falling edge of the next byte's start bit must not occur during this time, or we will get garbage for the next byte
-      // (actual byte duration in clocks) < 477 * 99 * delayCount, or (actual bit time in clocks ) < 34 (30 + the 4 clocks from sample time to end of ISR) worst case assuming we're barely catching end of last bit.
+      // If the buffer is full, we don't write the character or advance the head.
+      rx_buffer.push(ch);
+      // From the last sample to the end of the ISR: sec/ror/brcc (4), the sbi above (2), the push (lds, mov, subi, andi,
+      // lds, cp, breq, mov, ldi, subi, sbci, st, sts - about 17 clocks when there's room; the registers are up to the
+      // compiler), the epilogue (as long as the prologue, which also saves whatever the push needed) and reti (4). The
+      // last sample is mid-bit, so all of that has to fit in the ~1.5 bit times before the next start bit's edge, or the
+      // next byte gets sampled late. Count it from the listing if you change any of this.
     }
 
   #endif
@@ -176,7 +166,7 @@ void TinySoftwareSerial::begin(long baud) {
 void TinySoftwareSerial::end() {
   #ifndef SOFT_TX_ONLY
     ACSR = (1 << ACD) | (1 << ACI); // turn off the analog comparator, clearing the flag while we're at it.
-    _rx_buffer->head = _rx_buffer->tail;
+    _rx_buffer->clear();
   #endif
   _delayCount = 0;
 }
@@ -184,7 +174,7 @@ void TinySoftwareSerial::end() {
 int TinySoftwareSerial::available(void) {
   #ifndef SOFT_TX_ONLY
     if (_delayCount) {
-      return (uint8_t)(SERIAL_BUFFER_SIZE + _rx_buffer->head - _rx_buffer->tail) & (SERIAL_BUFFER_SIZE-1);
+      return _rx_buffer->available();
     }
   #endif
   return 0;
@@ -193,11 +183,7 @@ int TinySoftwareSerial::available(void) {
 
 int TinySoftwareSerial::peek(void) {
   #ifndef SOFT_TX_ONLY
-    if (_rx_buffer->head == _rx_buffer->tail) {
-      return -1;
-    } else {
-      return _rx_buffer->buffer[_rx_buffer->tail];
-    }
+    return _rx_buffer->peek();
   #else
     return -1;
   #endif
@@ -205,14 +191,11 @@ int TinySoftwareSerial::peek(void) {
 
 int TinySoftwareSerial::read(void) {
   #ifndef SOFT_TX_ONLY
-    // if the head isn't ahead of the tail, we don't have any characters
-    if (_rx_buffer->head == _rx_buffer->tail || _begun != 0) {
+    uint8_t c;
+    if (_begun != 0 || !_rx_buffer->pop(c)) {
       return -1;
-    } else {
-      uint8_t c = _rx_buffer->buffer[_rx_buffer->tail];
-      _rx_buffer->tail = (uint8_t)(_rx_buffer->tail + 1) & (SERIAL_BUFFER_SIZE-1);
-      return c;
     }
+    return c;
   #else
     return -1;
   #endif
@@ -222,8 +205,7 @@ bool TinySoftwareSerial::listen() {
     return false;
   }
   if (ACSR & (1 << ACD)) {
-    _rx_buffer->head = 0;
-    _rx_buffer->tail = 0;
+    _rx_buffer->reset(); // the comparator is off, so the ISR can't be using it
     ACSR = (1 << ACBG) | (1 << ACIS1) | (1 << ACIS0) | (1 << ACI); // must not have ACIE set while changing ACD
     #if defined(__AVR_ATtiny_x8__) // not in the low I/O space so use LDI, OUT
       ACSR = (1 << ACBG) | (1 << ACIS1) | (1 << ACIS0) | (1 << ACI) | (1 << ACIE);
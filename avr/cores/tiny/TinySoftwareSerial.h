@@ -2,6 +2,7 @@
 #define TinySoftwareSerial_h
 #include <inttypes.h>
 #include "Stream.h"
+#include "RingBuffer.h"
 
 /* Where should this work?
  * ATtiny x5:   Yes - RX on PB1, TX defaults to PB0, can be PB0~4.
@@ -79,23 +80,13 @@
       #define SOFTSERIAL_RXBIT ANALOG_COMP_AIN1_BIT
       #define SOFTSERIAL_TXBIT ANALOG_COMP_AIN0_BIT
     #endif
-    struct soft_ring_buffer
-    {
-      volatile unsigned char buffer[SERIAL_BUFFER_SIZE];
-      volatile uint8_t head; // Making these uint8_t's saves FIFTY BYTES of flash! ISR code-size amplification in action...
-      volatile uint8_t tail;
-    };
+    typedef RingBuffer<SERIAL_BUFFER_SIZE> soft_ring_buffer;
   #else
     #define SOFTSERIAL_TXBIT ANALOG_COMP_AIN0_BIT
 
   #endif
   extern "C"{
     void uartDelay() __attribute__ ((naked, used)); //used attribute needed to prevent LTO from throwing it out.
-    #ifndef SOFT_TX_ONLY
-      // manually inlined because the compiler refused to do it.
-      //uint8_t getch();
-      //void store_char(unsigned char c, soft_ring_buffer *buffer);
-    #endif
   }
   class TinySoftwareSerial : public Stream
   {
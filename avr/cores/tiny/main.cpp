@@ -19,8 +19,12 @@ int main(void)
 
   setup();
 
-  for (;;)
+  for (;;) {
     loop();
+    #if !defined(DISABLEMILLIS)
+      timerDispatch();
+    #endif
+  }
 
   return 0;
 }
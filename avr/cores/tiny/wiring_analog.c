@@ -18,33 +18,6 @@
 #define DEFAULT (0)
 #endif
 
-/* These are pre-shifted, as are the constants
- * Don't calculate at runtime what you could have
- * calculated at compile time! */
-#if defined(REFS2)
-  #if defined(ADMUXB)
-    #define ADMUX_REFS_MASK (0xE0) /* 841/441 */
-  #else
-    #define ADMUX_REFS_MASK (0xD0) /* x5/x61 - not used for x61 */
-  #endif
-#elif defined(REFS1)
-  #define ADMUX_REFS_MASK (0xC0) /* 3 or 4 options, generally internal 1.1v, Vcc, and external */
-#elif defined(REFS0)
-  #define ADMUX_REFS_MASK (0x40) /* Everything with just Vcc and internal 1.1v */
-#else
-  #define ADMUX_REFS_MASK (0x20) /* 828 , whose sole REFS bit has no number*/
-#endif
-
-#if (defined(MUX5) && !defined(REFS0)) /* need to exclude the 828, which has it's vestigal MUX5 bit on ADMUXB */
-  #define ADMUX_MUX_MASK (0x3f)
-#elif defined(MUX4)
-  #define ADMUX_MUX_MASK (0x1f)
-#elif defined(MUX3)
-  #define ADMUX_MUX_MASK (0x0f)
-#else
-  #define ADMUX_MUX_MASK (0x07)
-#endif
-
 // global settings
 uint8_t analog_reference = DEFAULT;
 
@@ -215,6 +188,36 @@ inline int analogRead(uint8_t pin) {
 
 
 
+#if defined(ADCSRA)
+/* Everything before starting a conversion, shared by _analogRead() and analogReadStart(): check the
+ * channel, and that the ADC is on and not already busy, then select it. Returns 0 or ADC_ERROR_* */
+static inline __attribute__((always_inline)) int _analogPrepare(uint8_t pin) {
+  #if !defined(ADC_NO_CHECK_PINS)
+    #if defined(__AVR_ATtinyX61__)
+      if ((pin & 0x3F) < 32 && (pin & 0x40))  return ADC_ERROR_NOT_A_CHANNEL;
+
+    #elif defined(__AVR_ATtinyX5__)
+      if ((pin & 0x5F) > ADMUX_MUX_MASK)      return ADC_ERROR_NOT_A_CHANNEL;
+      if ((pin & 0x20) && ((pin & 0x0F) < 4 || (pin & 0x0F) > 11 ))
+                                              return ADC_ERROR_SINGLE_END_IPR;
+    #else
+      if ((pin & 0x7F) > ADMUX_MUX_MASK)      return ADC_ERROR_NOT_A_CHANNEL;
+    #endif
+  #endif
+  /* Whether checking that the ADC is enabled and not in use makes sense
+   * is arguable. Will be one of the "flash saving" options. Busy includes a
+   * conversion from analogReadStart() that isn't finished, and the ADC being
+   * left running by analogStreamBegin() */
+  #if !defined(ADC_NO_CHECK_STATUS)
+    uint8_t t = (ADCSRA & ((1 << ADEN) | (1 << ADSC) | (1 << ADC_AUTO_BIT)));
+    if (t != (1 << ADEN)) return (t & (1 << ADEN)) ? ADC_ERROR_BUSY : ADC_ERROR_DISABLED;
+  #endif
+
+  _adcSelect(pin);
+  return 0;
+}
+#endif
+
 #ifdef SLEEP_MODE_ADC
   int _analogRead(uint8_t pin, bool use_noise_reduction)
 #else
@@ -230,64 +233,10 @@ inline int analogRead(uint8_t pin) {
      * selected, or didn't know that the ATtiny4313/2313 don't have an ADC. */
     return -32768;
   #else
-    #if !defined(ADC_NO_CHECK_PINS)
-      #if defined(__AVR_ATtinyX61__)
-        if ((pin & 0x3F) < 32 && (pin & 0x40))  return ADC_ERROR_NOT_A_CHANNEL;
-
-      #elif defined(__AVR_ATtinyX5__)
-        if ((pin & 0x5F) > ADMUX_MUX_MASK)      return ADC_ERROR_NOT_A_CHANNEL;
-        if ((pin & 0x20) && ((pin & 0x0F) < 4 || (pin & 0x0F) > 11 ))
-                                                return ADC_ERROR_SINGLE_END_IPR;
-      #else
-        if ((pin & 0x7F) > ADMUX_MUX_MASK)      return ADC_ERROR_NOT_A_CHANNEL;
-      #endif
-    #endif
-    /* Whether checking that the ADC is enabled and not in use makes sense
-     * is arguable. Will be one of the "flash saving" options */
-    #if !defined(ADC_NO_CHECK_STATUS)
-      uint8_t t = (ADCSRA & ((1 << ADEN) | (1 << ADSC)));
-      if (!(t == (1 << ADEN))) return (t == (1 << ADSC)) ? ADC_ERROR_BUSY : ADC_ERROR_DISABLED;
-    #endif
-
-    /* Important difference from stock core: reference constants like DEFAULT,
-     * INTERNAL1V1, and so on have the reference bits PRESHIFTED to their
-     * final positions. Thus, we just OR them with the pin or w/e else goes in
-     * the register. New in ATTinyCore 2.0.0  - saves around 30 clock cycles
-     * and 24 bytes of flash, more on some parts; turns out a << 6 takes more
-     * work than you'd think; integer promotion hurts. */
-    #if defined(__AVR_ATtinyX61__)
-      // This one is wacky - with pre-shifting analog reference is this:
-      //            REFS1 | REFS0 |   -   | REFS2 | -    |   -   |   -   |   -
-      // Channels     -   | GSEL  |  MUX5 | MUX4  | MUX3 | MUX2  | MUX1  | MUX0
-      // and relevant registers:
-      // ADCSRB       BIN | GSEL  |   -   | REFS2 | MUX5 | ADTS2 | ADTS1 | ADTS0
-      // ADMUX      REFS1 | REFS0 | ADLAR | MUX4  | MUX3 | MUX2  | MUX1  | MUX0
-
-      ADMUX = ((analog_reference & 0xC0) | (pin & 0x1F));
-      // 1 ref bit, 1 mux bit, and the gain sel bit are scattered in ADCSRB, and we can't blow away it's contents because that's where we store unipolar vs bipolar mode setting too...
-      ADCSRB = (ADCSRB & (0xA7)) | (analog_reference & 0x10) | (pin & 0x40) | ((pin & 0x20) >> 2);
-      // ADCSRB = (ADCSRB & (0xA7)) | (analog_reference & 0x10) | (pin & 0x40) | ((pin & 0x20)?0x08:0);
-    #elif defined(ADMUXB)
-      #if defined(GSEL0)
-        // x41
-        ADMUXA = pin & 0x3f;
-        ADMUXB = (analog_reference & ADMUX_REFS_MASK) | analog_gain;
-      #else
-        // 828
-        ADMUXA = pin & 0x1f;
-        ADMUXB = analog_reference & ADMUX_REFS_MASK;
-      #endif
-    #elif defined(ADMUX)
-      ADMUX = ((analog_reference & ADMUX_REFS_MASK) | (pin & ADMUX_MUX_MASK)); //select the channel and reference
-      #ifdef AMISCR
-        //ATtiny87/167 external reference is selected by AREFEN bit in AMISCR. Internal reference is output if XREFEN bit is set.
-        // | - | - | - | - | - | AREFEN | XREFEN | ISRCEN |
-        AMISCR = (AMISCR & 0x01) | (analog_reference & 0x06);
-      #endif
-      #if defined(__AVR_ATtinyX5__)
-        ADCSRB = (ADCSRB & (~(1 << IPR))) | (pin & (1 << IPR));
-      #endif
-    #endif
+    int err = _analogPrepare(pin);
+    if (err) {
+      return err;
+    }
     #if defined(SLEEP_MODE_ADC)
       if (use_noise_reduction) {
         ADCSRA |= (1 << ADIE);
@@ -339,146 +288,181 @@ inline int analogRead(uint8_t pin) {
 }
 
 
-void analogWrite(uint8_t pin, int val) {
-  if(__builtin_constant_p(pin)) {
-    // No stupid exception here - nobody analogWrite()'s to pins that don't exist!
-    if (pin >= NUM_DIGITAL_PINS) badArg("analogWrite to constant pin number that is not a valid pin");
-  }
+/* Non-blocking analogRead(): analogReadStart() returns 0 once the conversion is under way, or the
+ * same ADC_ERROR_* analogRead() would have. Meanwhile, analogRead() gets ADC_ERROR_BUSY. Once
+ * analogReadReady(), analogReadResult() returns the result, and keeps returning it until the next
+ * conversion is started; before then, it returns ADC_ERROR_BUSY. */
+int analogReadStart(uint8_t pin) {
+  #ifndef ADCSRA
+    badCall("analogReadStart() cannot be used on a part without an ADC");
+    return ADC_ERROR_NO_ADC;
+  #else
+    if (!(pin & 0x80)) {
+      pin = digitalPinToAnalogInput(pin);
+    }
+    int err = _analogPrepare(pin);
+    if (err) {
+      return err;
+    }
+    ADCSRA |= (1 << ADSC);
+    return 0;
+  #endif
+}
+
+bool analogReadReady(void) {
+  #ifndef ADCSRA
+    badCall("analogReadReady() cannot be used on a part without an ADC");
+    return false;
+  #else
+    return !(ADCSRA & (1 << ADSC));
+  #endif
+}
+
+int analogReadResult(void) {
+  #ifndef ADCSRA
+    badCall("analogReadResult() cannot be used on a part without an ADC");
+    return ADC_ERROR_NO_ADC;
+  #else
+    uint8_t t = (ADCSRA & ((1 << ADEN) | (1 << ADSC)));
+    if (t != (1 << ADEN)) return (t & (1 << ADEN)) ? ADC_ERROR_BUSY : ADC_ERROR_DISABLED;
+    return ADCW;
+  #endif
+}
+
+#if defined(ADCSRA)
+/* Whether a result on this channel is a 10-bit two's complement number, which needs sign extending
+ * before it can be summed: differential channels in bipolar mode (always, on the x41). */
+static inline __attribute__((always_inline)) bool _adcSigned(uint8_t pin) {
+  #if defined(GSEL0)
+    return (pin & 0x3F) >= 0x10;
+  #elif defined(__AVR_ATtinyX61__)
+    pin &= 0x3F;
+    return (ADCSRB & 0x80) && pin >= 0x0B && pin != 0x1E && pin != 0x1F && pin < 0x3E;
+  #elif defined(__AVR_ATtinyX4__)
+    pin &= 0x3F;
+    return (ADCSRB & 0x80) && pin >= 0x08 && (pin < 0x20 || pin > 0x22);
+  #elif defined(__AVR_ATtinyX5__)
+    pin &= 0x0F;
+    return (ADCSRB & 0x80) && pin >= 0x04 && pin <= 0x0B;
+  #elif defined(__AVR_ATtinyX7__)
+    return (ADCSRB & 0x80) && (pin & 0x10);
+  #else
+    (void) pin;
+    return false;
+  #endif
+}
+#endif
+
+/* Oversampled and decimated read: 4^(res - 10) conversions back to back with the ADC free running,
+ * summed and shifted right by (res - 10), for up to 16 bits. res below 10 just drops the low bits
+ * of one conversion. Signed for bipolar differential readings. gain is as for analogGain() on the
+ * x41, and restored afterwards (0 means leave it be); elsewhere gain is part of the channel.
+ * Returns an ADC_ENH_ERROR_* code (all far below anything it could read) on failure. */
+int32_t analogReadEnh(uint8_t pin, uint8_t res, uint8_t gain) {
+  #ifndef ADCSRA
+    badCall("analogReadEnh() cannot be used on a part without an ADC");
+    return ADC_ENH_ERROR_NOT_SUPPORTED;
+  #else
+    if (__builtin_constant_p(res)) {
+      if (res < 8 || res > 16) {
+        badArg("analogReadEnh() resolution must be between 8 and 16 bits");
+      }
+    }
+    #if !defined(GSEL0)
+      if (__builtin_constant_p(gain) && gain > 1) {
+        badArg("gain is set through the channel used on this part - see the part-specific documentation.");
+      }
+    #endif
+    if (res < 8)  return ADC_ENH_ERROR_RES_TOO_LOW;
+    if (res > 16) return ADC_ENH_ERROR_RES_TOO_HIGH;
+    if (!(pin & 0x80)) {
+      pin = digitalPinToAnalogInput(pin);
+    }
+    #if defined(GSEL0)
+      uint8_t oldgain = analog_gain;
+      if (gain) {
+        analogGain(gain);
+      }
+      int err = _analogPrepare(pin);
+      analog_gain = oldgain;
+    #else
+      (void) gain;
+      int err = _analogPrepare(pin);
+    #endif
+    if (err) {
+      return (err == ADC_ERROR_BUSY ? ADC_ENH_ERROR_BUSY :
+             (err == ADC_ERROR_DISABLED ? ADC_ENH_ERROR_DISABLED : ADC_ENH_ERROR_BAD_PIN_OR_CHANNEL));
+    }
+    uint8_t shift = (res > 10 ? res - 10 : 0);
+    uint16_t count = 1 << (shift << 1);
+    bool sign = _adcSigned(pin);
+    int32_t sum = 0;
+    #if defined(ADTS0)
+      uint8_t adts = ADCSRB & ((1 << ADTS2) | (1 << ADTS1) | (1 << ADTS0));
+      ADCSRB &= ~((1 << ADTS2) | (1 << ADTS1) | (1 << ADTS0)); // free running
+    #endif
+    /* Each conversion starts as soon as the last one finishes, rather than on the next ADC clock
+     * after we get around to setting ADSC again - and without a call per conversion. Auto trigger
+     * is turned off during the last one, so it's the last. */
+    ADCSRA |= (1 << ADC_AUTO_BIT) | (1 << ADIF) | (1 << ADSC);
+    do {
+      if (count == 1) {
+        ADCSRA &= ~(1 << ADC_AUTO_BIT);
+      }
+      while (!(ADCSRA & (1 << ADIF)));
+      ADCSRA |= (1 << ADIF);
+      int16_t result = ADCW;
+      if (sign) {
+        result = (int16_t)(result << 6) >> 6;
+      }
+      sum += result;
+    } while (--count);
+    #if defined(ADTS0)
+      ADCSRB |= adts;
+    #endif
+    if (res < 10) {
+      return sum >> (10 - res);
+    }
+    return sum >> shift;
+  #endif
+}
+
+extern inline void analogWrite(uint8_t pin, int16_t val);
+
+volatile uint8_t _pwm_nowhere[2];
+
+void turnOnPWM(uint8_t timer) {
+  turnOnPWMFast(timer);
+}
+
+volatile uint8_t *timerToOCR(uint8_t timer) {
+  return timerToOCRFast(timer);
+}
+
+/* The timer and register are found the same way as for a constant pin in analogWrite() - it's just that it's done
+ * at runtime. The x41 and 828 used to swap the TOCC output enable bits the wrong way round here. */
+void _analogWrite(uint8_t pin, int16_t val) {
+  uint8_t timer = digitalPinToPWMTimer(pin);
   // let's wait until the end to set pinMode - why output an unknown value for a few dozen clock cycles while we sort out the pwm channel?
-  if (val <= 0) {
+  if (val <= 0 || (timer == NOT_ON_TIMER && val < 128)) {
     digitalWrite(pin, LOW);
-  } else if (val >= 255) {
+  } else if (val >= 255 || timer == NOT_ON_TIMER) {
     digitalWrite(pin, HIGH);
   } else {
-    uint8_t timer = digitalPinToTimer(pin);
-    #if defined(TOCPMCOE)
-      if (timer) {
-        uint8_t bitmask = timer & 0xF0;
-        if (timer & 0x08) {
-          _SWAP(bitmask);
-        }
-        timer &= 0x07;
-        switch (timer) {
-          case TIMER0A:
-            OCR0A = val;
-            break;
-          case TIMER1A:
-            OCR1A = val;
-            break;
-          case TIMER1B:
-            OCR1B = val;
-            break;
-          #if defined(TCCR2A)
-            // only test for these cases on x41
-            case TIMER2A:
-              OCR2A = val;
-              break;
-            case TIMER2B:
-              OCR2B = val;
-              break;
-            //end of x41-only
-          #endif
-          //case TIMER0B:
-          default:
-            // if it's not 0, and it's not one of the other timers, it's gotta be TIMER0B.
-            OCR0B = val;
-            break;
-        }
-        // In any event we can now switch OE for that pin.
-        TOCPMCOE |= bitmask;
-      } else // has to end with this, from if (timer)
-    #else //Non-TOCPMCOE implementation
-      // Timer0 has a output compare channel A (most parts)
-      #if defined(TCCR0A) && defined(COM0A1)
-        if (timer == TIMER0A) {
-          // connect pwm to pin on timer 0, channel A
-          TCCR0A |= (1 << COM0A1);
-          OCR0A = val; // set pwm duty
-        } else
-      #endif
-      // Timer0 has a output compare channel B (most parts)
-      #if defined(TCCR0A) && defined(COM0B1)
-        if (timer == TIMER0B) {
-          // connect pwm to pin on timer 0, channel B
-          TCCR0A |= (1 << COM0B1);
-          OCR0B = val; // set pwm duty
-        } else
-      #endif
-
-      // TCCR1E is present only on tinyx61 and tinyx7 and there's no TCCR1A on Tiny85
-      // Hence this line is approximately "If Timer1 has PWM, and isn't some wacky thing"
-      #if defined(TCCR1A) && defined(COM1A1) && !defined(TCCR1D)
-        //So this handles "normal" timers
-        if (timer == TIMER1A) {
-          // connect pwm to pin on timer 1, channel A
-          TCCR1A |= (1 << COM1A1);
-          OCR1A = val; // set pwm duty
-        } else
-      #endif
-      #if defined(TCCR1A) && defined(COM1B1) && !defined(TCCR1D)
-        if (timer == TIMER1B) {
-          // connect pwm to pin on timer 1, channel B
-          TCCR1A |= (1 << COM1B1);
-          OCR1B = val; // set pwm duty
-        } else
-      #endif
-      // Handle the Timer1 flexible PWM on the x7
-      #if !defined(TCCR1E) && defined(TCCR1D)
-        if (timer & 0xF0) { // x7 timer will be either 0x01 (Timer0A) or will be 0x_3 or 0x_4 with the
-          // high nybble containing bitmask for the enable pins.
-          // Timer 1 - we enable the COM1xn bits in init() so all we need to do is set OCR1x
-          // timer & 0xF0 gives the bitmask, and if it is to be swapped, swap it,
+    _pwmWriteOCR(timer, timerToOCRFast(timer), val);
+    turnOnPWMFast(timer);
+  }
+  pinMode(pin, OUTPUT);
+}
 
-          uint8_t bitmask = 0xF0 & timer;
-          if (timer & 0x04) {
-            OCR1B = val;
-          } else {
-            OCR1A = val;
-            _SWAP(bitmask); // Timer1A controls the low half of bits in the TCCR1D register.
-          }
-          TCCR1D |= bitmask;
-        } else
-      #endif
-      // ATtiny x61
-      #if defined(TCCR1E) //Tiny861
-        if (timer == TIMER1A) {
-          // connect pwm to pin on timer 1, channel A
-          TCCR1C |= (1 << COM1A1S);
-          OCR1A = val; // set pwm duty
-        } else if (timer == TIMER1B) {
-          // connect pwm to pin on timer 1, channel B
-          TCCR1C |= (1 << COM1B1S);
-          OCR1B = val; // set pwm duty
-        } else if (timer == TIMER1D) {
-          // connect pwm to pin on timer 1, channel D
-          TCCR1C |= (1 << COM1D1); /* #614 - not sure why I was doing it wrong for all PWM here.  */
-          OCR1D = val; // set pwm duty
-        } else
-      #endif
-      // ATtiny x5
-      #if defined(TCCR1) && defined(COM1A1)
-        if (timer == TIMER1A) {
-          // connect pwm to pin on timer 1, channel A
-          TCCR1 |= (1 << COM1A1);
-          OCR1A = val; // set pwm duty
-        } else
-      #endif
-      // ATtiny x5
-      #if defined(TCCR1) && defined(COM1B1)
-        if (timer == TIMER1B) {
-          // connect pwm to pin on timer 1, channel B
-          GTCCR |= (1 << COM1B1);
-          OCR1B = val; // set pwm duty
-        } else
-      #endif
-    #endif // end non-TOCPMCOE implementation
-    {
-      if (val < 128) {
-        digitalWrite(pin, LOW);
-      } else {
-        digitalWrite(pin, HIGH);
-      }
-    }
+uint8_t _pwmAttach(uint8_t pin) {
+  if (pin >= NUM_DIGITAL_PINS) {
+    return NOT_ON_TIMER;
+  }
+  uint8_t timer = digitalPinToPWMTimer(pin);
+  if (timer != NOT_ON_TIMER) {
+    turnOnPWMFast(timer);
+    pinMode(pin, OUTPUT);
   }
-  pinMode(pin,OUTPUT);
+  return timer;
 }
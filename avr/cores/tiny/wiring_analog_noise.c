@@ -5,5 +5,8 @@ int analogRead_NR(uint8_t pin) {
   return _analogRead(pin, true);
 }
 
-EMPTY_INTERRUPT(ADC_vect)
+/* Just has to wake us up. Weak, so that the one in wiring_analog_stream.c takes over if that's in use too */
+ISR(ADC_vect, ISR_NAKED __attribute__((weak))) {
+  reti();
+}
 #endif
@@ -0,0 +1,204 @@
+/* wiring_analog_stream.c - continuous, interrupt driven ADC sampling
+ * Part of ATTinyCore - github.com/SpenceKonde/ATTinyCore
+ *   Free Software - LGPL 2.1, please see LICENCE.md for details
+ *
+ * The ADC runs by itself - free running, or started by one of the auto trigger sources - and
+ * the ADC interrupt puts each result into a buffer supplied by the sketch, which is used as a
+ * ring. Given more than one channel, it steps through them in turn. The callback, if there is
+ * one, is called from the interrupt each time half the buffer has been filled, with a pointer
+ * to that half, which won't be written again until the other half has been. Otherwise, the
+ * sketch can just poll with analogStreamAvailable() and analogStreamRead().
+ *
+ * The ADC latches the channel when a conversion starts. Free running, the next one has already
+ * started by the time the interrupt runs, so the channel it selects is for the one after that;
+ * auto triggered, the next one hasn't started yet, so it's for that one. Either way, results
+ * come out in the order the channels were given.
+ *
+ * analogRead_NR() comes with an empty ADC interrupt; it's weak, so this one wins when both are
+ * used. It must not be called while a stream is running; analogRead() just returns
+ * ADC_ERROR_BUSY.
+ *---------------------------------------------------------------------------*/
+
+#include "wiring_private.h"
+#include "pins_arduino.h"
+#include <util/delay_basic.h>
+
+#if defined(ADCSRA)
+
+#ifndef ADC_STREAM_MAX_CHANNELS
+  #define ADC_STREAM_MAX_CHANNELS 8
+#endif
+
+/* The flags the named trigger sources set. The ADC only starts a conversion on the rising edge
+ * of one, so it has to be cleared in between; if the interrupt it belongs to is enabled, that
+ * has already done so by the time the conversion is finished, and this does nothing. */
+#if defined(ADTS0)
+  #if defined(TIFR0)
+    #define ADCS_TIFR   TIFR0
+  #else
+    #define ADCS_TIFR   TIFR
+  #endif
+  #if defined(EIFR)
+    #define ADCS_GIFR   EIFR
+  #else
+    #define ADCS_GIFR   GIFR
+  #endif
+  #if defined(ACSR)
+    #define ADCS_ACSR   ACSR
+    #define ADCS_ACI    ACI
+  #elif defined(ACSR0A) // x41 - it's comparator 0 that triggers the ADC
+    #define ADCS_ACSR   ACSR0A
+    #define ADCS_ACI    ACI0
+  #else
+    #define ADCS_ACSR   ACSRA
+    #define ADCS_ACI    ACI
+  #endif
+#endif
+
+static volatile bool      adcs_running;
+static uint16_t          *adcs_buffer;
+static uint8_t            adcs_length;
+static uint8_t            adcs_half;
+static volatile uint8_t   adcs_head;      // where the next result goes
+static volatile uint8_t   adcs_tail;      // the next one analogStreamRead() returns
+static volatile uint8_t   adcs_count;     // how many analogStreamRead() hasn't returned
+static uint8_t            adcs_channels[ADC_STREAM_MAX_CHANNELS];
+static uint8_t            adcs_nchannels;
+static uint8_t            adcs_next;      // index in adcs_channels of the one to select next
+static uint8_t            adcs_trigger;
+static void             (*adcs_callback)(uint16_t *samples, uint8_t count);
+
+static inline __attribute__((always_inline)) void adcs_clear_trigger(uint8_t trigger) {
+  #if defined(ADTS0)
+    switch (trigger) {
+      case ADC_TRIGGER_COMPARATOR:
+        ADCS_ACSR |= (1 << ADCS_ACI); // the only flag in there
+        break;
+      case ADC_TRIGGER_INT0:
+        ADCS_GIFR = (1 << INTF0);
+        break;
+      case ADC_TRIGGER_TIMER0_COMPA:
+        ADCS_TIFR = (1 << OCF0A);
+        break;
+      case ADC_TRIGGER_TIMER0_OVF:
+        ADCS_TIFR = (1 << TOV0);
+        break;
+    }
+  #else
+    (void) trigger;
+  #endif
+}
+
+bool analogStreamBegin(const uint8_t *pins, uint8_t pinCount, uint16_t *buffer, uint8_t length, uint8_t trigger, void (*callback)(uint16_t *samples, uint8_t count)) {
+  if (pinCount == 0 || pinCount > ADC_STREAM_MAX_CHANNELS || length < 2 || !(ADCSRA & (1 << ADEN))) {
+    return false;
+  }
+  #if defined(ADTS0)
+    if (trigger > ((1 << ADTS2) | (1 << ADTS1) | (1 << ADTS0))) return false;
+  #else
+    if (trigger != ADC_TRIGGER_FREE_RUNNING) return false;
+  #endif
+  analogStreamEnd();
+  for (uint8_t i = 0; i < pinCount; i++) {
+    uint8_t pin = pins[i];
+    if (!(pin & 0x80)) {
+      pin = digitalPinToAnalogInput(pin);
+      if (pin == NOT_A_PIN) return false;
+    }
+    adcs_channels[i] = pin;
+  }
+  uint8_t oldSREG = SREG;
+  cli();
+  adcs_buffer     = buffer;
+  adcs_length     = length;
+  adcs_half       = length >> 1;
+  adcs_head       = 0;
+  adcs_tail       = 0;
+  adcs_count      = 0;
+  adcs_nchannels  = pinCount;
+  adcs_trigger    = trigger;
+  adcs_callback   = callback;
+  adcs_running    = true;
+  _adcSelect(adcs_channels[0]);
+  #if defined(ADTS0)
+    ADCSRB = (ADCSRB & ~((1 << ADTS2) | (1 << ADTS1) | (1 << ADTS0))) | trigger;
+  #endif
+  if (trigger == ADC_TRIGGER_FREE_RUNNING) {
+    ADCSRA |= (1 << ADC_AUTO_BIT) | (1 << ADIE) | (1 << ADIF) | (1 << ADSC);
+    if (pinCount > 1) {
+      /* The channel can be changed 1 ADC clock after ADSC is set - 3 CPU clocks per count here
+       * makes that 1.5, and the second conversion doesn't start until 25 have gone by. */
+      _delay_loop_1(1 << (ADCSRA & ((1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0))));
+      _adcSelect(adcs_channels[1]);
+    }
+    adcs_next = (pinCount > 2 ? 2 : 0);
+  } else {
+    adcs_clear_trigger(trigger);
+    ADCSRA |= (1 << ADC_AUTO_BIT) | (1 << ADIE) | (1 << ADIF);
+    adcs_next = (pinCount > 1 ? 1 : 0);
+  }
+  SREG = oldSREG;
+  return true;
+}
+
+void analogStreamEnd(void) {
+  ADCSRA &= ~((1 << ADC_AUTO_BIT) | (1 << ADIE));
+  while (ADCSRA & (1 << ADSC)); // so the next analogRead() doesn't find it busy
+  ADCSRA |= (1 << ADIF);
+  #if defined(ADTS0)
+    ADCSRB &= ~((1 << ADTS2) | (1 << ADTS1) | (1 << ADTS0));
+  #endif
+  adcs_running = false;
+}
+
+uint8_t analogStreamAvailable(void) {
+  return adcs_count;
+}
+
+int analogStreamRead(void) {
+  uint8_t oldSREG = SREG;
+  cli();
+  if (!adcs_count) {
+    SREG = oldSREG;
+    return -1;
+  }
+  uint8_t t = adcs_tail;
+  uint16_t result = adcs_buffer[t];
+  if (++t == adcs_length) t = 0;
+  adcs_tail = t;
+  adcs_count--;
+  SREG = oldSREG;
+  return result;
+}
+
+ISR(ADC_vect) {
+  if (!adcs_running) {
+    return; // woken from analogRead_NR()
+  }
+  uint16_t result = ADCW;
+  adcs_clear_trigger(adcs_trigger);
+  if (adcs_nchannels > 1) {
+    uint8_t n = adcs_next;
+    _adcSelect(adcs_channels[n]);
+    if (++n == adcs_nchannels) n = 0;
+    adcs_next = n;
+  }
+  uint8_t h = adcs_head;
+  adcs_buffer[h] = result;
+  if (++h == adcs_length) h = 0;
+  adcs_head = h;
+  if (adcs_count == adcs_length) {
+    adcs_tail = h; // it was full, and the oldest one just got overwritten
+  } else {
+    adcs_count++;
+  }
+  if (adcs_callback) {
+    if (h == adcs_half) {
+      adcs_callback(adcs_buffer, adcs_half);
+    } else if (h == 0) {
+      adcs_callback(adcs_buffer + adcs_half, adcs_length - adcs_half);
+    }
+  }
+}
+
+#endif
@@ -11,9 +11,15 @@
 #include "wiring_private.h"
 #include "pins_arduino.h"
 
-
-
-void pinMode(uint8_t pin, uint8_t mode) {
+/* pinMode(), digitalWrite(), openDrain() and digitalRead() are inline (see Arduino.h), and only call these when the pin
+ * isn't a compile time constant. These declarations make this file the home of the non-inline copies the linker needs
+ * if anything takes their address. */
+extern inline void pinMode(uint8_t pin, uint8_t mode);
+extern inline void digitalWrite(uint8_t pin, uint8_t val);
+extern inline void openDrain(uint8_t pin, uint8_t val);
+extern inline int8_t digitalRead(uint8_t pin);
+
+void _pinMode(uint8_t pin, uint8_t mode) {
   if (pin > 127) {
     pin = analogInputToDigitalPin((pin & 127));
   }
@@ -54,85 +60,10 @@ void pinMode(uint8_t pin, uint8_t mode) {
 
 
 void turnOffPWM(uint8_t timer) {
-  #if defined(TOCPMCOE)
-    // No need to change the timer, just flip the bit in TOCPMCOE
-    if (timer) {                          //          All PWM on these parts is controlled like this (unlike the x7)
-      uint8_t bitmask = timer & 0xF0;     // mov andi Copy the portion that contains the bitmask;
-      if (!(timer & 0x08)) {              // sbrs     0x08 is set for the higher 4 bits, so we want to swap only if it's not set
-        _SWAP(bitmask);                   // swp
-      }
-      TOCPMCOE &= ~bitmask;               // com, sts
-      timer &= 0x07;
-    }
-  #else
-
-    #if defined(TCCR0A) && defined(COM0A1)
-      if( timer == TIMER0A) {
-        TCCR0A &= ~(1 << COM0A1);
-        // TCCR0A &= ~(1 << COM0A0); /* We do not clean up after user code that may have shat on a timer. */
-      } else
-    #endif
-    #if defined(TCCR0A) && defined(COM0B1)
-      if( timer == TIMER0B){
-        TCCR0A &= ~(1 << COM0B1);
-        // TCCR0A &= ~(1 << COM0B0); /* We do not clean up after user code that may have shat on a timer. */
-      } else
-    #endif
-    #ifdef __AVR_ATtinyX7__
-      if (timer & 0xF1) {               // It's one of the flex pins on timer1
-      // Timer1 on x7                   // Likely implementation:
-      uint8_t bitmask = timer & 0xF0;   // mov, andi
-      if (!(timer & 0x04)){             // sbrs
-        _SWAP(bitmask);                 // swp
-      }
-        TCCR1D &= (~bitmask);           // com, sts
-      }
-      // Using the swp instruction results in MUCH better code. The old way had a variable shift, which gets implemented as a tiny loop.
-      // Not terrible on code size or anything, but it can add two microseconds to execution time - unlike the modern AVRs where this
-      // function takes forever and a day to return, on classic parts, turnOffPWM otherwise takes **maybe** a microsecond.
-    #elif defined(TCCR1E)
-      // ATtiny x61
-      if( timer == TIMER1A) {
-        // disconnect pwm to pin on timer 1, channel A
-        TCCR1C &= ~(1 << COM1A1S);
-      } else if (timer == TIMER1B) {
-        // disconnect pwm to pin on timer 1, channel B
-        TCCR1C &= ~(1 << COM1B1S);
-      } else if (timer == TIMER1D) {
-        // disconnect pwm to pin on timer 1, channel D
-        TCCR1C &= ~(1 << COM1D1);
-      } else
-    #else
-      // Timer1 for non-x61/x7
-      #if defined(TCCR1) && defined(COM1A1) // x5
-        if(timer == TIMER1A) {
-          TCCR1 &= ~(1 << COM1A1);
-        } else
-      #endif
-      #if defined(TCCR1) && defined(COM1B1) // x5
-        if(timer == TIMER1B) {
-          GTCCR &= ~(1 << COM1B1);
-        } else
-      #endif
-      #if defined(TCCR1A) && defined(COM1A1) // civilized parts
-        if(timer == TIMER1A) {
-          TCCR1A &= ~(1 << COM1A1);
-        } else
-      #endif
-
-      #if defined(TCCR1A) && defined(COM1B1) // civilized parts
-        if(timer == TIMER1B) {
-          TCCR1A &= ~(1 << COM1B1);
-        } else
-      #endif
-    #endif
-    {
-      // dummy block to fill in the else statement
-    }
-  #endif
+  turnOffPWMFast(timer);
 }
 
-void digitalWrite(uint8_t pin, uint8_t val) {
+void _digitalWrite(uint8_t pin, uint8_t val) {
   if (pin > 127) {pin = analogInputToDigitalPin((pin & 127));}
   check_valid_digital_pin(pin);
   uint8_t timer = digitalPinToTimer(pin);
@@ -179,7 +110,7 @@ void digitalWrite(uint8_t pin, uint8_t val) {
   #endif
 }
 
-void openDrain(uint8_t pin, uint8_t val) {
+void _openDrain(uint8_t pin, uint8_t val) {
   if (pin > 127) {pin = analogInputToDigitalPin((pin & 127));}
   check_valid_digital_pin(pin);
   uint8_t timer = digitalPinToTimer(pin);
@@ -214,7 +145,7 @@ void openDrain(uint8_t pin, uint8_t val) {
 
 
 
-int8_t digitalRead(uint8_t pin)
+int8_t _digitalRead(uint8_t pin)
 {
   if (pin > 127) {
     pin = analogInputToDigitalPin((pin & 127));
@@ -237,3 +168,28 @@ int8_t digitalRead(uint8_t pin)
   }
   return LOW;
 }
+
+/* digitalWriteMulti() for pins that aren't known at compile time: the same, with the lookups done here */
+void _digitalWriteMulti(const uint8_t *pins, uint8_t count, uint32_t values) {
+  uint8_t mask[PD + 1] = {0};
+  uint8_t value[PD + 1] = {0};
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t pin = pins[i];
+    if (pin > 127) {
+      pin = analogInputToDigitalPin((pin & 127));
+    }
+    uint8_t port = digitalPinToPort(pin);
+    if (port == NOT_A_PORT) continue;
+    uint8_t timer = digitalPinToTimer(pin);
+    if (timer != NOT_ON_TIMER) turnOffPWM(timer);
+    uint8_t bit = digitalPinToBitMask(pin);
+    mask[port] |= bit;
+    if (values & 1) {
+      value[port] |= bit;
+    }
+    values >>= 1;
+  }
+  for (uint8_t port = PA; port <= PD; port++) {
+    portWrite(port, value[port], mask[port]);
+  }
+}
@@ -0,0 +1,196 @@
+/* wiring_millis.h - millis()/micros() arithmetic
+ * Part of ATTinyCore - github.com/SpenceKonde/ATTinyCore
+ *   Split out of wiring.c 2026 so that the host-side test in
+ *   extras/ci/host_tests can check exactly the arithmetic the core uses.
+ *   Free Software - LGPL 2.1, please see LICENCE.md for details
+ *
+ * This file must not depend on anything AVR-specific: it is only given F_CPU
+ * and MillisTimer_Prescale_Value, and everything in it is either a compile-time
+ * constant or a pure function of its arguments.
+ *---------------------------------------------------------------------------*/
+
+#ifndef WiringMillis_h
+#define WiringMillis_h
+
+#include <stdint.h>
+
+#if !defined(F_CPU) || !defined(MillisTimer_Prescale_Value)
+  #error "wiring_millis.h needs F_CPU and MillisTimer_Prescale_Value"
+#endif
+
+// the prescaler is set so that the millis timer ticks every MillisTimer_Prescale_Value (64) clock cycles, and the
+// the overflow handler is called every 256 ticks.
+/* The key is never to compute (F_CPU / 1000000L), which may lose precision.
+   The formula below is correct for all F_CPU times that evenly divide by 10,
+   at least for prescaler values up and including 64 as used in this file. */
+#if MillisTimer_Prescale_Value <= 64
+#define MICROSECONDS_PER_MILLIS_OVERFLOW \
+  (MillisTimer_Prescale_Value * 256UL * 1000UL * 100UL / ((F_CPU + 5UL) / 10UL))
+#elif MillisTimer_Prescale_Value <= 1024
+/* The tickless mode clocks the timer at up to /1024, which would roll over the
+   formula above, so here the 100 and the 10 trade places. This is exact for every
+   F_CPU that evenly divides by 100, which all the clocks in boards.txt do, and
+   EXACT_NUMERATOR below still fits (1024 * 256 * 12500 < 2^32). */
+#define MICROSECONDS_PER_MILLIS_OVERFLOW \
+  (MillisTimer_Prescale_Value * 256UL * 1000UL * 10UL / ((F_CPU + 50UL) / 100UL))
+#else
+#define MICROSECONDS_PER_MILLIS_OVERFLOW 0
+#error "Please adjust MICROSECONDS_PER_MILLIS_OVERFLOW formula"
+#endif
+
+/* Correct millis to zero long term drift
+   --------------------------------------
+
+   When MICROSECONDS_PER_MILLIS_OVERFLOW >> 3 is exact, we do nothing.
+   In this case, millis() has zero long-term drift, that is,
+   it precisely follows the oscillator used for timing.
+
+   When it has a fractional part that leads to an error when ignored,
+   we apply a correction.  This correction yields a drift of 30 ppm or less:
+   1e6 / (512 * (minimum_MICROSECONDS_PER_MILLIS_OVERFLOW >> 3)) <= 30.
+
+   The mathematics of the correction are coded in the preprocessor and
+   produce compile-time constants that do not affect size or run time.
+ */
+
+/* We cancel a factor of 10 in the ratio MICROSECONDS_PER_MILLIS_OVERFLOW
+   and divide the numerator by 8.  The calculation fits into a long int
+   and produces the same right shift by 3 as the original code.
+ */
+#define EXACT_NUMERATOR (MillisTimer_Prescale_Value * 256UL * 12500UL)
+#define EXACT_DENOMINATOR ((F_CPU + 5UL) / 10UL)
+
+/* The remainder is an integer in the range [0, EXACT_DENOMINATOR). */
+#define EXACT_REMAINDER \
+  (EXACT_NUMERATOR - (EXACT_NUMERATOR / EXACT_DENOMINATOR) * EXACT_DENOMINATOR)
+
+/* If the remainder is zero, MICROSECONDS_PER_MILLIS_OVERFLOW is exact.
+
+   Otherwise we compute the fractional part and approximate it by the closest
+   rational number n / 256.  Effectively, we increase millis accuracy by 512x.
+
+   We compute n by scaling down the remainder to the range [0, 256].
+   The two extreme cases 0 and 256 require only trivial correction.
+   All others are handled by an uint8_t counter in millis().
+ */
+#define CORRECT_FRACT_PLUSONE // possibly needed for high/cheap corner case
+#if EXACT_REMAINDER > 0
+#define CORRECT_EXACT_MILLIS // enable zero drift correction in millis()
+#define CORRECT_EXACT_MANY \
+  ((2U * 256U * EXACT_REMAINDER + EXACT_DENOMINATOR) / (2U * EXACT_DENOMINATOR))
+#if CORRECT_EXACT_MANY < 0 || CORRECT_EXACT_MANY > 256
+#error "Miscalculation in millis() exactness correction"
+#endif
+#if CORRECT_EXACT_MANY == 0 // low/cheap corner case
+#undef CORRECT_EXACT_MILLIS // go back to nothing for millis only
+#elif CORRECT_EXACT_MANY == 256 // high/cheap corner case
+#undef CORRECT_EXACT_MILLIS // go back to nothing for millis only
+#undef CORRECT_FRACT_PLUSONE // but use this macro...
+#define CORRECT_FRACT_PLUSONE + 1 // ...to add 1 more to fract every time
+#endif // cheap corner cases
+#endif // EXACT_REMAINDER > 0
+/* End of preparations for exact millis() with oddball frequencies */
+
+// the whole number of milliseconds per millis timer overflow
+#define MILLIS_INC (MICROSECONDS_PER_MILLIS_OVERFLOW / 1000U)
+
+// the fractional number of milliseconds per millis timer overflow. we shift right
+// by three to fit these numbers into a byte. (for the clock speeds we care
+// about - 8 and 16 MHz - this doesn't lose precision.)
+#define FRACT_INC (((MICROSECONDS_PER_MILLIS_OVERFLOW % 1000U) >> 3) \
+                   CORRECT_FRACT_PLUSONE)
+#define FRACT_MAX (1000U >> 3)
+
+/* micros()
+   --------
+
+   micros() is built from the same millis_timer_millis and millis_timer_fract
+   that millis() uses, so it shares their zero long-term drift:
+
+     micros = millis * 1000 + fract * 8 + (timer ticks since the last overflow, in us)
+
+   Each overflow moves the first two terms forward by MICROS_PER_OVERFLOW_STEP,
+   or by 8 more than that when the exactness correction adds a fract. The last
+   term has to stay below the smallest of those steps or micros() would jump
+   backwards at the overflow, so we scale the timer by MICROS_PER_OVERFLOW_STEP
+   rather than the true MICROSECONDS_PER_MILLIS_OVERFLOW. That is a reciprocal
+   in 8.8 fixed point (microseconds per 256 timer ticks), fixed at compile time;
+   within one overflow it runs at most 8 us behind, and it can never get ahead.
+
+   There is no hardware multiplier on any classic tiny, so the multiply is a
+   shift-and-add over the 8 bits of the timer - never over the bits of the
+   constant, which is what used to make the cost depend on F_CPU. It takes the
+   same 8 passes on every clock.
+ */
+#define MICROS_PER_OVERFLOW_STEP (MILLIS_INC * 1000UL + (FRACT_INC) * 8UL)
+
+#if MICROS_PER_OVERFLOW_STEP > 65536UL
+  #error "Millis timer overflows too slowly for micros() - 255 ticks would not fit the 24-bit accumulator"
+#endif
+
+#if defined(__AVR__)
+  typedef __uint24 micros_acc_t;
+#else
+  typedef uint32_t micros_acc_t;
+#endif
+
+// ticks * MICROS_PER_OVERFLOW_STEP / 256, rounded down
+static inline uint16_t micros_ticks_to_us(uint8_t ticks) {
+  micros_acc_t acc = 0;
+  uint8_t i = 8;
+  do {
+    acc <<= 1;
+    if (ticks & 0x80) {
+      acc += MICROS_PER_OVERFLOW_STEP;
+    }
+    ticks <<= 1;
+  } while (--i);
+  return (uint16_t)(acc >> 8);
+}
+
+/* m, f and t as read with interrupts off; pending is nonzero if the overflow
+   flag was set (and the timer had visibly wrapped) - that is, the ISR has an
+   overflow to account for that it hasn't gotten to yet. */
+static inline uint32_t micros_from_parts(uint32_t m, uint8_t f, uint8_t ticks, uint8_t pending) {
+  // m * 1000 + f * 8, without a multiply: ((m * 128 - m * 2 - m) + f) * 8
+  m = (((m << 7) - (m << 1) - m + f) << 3);
+  if (pending) {
+    m += MICROS_PER_OVERFLOW_STEP;
+  }
+  return m + micros_ticks_to_us(ticks);
+}
+
+/* Tickless millis()
+   -----------------
+
+   With the timer overflowing only every 16-65 ms, millis_timer_millis alone
+   would be far too coarse, so millis() in that mode is built from the same
+   parts as micros(), and is exactly micros_from_parts() / 1000. Everything
+   past m is counted in units of 8 us, which is exact because f is, and
+   MICROS_PER_OVERFLOW_STEP is a multiple of 8, and it fits in 16 bits. */
+static inline uint32_t millis_from_parts(uint32_t m, uint8_t f, uint8_t ticks, uint8_t pending) {
+  uint16_t eighths = f + (micros_ticks_to_us(ticks) >> 3);
+  if (pending) {
+    eighths += (uint16_t)(MICROS_PER_OVERFLOW_STEP >> 3);
+  }
+  return m + eighths / 125;
+}
+
+/* For the tickless delay(): the first timer value at which micros() will
+   have gone us microseconds past micros_from_parts(m, f, 0, 0), for
+   0 < us <= micros_ticks_to_us(255). It is a search over the very function
+   micros() uses, rather than a division, so waking up on that tick means the
+   deadline has been reached - never one tick short of it. */
+static inline uint8_t micros_deadline_tick(uint16_t us) {
+  uint8_t t = 0;
+  uint8_t bit = 0x80;
+  do {
+    if (micros_ticks_to_us(t | bit) < us) {
+      t |= bit;
+    }
+    bit >>= 1;
+  } while (bit);
+  return t + 1;
+}
+
+#endif
@@ -173,6 +173,105 @@ uint32_t countPulseASM(volatile uint8_t *port, uint8_t bit, uint8_t stateMask, u
 
 typedef void (*voidFuncPtr)(void);
 
+#ifndef DISABLEMILLIS
+  /* Shared between the millis ISR in wiring.c and the software timers in wiring_timers.c.
+   * The ISR only looks further than timer_wheel_state when a timer is running, and all it does
+   * is flip it to READY once millis reaches timer_wheel_due (the earliest deadline - or one
+   * that has since been cancelled, which costs nothing but a pass through timerDispatch()). */
+  #define TIMER_WHEEL_IDLE      0
+  #define TIMER_WHEEL_ARMED     1
+  #define TIMER_WHEEL_READY     2
+  extern volatile uint8_t  timer_wheel_state;
+  extern volatile uint32_t timer_wheel_due;
+#endif
+
+/* ADC reference and channel masks. These are pre-shifted, as are the constants
+ * Don't calculate at runtime what you could have
+ * calculated at compile time! */
+#if defined(REFS2)
+  #if defined(ADMUXB)
+    #define ADMUX_REFS_MASK (0xE0) /* 841/441 */
+  #else
+    #define ADMUX_REFS_MASK (0xD0) /* x5/x61 - not used for x61 */
+  #endif
+#elif defined(REFS1)
+  #define ADMUX_REFS_MASK (0xC0) /* 3 or 4 options, generally internal 1.1v, Vcc, and external */
+#elif defined(REFS0)
+  #define ADMUX_REFS_MASK (0x40) /* Everything with just Vcc and internal 1.1v */
+#else
+  #define ADMUX_REFS_MASK (0x20) /* 828 , whose sole REFS bit has no number*/
+#endif
+
+#if (defined(MUX5) && !defined(REFS0)) /* need to exclude the 828, which has it's vestigal MUX5 bit on ADMUXB */
+  #define ADMUX_MUX_MASK (0x3f)
+#elif defined(MUX4)
+  #define ADMUX_MUX_MASK (0x1f)
+#elif defined(MUX3)
+  #define ADMUX_MUX_MASK (0x0f)
+#else
+  #define ADMUX_MUX_MASK (0x07)
+#endif
+
+#if defined(ADCSRA)
+  /* Shared between _analogRead() and the continuous sampling in wiring_analog_stream.c, which
+   * switches channels from the ADC interrupt. */
+  /* Auto trigger enable - the tiny26 can only free run, and calls it that */
+  #if defined(ADATE)
+    #define ADC_AUTO_BIT ADATE
+  #else
+    #define ADC_AUTO_BIT ADFR
+  #endif
+
+  extern uint8_t analog_reference;
+  #if defined(GSEL0)
+    extern uint8_t analog_gain;
+  #endif
+
+  /* Select the channel, along with the reference (and gain, on the x41) - pin is an analog channel
+   * with the high bit set, as from digitalPinToAnalogInput() or ADC_CH() */
+  static inline __attribute__((always_inline)) void _adcSelect(uint8_t pin) {
+    /* Important difference from stock core: reference constants like DEFAULT,
+     * INTERNAL1V1, and so on have the reference bits PRESHIFTED to their
+     * final positions. Thus, we just OR them with the pin or w/e else goes in
+     * the register. New in ATTinyCore 2.0.0  - saves around 30 clock cycles
+     * and 24 bytes of flash, more on some parts; turns out a << 6 takes more
+     * work than you'd think; integer promotion hurts. */
+    #if defined(__AVR_ATtinyX61__)
+      // This one is wacky - with pre-shifting analog reference is this:
+      //            REFS1 | REFS0 |   -   | REFS2 | -    |   -   |   -   |   -
+      // Channels     -   | GSEL  |  MUX5 | MUX4  | MUX3 | MUX2  | MUX1  | MUX0
+      // and relevant registers:
+      // ADCSRB       BIN | GSEL  |   -   | REFS2 | MUX5 | ADTS2 | ADTS1 | ADTS0
+      // ADMUX      REFS1 | REFS0 | ADLAR | MUX4  | MUX3 | MUX2  | MUX1  | MUX0
+
+      ADMUX = ((analog_reference & 0xC0) | (pin & 0x1F));
+      // 1 ref bit, 1 mux bit, and the gain sel bit are scattered in ADCSRB, and we can't blow away it's contents because that's where we store unipolar vs bipolar mode setting too...
+      ADCSRB = (ADCSRB & (0xA7)) | (analog_reference & 0x10) | (pin & 0x40) | ((pin & 0x20) >> 2);
+      // ADCSRB = (ADCSRB & (0xA7)) | (analog_reference & 0x10) | (pin & 0x40) | ((pin & 0x20)?0x08:0);
+    #elif defined(ADMUXB)
+      #if defined(GSEL0)
+        // x41
+        ADMUXA = pin & 0x3f;
+        ADMUXB = (analog_reference & ADMUX_REFS_MASK) | analog_gain;
+      #else
+        // 828
+        ADMUXA = pin & 0x1f;
+        ADMUXB = analog_reference & ADMUX_REFS_MASK;
+      #endif
+    #elif defined(ADMUX)
+      ADMUX = ((analog_reference & ADMUX_REFS_MASK) | (pin & ADMUX_MUX_MASK)); //select the channel and reference
+      #ifdef AMISCR
+        //ATtiny87/167 external reference is selected by AREFEN bit in AMISCR. Internal reference is output if XREFEN bit is set.
+        // | - | - | - | - | - | AREFEN | XREFEN | ISRCEN |
+        AMISCR = (AMISCR & 0x01) | (analog_reference & 0x06);
+      #endif
+      #if defined(__AVR_ATtinyX5__)
+        ADCSRB = (ADCSRB & (~(1 << IPR))) | (pin & (1 << IPR));
+      #endif
+    #endif
+  }
+#endif
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -23,33 +23,201 @@
 */
 
 #include "wiring_private.h"
+#include "pins_arduino.h"
 
-uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder) {
-  uint8_t value = 0;
-  uint8_t i;
+/* The versions of shiftOut() and shiftIn() for pins that aren't known at compile time (see Arduino.h), and the buffer
+ * versions. The pin tables are looked up once per call, not for every bit, and each bit is written with interrupts
+ * disabled, as digitalWrite() would - or, on the SPI or USI pins, the shift register there does the work. */
 
-  for (i = 0; i < 8; ++i) {
-    digitalWrite(clockPin, HIGH);
-    if (bitOrder == LSBFIRST)
-      value |= digitalRead(dataPin) << i;
-    else
-      value |= digitalRead(dataPin) << (7 - i);
-    digitalWrite(clockPin, LOW);
-  }
-  return value;
+static uint8_t shiftReverse(uint8_t b) {
+  _SWAP(b);
+  b = ((b & 0xCC) >> 2) | ((b & 0x33) << 2);
+  return ((b & 0xAA) >> 1) | ((b & 0x55) << 1);
 }
 
-void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val)
-{
-  uint8_t i;
+#if defined(SHIFT_HW_DO)
+  /* Free, and safe to use: not enabled by SPI (or Wire, on the USI). Shifting in, the data out pin gets driven too,
+   * so that has to be an input already. And in SPI master mode, SS, if it's an input, has to stay high throughout,
+   * or the SPI module drops out of master mode. */
+  static bool shiftHWAvailable(bool in) {
+    #if defined(SPDR)
+      if (SPCR & _BV(SPE)) return false;
+      uint8_t port = digitalPinToPort(SS);
+      uint8_t mask = digitalPinToBitMask(SS);
+      if (!((*portModeRegister(port) | *portInputRegister(port)) & mask)) return false;
+    #else
+      if (USICR & (_BV(USIWM1) | _BV(USIWM0))) return false;
+    #endif
+    if (in) {
+      return !(*portModeRegister(digitalPinToPort(SHIFT_HW_DO)) & digitalPinToBitMask(SHIFT_HW_DO));
+    }
+    return true;
+  }
+
+  /* Shifts length bytes through the SPI or USI, writing the ones that come in back to buffer if in is set.
+   * Out is SPI mode 0 - the data changes while the clock is low, for the device to read as it goes high - and in
+   * is mode 1, where the device changes it when the clock goes high, and it's read as it goes low, just as the
+   * software versions do it. The clock is left low, as it was found. */
+  static void shiftHW(uint8_t bitOrder, uint8_t *buffer, size_t length, bool in) {
+    #if defined(SPDR)
+      uint8_t oldSPSR = SPSR;
+      SPSR = (in ? 0 : _BV(SPI2X));
+      SPCR = _BV(SPE) | _BV(MSTR) | (bitOrder == LSBFIRST ? _BV(DORD) : 0) | (in ? _BV(CPHA) : 0);
+      while (length--) {
+        SPDR = *buffer;
+        while (!(SPSR & _BV(SPIF)));
+        if (in) {
+          *buffer = SPDR;
+        }
+        buffer++;
+      }
+      SPCR = 0;
+      SPSR = oldSPSR;
+    #else
+      /* Each write of strobe toggles USCK and clocks the counter; it overflows after 16, which is 8 bits. */
+      uint8_t strobe = _BV(USIWM0) | _BV(USICS1) | _BV(USICLK) | _BV(USITC) | (in ? _BV(USICS0) : 0);
+      while (length--) {
+        uint8_t c = *buffer;
+        if (bitOrder == LSBFIRST) {
+          c = shiftReverse(c); // the USI only does MSB first
+        }
+        USIDR = c;
+        USISR = _BV(USIOIF);
+        USICR = strobe & ~_BV(USITC); // three-wire mode first, so DO has the first bit before the first edge
+        do {
+          USICR = strobe;
+        } while (!(USISR & _BV(USIOIF)));
+        if (in) {
+          c = USIDR;
+          *buffer = (bitOrder == LSBFIRST ? shiftReverse(c) : c);
+        }
+        buffer++;
+      }
+      USICR = 0;
+    #endif
+  }
+#endif
 
-  for (i = 0; i < 8; i++)  {
-    if (bitOrder == LSBFIRST)
-      digitalWrite(dataPin, !!(val & (1 << i)));
-    else
-      digitalWrite(dataPin, !!(val & (1 << (7 - i))));
+void shiftOutBuf(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, const uint8_t *buffer, size_t length) {
+  if (dataPin > 127) {
+    dataPin = analogInputToDigitalPin((dataPin & 127));
+  }
+  if (clockPin > 127) {
+    clockPin = analogInputToDigitalPin((clockPin & 127));
+  }
+  uint8_t dport = digitalPinToPort(dataPin);
+  uint8_t cport = digitalPinToPort(clockPin);
+  if (dport == NOT_A_PORT || cport == NOT_A_PORT || !length) return;
+  uint8_t timer = digitalPinToTimer(dataPin);
+  if (timer != NOT_ON_TIMER) turnOffPWM(timer);
+  timer = digitalPinToTimer(clockPin);
+  if (timer != NOT_ON_TIMER) turnOffPWM(timer);
+  volatile uint8_t *dout = portOutputRegister(dport);
+  volatile uint8_t *cout = portOutputRegister(cport);
+  uint8_t dmask = digitalPinToBitMask(dataPin);
+  uint8_t cmask = digitalPinToBitMask(clockPin);
+  #if defined(SHIFT_HW_DO)
+    if (dataPin == SHIFT_HW_DO && clockPin == SHIFT_HW_SCK && shiftHWAvailable(false)) {
+      uint8_t last = buffer[length - 1];
+      uint8_t oldSREG = SREG;
+      cli();
+      *cout &= ~cmask;
+      SREG = oldSREG;
+      shiftHW(bitOrder, (uint8_t *)buffer, length, false);
+      // and the data pin goes back to PORTx - so put the last bit there, as if it had been done in software.
+      last &= (bitOrder == LSBFIRST ? 0x80 : 0x01);
+      oldSREG = SREG;
+      cli();
+      if (last) {
+        *dout |= dmask;
+      } else {
+        *dout &= ~dmask;
+      }
+      SREG = oldSREG;
+      return;
+    }
+  #endif
+  while (length--) {
+    uint8_t val = *buffer++;
+    if (bitOrder == LSBFIRST) {
+      val = shiftReverse(val);
+    }
+    for (uint8_t i = 0; i < 8; i++) {
+      uint8_t oldSREG = SREG;
+      cli();
+      if (val & 0x80) {
+        *dout |= dmask;
+      } else {
+        *dout &= ~dmask;
+      }
+      *cout |= cmask;
+      *cout &= ~cmask;
+      SREG = oldSREG;
+      val <<= 1;
+    }
+  }
+}
 
-    digitalWrite(clockPin, HIGH);
-    digitalWrite(clockPin, LOW);
+void shiftInBuf(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t *buffer, size_t length) {
+  if (dataPin > 127) {
+    dataPin = analogInputToDigitalPin((dataPin & 127));
   }
+  if (clockPin > 127) {
+    clockPin = analogInputToDigitalPin((clockPin & 127));
+  }
+  uint8_t dport = digitalPinToPort(dataPin);
+  uint8_t cport = digitalPinToPort(clockPin);
+  if (dport == NOT_A_PORT || cport == NOT_A_PORT) {
+    while (length--) {
+      *buffer++ = 0;
+    }
+    return;
+  }
+  uint8_t timer = digitalPinToTimer(clockPin);
+  if (timer != NOT_ON_TIMER) turnOffPWM(timer);
+  volatile uint8_t *din  = portInputRegister(dport);
+  volatile uint8_t *cout = portOutputRegister(cport);
+  uint8_t dmask = digitalPinToBitMask(dataPin);
+  uint8_t cmask = digitalPinToBitMask(clockPin);
+  #if defined(SHIFT_HW_DI)
+    if (dataPin == SHIFT_HW_DI && clockPin == SHIFT_HW_SCK && shiftHWAvailable(true)) {
+      uint8_t oldSREG = SREG;
+      cli();
+      *cout &= ~cmask;
+      SREG = oldSREG;
+      shiftHW(bitOrder, buffer, length, true);
+      return;
+    }
+  #endif
+  while (length--) {
+    uint8_t value = 0;
+    for (uint8_t i = 0; i < 8; i++) {
+      uint8_t oldSREG = SREG;
+      cli();
+      *cout |= cmask;
+      value <<= 1;
+      if (*din & dmask) {
+        value |= 1;
+      }
+      *cout &= ~cmask;
+      SREG = oldSREG;
+    }
+    *buffer++ = (bitOrder == LSBFIRST ? shiftReverse(value) : value);
+  }
+}
+
+/* shiftOut() and shiftIn() are inline (see Arduino.h) and only call these when the pins or bit order aren't compile
+ * time constants. These declarations make this file the home of the non-inline copies the linker needs if anything
+ * takes their address. */
+extern inline void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val);
+extern inline uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder);
+
+void _shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val) {
+  shiftOutBuf(dataPin, clockPin, bitOrder, &val, 1);
+}
+
+uint8_t _shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder) {
+  uint8_t value;
+  shiftInBuf(dataPin, clockPin, bitOrder, &value, 1);
+  return value;
 }
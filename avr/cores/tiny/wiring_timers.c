@@ -0,0 +1,224 @@
+/* wiring_timers.c - software timers, run from yield()
+ * Part of ATTinyCore - github.com/SpenceKonde/ATTinyCore
+ *   Free Software - LGPL 2.1, please see LICENCE.md for details
+ *
+ * timerOnce() and timerEvery() put a callback on a small timer wheel: a fixed
+ * pool of entries, hashed by deadline into TIMER_WHEEL_SLOTS lists, each slot
+ * covering 16 ms. Starting or cancelling a timer is a couple of list link
+ * updates, whatever else is running.
+ *
+ * The millis ISR holds only the earliest deadline; when millis gets there it
+ * sets timer_wheel_state to READY, and that one byte is all timerDispatch()
+ * (called from yield(), and after every pass through loop()) looks at until
+ * then. Once it's READY, we walk just the slots the clock has moved through
+ * since the last time, run whatever is due, and find the new earliest
+ * deadline. With nothing running, the ISR tests one byte and that's it.
+ *
+ * Callbacks run from timerDispatch(), not from the ISR, so they can do
+ * whatever loop() could - including starting and cancelling timers - but it
+ * also means they run late if the sketch doesn't get back to loop() or
+ * delay(). Timers can't be started or cancelled from an interrupt.
+ *
+ * None of this is linked in unless the sketch calls timerOnce() or timerEvery();
+ * wiring.c has a weak, empty timerDispatch() that stands in for it.
+ *---------------------------------------------------------------------------*/
+
+#include "wiring_private.h"
+
+#ifndef DISABLEMILLIS
+
+#if TIMER_POOL_SIZE > 15
+  #error "TIMER_POOL_SIZE can be no more than 15; the handle only has room for a 4-bit id"
+#endif
+
+#define TIMER_WHEEL_SLOTS   8
+#define TIMER_WHEEL_SHIFT   4 // each slot covers 16 ms, so the wheel goes around every 128
+
+#define TIMER_FREE          0
+#define TIMER_RUNNING       1 // linked into its wheel slot
+#define TIMER_FIRING        2 // taken off the wheel by timerDispatch(), on its list of ones to run
+#define TIMER_CANCELLED     3 // cancelled while FIRING; timerDispatch() frees it when it gets there
+
+typedef struct {
+  uint32_t due;
+  uint32_t period;          // 0 for timerOnce()
+  voidFuncPtr callback;
+  uint8_t next;             // Entries are referred to by index + 1, so that 0 can mean "none"
+  uint8_t prev;             // and all of this can start out zeroed in .bss.
+  uint8_t gen;              // upper nybble of the handle, bumped each time the entry is freed
+  uint8_t state;
+} soft_timer_t;
+
+static soft_timer_t timer_pool[TIMER_POOL_SIZE];
+static uint8_t timer_wheel[TIMER_WHEEL_SLOTS];
+static uint8_t timer_free;  // head of the list of freed entries
+static uint8_t timer_fresh; // number of entries ever handed out
+static uint32_t timer_cursor; // millis >> TIMER_WHEEL_SHIFT as of the last walk around the wheel
+
+#define TIMER(id) (&timer_pool[(id) - 1])
+
+static uint8_t timer_slot(uint32_t t) {
+  return (uint8_t)(t >> TIMER_WHEEL_SHIFT) & (TIMER_WHEEL_SLOTS - 1);
+}
+
+static void timer_link(uint8_t id) {
+  soft_timer_t *e = TIMER(id);
+  uint8_t *head = &timer_wheel[timer_slot(e->due)];
+  e->prev = 0;
+  e->next = *head;
+  if (*head) {
+    TIMER(*head)->prev = id;
+  }
+  *head = id;
+  e->state = TIMER_RUNNING;
+}
+
+static void timer_unlink(uint8_t id) {
+  soft_timer_t *e = TIMER(id);
+  if (e->prev) {
+    TIMER(e->prev)->next = e->next;
+  } else {
+    timer_wheel[timer_slot(e->due)] = e->next;
+  }
+  if (e->next) {
+    TIMER(e->next)->prev = e->prev;
+  }
+}
+
+static void timer_release(uint8_t id) {
+  soft_timer_t *e = TIMER(id);
+  e->state = TIMER_FREE;
+  e->gen = (e->gen + 0x10);
+  e->next = timer_free;
+  timer_free = id;
+}
+
+// Tell the ISR about a deadline, if it is earlier than the one it is watching for.
+static void timer_arm(uint32_t due) {
+  uint8_t oldSREG = SREG;
+  cli();
+  uint8_t state = timer_wheel_state;
+  if (state == TIMER_WHEEL_IDLE || (state == TIMER_WHEEL_ARMED && (int32_t)(due - timer_wheel_due) < 0)) {
+    timer_wheel_due = due;
+    timer_wheel_state = TIMER_WHEEL_ARMED;
+  }
+  SREG = oldSREG;
+}
+
+static uint8_t timer_start(uint32_t ms, uint32_t period, voidFuncPtr callback) {
+  uint8_t id = timer_free;
+  if (id) {
+    timer_free = TIMER(id)->next;
+  } else if (timer_fresh < TIMER_POOL_SIZE) {
+    id = ++timer_fresh;
+  } else {
+    return 0; // pool is full
+  }
+  soft_timer_t *e = TIMER(id);
+  e->due = millis() + ms;
+  e->period = period;
+  e->callback = callback;
+  timer_link(id);
+  timer_arm(e->due);
+  return e->gen | id;
+}
+
+uint8_t timerOnce(uint32_t ms, void (*callback)(void)) {
+  return timer_start(ms, 0, callback);
+}
+
+uint8_t timerEvery(uint32_t ms, void (*callback)(void)) {
+  if (ms == 0) {
+    return 0; // would never let loop() run again
+  }
+  return timer_start(ms, ms, callback);
+}
+
+bool timerCancel(uint8_t handle) {
+  uint8_t id = handle & 0x0F;
+  if (id == 0 || id > TIMER_POOL_SIZE) {
+    return false;
+  }
+  soft_timer_t *e = TIMER(id);
+  if (e->gen != (handle & 0xF0)) {
+    return false; // it already finished, and the entry may belong to some other timer now
+  }
+  if (e->state == TIMER_RUNNING) {
+    // The ISR may still be waiting for this one's deadline; that just costs one pointless walk.
+    timer_unlink(id);
+    timer_release(id);
+    return true;
+  }
+  if (e->state == TIMER_FIRING) {
+    e->state = TIMER_CANCELLED;
+    return true;
+  }
+  return false;
+}
+
+void timerDispatch(void) {
+  if (timer_wheel_state != TIMER_WHEEL_READY) {
+    return;
+  }
+  // Nothing else writes the state while it is READY, and we re-arm it below.
+  timer_wheel_state = TIMER_WHEEL_IDLE;
+  uint32_t now = millis();
+  uint32_t passed = (now >> TIMER_WHEEL_SHIFT) - timer_cursor;
+  uint8_t slot = (uint8_t)timer_cursor & (TIMER_WHEEL_SLOTS - 1);
+  uint8_t steps = (passed >= TIMER_WHEEL_SLOTS) ? TIMER_WHEEL_SLOTS : (uint8_t)passed + 1;
+  uint8_t ready = 0, tail = 0;
+  timer_cursor = now >> TIMER_WHEEL_SHIFT;
+  /* Every deadline is at or after the cursor, because the cursor is never ahead of millis(),
+   * so everything that is due is in one of the slots between the cursor and now. Take those
+   * off the wheel first, since the callbacks are free to start and cancel timers. */
+  do {
+    uint8_t id = timer_wheel[slot];
+    while (id) {
+      soft_timer_t *e = TIMER(id);
+      uint8_t next = e->next;
+      if ((int32_t)(now - e->due) >= 0) {
+        timer_unlink(id);
+        e->state = TIMER_FIRING;
+        e->next = 0;
+        if (tail) {
+          TIMER(tail)->next = id;
+        } else {
+          ready = id;
+        }
+        tail = id;
+      }
+      id = next;
+    }
+    slot = (slot + 1) & (TIMER_WHEEL_SLOTS - 1);
+  } while (--steps);
+
+  while (ready) {
+    uint8_t id = ready;
+    soft_timer_t *e = TIMER(id);
+    ready = e->next;
+    if (e->state == TIMER_FIRING) {
+      e->callback();
+    }
+    if (e->state == TIMER_FIRING && e->period) {
+      e->due += e->period;
+      if ((int32_t)(now - e->due) >= 0) {
+        // Fell more than a whole period behind - skip the ones we missed rather than run them back to back.
+        e->due = now + e->period;
+      }
+      timer_link(id);
+    } else {
+      timer_release(id);
+    }
+  }
+
+  // Whatever is running now, the ISR needs the earliest of their deadlines.
+  uint8_t i = TIMER_POOL_SIZE;
+  do {
+    soft_timer_t *e = &timer_pool[i - 1];
+    if (e->state == TIMER_RUNNING) {
+      timer_arm(e->due);
+    }
+  } while (--i);
+}
+
+#endif
@@ -0,0 +1,97 @@
+/* bench.h - markers for the simulator benchmark harness
+ * Part of ATTinyCore - github.com/SpenceKonde/ATTinyCore
+ * Free Software - LGPL 2.1, please see LICENCE.md for details
+ *
+ * The benchmark sketch never measures anything itself - that would need a free
+ * timer running at the system clock, and on half the parts we support there is
+ * no such thing once millis and PWM have taken theirs. Instead we hand the
+ * measurement to the simulator: simavr records GPIOR0 (which benchmark is
+ * running) and GPIOR1 (1 while inside a measured region) into a VCD trace, and
+ * run_benchmarks.py converts the timestamps of the edges on GPIOR1 back into
+ * clock cycles. A region only counts if GPIOR0 holds the same id at both ends.
+ *
+ * GPIOR0 and GPIOR1 are in the low I/O space on every part that has them, so
+ * BENCH_BEGIN()/BENCH_END() compile to a single OUT each and the constant
+ * overhead is taken out by the calibration region (BENCH_ID_CALIBRATE).
+ * GPIOR2 is the simavr command register, used to start and stop the trace.
+ *
+ * The tiny26 has no GPIOR registers at all (nor does simavr support it), so
+ * this sketch just refuses to build for it; the harness skips it.
+ *---------------------------------------------------------------------------*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#if !defined(GPIOR0) || !defined(GPIOR1) || !defined(GPIOR2)
+  #error "The benchmark harness needs GPIOR0-2, which this part does not have."
+#endif
+
+/* The simavr description of what to trace lives in bench_mmcu.c; it is a C
+ * file because the simavr macros use designated initializers out of order,
+ * which C++ will not accept. */
+#ifndef BENCH_SIMAVR
+  #if __has_include(<simavr/avr/avr_mcu_section.h>) || __has_include(<avr_mcu_section.h>)
+    #define BENCH_SIMAVR 1
+  #else
+    #define BENCH_SIMAVR 0
+  #endif
+#endif
+
+/* The ids are what show up in the trace; run_benchmarks.py has the same table
+ * and uses it to put names to them. Append, never renumber, or the checked in
+ * baseline stops matching. */
+#define BENCH_ID_CALIBRATE      (1)
+#define BENCH_ID_DIGITALWRITE   (2)
+#define BENCH_ID_DIGITALREAD    (3)
+#define BENCH_ID_PINMODE        (4)
+#define BENCH_ID_ANALOGREAD     (5)
+#define BENCH_ID_MILLIS         (6)
+#define BENCH_ID_MICROS         (7)
+#define BENCH_ID_SERIAL_WRITE   (8)
+#define BENCH_ID_SPI_TRANSFER   (9)
+#define BENCH_ID_ISR_LATENCY    (10)
+#define BENCH_ID_ANALOGWRITE    (11)
+#define BENCH_ID_SPI_DIV2       (12) /* SPI.transfer() after beginTransaction() at F_CPU/2 */
+#define BENCH_ID_SPI_DIV4       (13)
+#define BENCH_ID_SPI_DIV8       (14)
+#define BENCH_ID_SPI_DIV16      (15)
+#define BENCH_ID_SPIFIXED_DIV2  (16) /* the same, with SPIFixed<F_CPU/2> */
+#define BENCH_ID_SPIFIXED_DIV4  (17)
+#define BENCH_ID_SPIFIXED_DIV8  (18)
+#define BENCH_ID_SPIFIXED_DIV16 (19)
+#define BENCH_ID_DIGITALWRITE4  (20) /* four digitalWrite()s to constant pins 0-3 */
+#define BENCH_ID_WRITEMULTI4    (21) /* the same four with one digitalWriteMulti() */
+#define BENCH_ID_SHIFTOUT       (22) /* shiftOut() a byte, data on pin 0, clock on pin 1 */
+#define BENCH_ID_SHIFTOUT_VAR   (23) /* the same, with the pins in variables */
+#define BENCH_ID_PWMWRITE       (24) /* PwmChannel::write() on the pin the analogWrite() region uses */
+#define BENCH_ID_INVALID        (0xFF) /* written before BENCH_END() to discard a region */
+
+/* Every region is run this many times; the harness reports min and max. */
+#ifndef BENCH_REPEAT
+  #define BENCH_REPEAT          (8)
+#endif
+
+#if BENCH_SIMAVR
+  /* Values from simavr's avr_mcu_section.h, which we can't include from C++ */
+  #define BENCH_START()   (GPIOR2 = 1) /* SIMAVR_CMD_VCD_START_TRACE */
+  #define BENCH_STOP()    (GPIOR2 = 2) /* SIMAVR_CMD_VCD_STOP_TRACE  */
+#else
+  #define BENCH_START()   ((void)0)
+  #define BENCH_STOP()    ((void)0)
+#endif
+
+#define BENCH_BEGIN(id) do { GPIOR0 = (id); __asm__ __volatile__ ("" ::: "memory"); GPIOR1 = 1; } while (0)
+#define BENCH_END()     do { GPIOR1 = 0; __asm__ __volatile__ ("" ::: "memory"); } while (0)
+
+/* simavr treats sleeping with interrupts disabled as the firmware being done. */
+#if defined(SMCR)
+  #define BENCH_SLEEP_ENABLE()  (SMCR |= (1 << SE))
+#else
+  #define BENCH_SLEEP_ENABLE()  (MCUCR |= (1 << SE))
+#endif
+#define BENCH_EXIT()    do { BENCH_STOP(); cli(); BENCH_SLEEP_ENABLE(); __asm__ __volatile__ ("sleep"); for (;;); } while (0)
+
+#endif
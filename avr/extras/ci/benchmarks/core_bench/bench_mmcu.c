@@ -0,0 +1,33 @@
+/* bench_mmcu.c - tells simavr what to trace for the benchmark sketch
+ * Part of ATTinyCore - github.com/SpenceKonde/ATTinyCore
+ * Free Software - LGPL 2.1, please see LICENCE.md for details
+ *
+ * Nothing in here ends up in flash - the .mmcu section is only read by the
+ * simulator when it loads the ELF. See bench.h.
+ *---------------------------------------------------------------------------*/
+
+#include "bench.h"
+
+#if BENCH_SIMAVR
+  #if __has_include(<simavr/avr/avr_mcu_section.h>)
+    #include <simavr/avr/avr_mcu_section.h>
+  #else
+    #include <avr_mcu_section.h>
+  #endif
+
+  /* run_benchmarks.py always passes -m to run_avr, so the name can stay empty */
+  #ifndef BENCH_MCU_NAME
+    #define BENCH_MCU_NAME ""
+  #endif
+
+  AVR_MCU(F_CPU, BENCH_MCU_NAME);
+  AVR_MCU_VCD_FILE("bench.vcd", 1000);
+  AVR_MCU_SIMAVR_COMMAND(&GPIOR2);
+
+  const struct avr_mmcu_vcd_trace_t _bench_trace[] _MMCU_ = {
+    { AVR_MCU_VCD_SYMBOL("BENCH_ID"),  .what = (void *)&GPIOR0, },
+    { AVR_MCU_VCD_SYMBOL("BENCH_RUN"), .what = (void *)&GPIOR1, },
+  };
+#else
+  #warning "simavr headers not found - the benchmark will build, but the simulator will not know what to trace."
+#endif
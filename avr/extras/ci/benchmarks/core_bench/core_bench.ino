@@ -0,0 +1,181 @@
+/* core_bench - cycle counts for the hot core calls, measured by the simulator
+ *
+ * This is not meant to be uploaded to hardware (though nothing bad happens if
+ * you do - it just sleeps forever at the end). run_benchmarks.py builds it for
+ * every variant, runs it under simavr and reads the results back out of the
+ * VCD trace. See bench.h for how the regions are marked.
+ */
+#include "bench.h"
+#if defined(SPDR) || defined(USIDR)
+  #include <SPI.h>
+#endif
+
+volatile uint32_t sink32;
+volatile int16_t  sink16;
+volatile uint8_t  sink8;
+
+static const uint8_t bench_pins[] = {0, 1, 2, 3};
+volatile uint8_t bench_data_pin = 0;
+volatile uint8_t bench_clock_pin = 1;
+
+#if defined(SPDR) || defined(USIDR)
+  // One byte at a given divider, through SPI and through SPIFixed; the transactions are outside the regions.
+  #define BENCH_SPI_DIVIDER(div, id, fixedid) do {                           \
+      SPI.beginTransaction(SPISettings(F_CPU / (div), MSBFIRST, SPI_MODE0)); \
+      BENCH_BEGIN(id);                                                       \
+      sink8 = SPI.transfer(0x55);                                            \
+      BENCH_END();                                                           \
+      SPI.endTransaction();                                                  \
+      SPIFixed<F_CPU / (div), MSBFIRST, SPI_MODE0>::beginTransaction();      \
+      BENCH_BEGIN(fixedid);                                                  \
+      sink8 = SPIFixed<F_CPU / (div), MSBFIRST, SPI_MODE0>::transfer(0x55);  \
+      BENCH_END();                                                           \
+      SPIFixed<F_CPU / (div), MSBFIRST, SPI_MODE0>::endTransaction();        \
+    } while (0)
+#endif
+
+void isr_latency_handler() {
+  BENCH_END();
+}
+
+uint8_t find_pwm_pin() {
+  for (uint8_t p = 0; p < NUM_DIGITAL_PINS; p++) {
+    if (digitalPinToTimer(p) != NOT_ON_TIMER) {
+      return p;
+    }
+  }
+  return NOT_A_PIN;
+}
+
+uint8_t find_int0_pin() {
+  for (uint8_t p = 0; p < NUM_DIGITAL_PINS; p++) {
+    if (digitalPinToInterrupt(p) == 0) {
+      return p;
+    }
+  }
+  return NOT_A_PIN;
+}
+
+void setup() {
+  uint8_t pwmpin = find_pwm_pin();
+  uint8_t intpin = find_int0_pin();
+  pinMode(LED_BUILTIN, OUTPUT);
+  #if defined(UBRR0H) || defined(UBRRH) || defined(LINBRRH)
+    Serial.begin(115200);
+  #endif
+  #if defined(SPDR) || defined(USIDR)
+    SPI.begin();
+  #endif
+  BENCH_START();
+  for (uint8_t i = 0; i < BENCH_REPEAT; i++) {
+    BENCH_BEGIN(BENCH_ID_CALIBRATE);
+    BENCH_END();
+
+    BENCH_BEGIN(BENCH_ID_DIGITALWRITE);
+    digitalWrite(LED_BUILTIN, i & 1);
+    BENCH_END();
+
+    BENCH_BEGIN(BENCH_ID_DIGITALREAD);
+    sink8 = digitalRead(LED_BUILTIN);
+    BENCH_END();
+
+    BENCH_BEGIN(BENCH_ID_PINMODE);
+    pinMode(LED_BUILTIN, OUTPUT);
+    BENCH_END();
+
+    BENCH_BEGIN(BENCH_ID_DIGITALWRITE4);
+    digitalWrite(0, i & 1);
+    digitalWrite(1, i & 2);
+    digitalWrite(2, i & 1);
+    digitalWrite(3, i & 2);
+    BENCH_END();
+
+    BENCH_BEGIN(BENCH_ID_WRITEMULTI4);
+    digitalWriteMulti(bench_pins, 4, (i & 1) ? 0x05 : 0x0A);
+    BENCH_END();
+
+    BENCH_BEGIN(BENCH_ID_SHIFTOUT);
+    shiftOut(0, 1, MSBFIRST, i);
+    BENCH_END();
+
+    {
+      uint8_t data_pin = bench_data_pin, clock_pin = bench_clock_pin;
+      BENCH_BEGIN(BENCH_ID_SHIFTOUT_VAR);
+      shiftOut(data_pin, clock_pin, MSBFIRST, i);
+      BENCH_END();
+    }
+
+    #if NUM_ANALOG_INPUTS > 0
+      BENCH_BEGIN(BENCH_ID_ANALOGREAD);
+      sink16 = analogRead(ADC_CH(0));
+      BENCH_END();
+    #endif
+
+    #if !defined(DISABLEMILLIS)
+      BENCH_BEGIN(BENCH_ID_MILLIS);
+      sink32 = millis();
+      BENCH_END();
+
+      BENCH_BEGIN(BENCH_ID_MICROS);
+      sink32 = micros();
+      BENCH_END();
+    #endif
+
+    #if defined(UBRR0H) || defined(UBRRH) || defined(LINBRRH)
+      BENCH_BEGIN(BENCH_ID_SERIAL_WRITE);
+      Serial.write('U');
+      BENCH_END();
+      Serial.flush();
+    #endif
+
+    #if defined(SPDR) || defined(USIDR)
+      BENCH_BEGIN(BENCH_ID_SPI_TRANSFER);
+      sink8 = SPI.transfer(0x55);
+      BENCH_END();
+
+      BENCH_SPI_DIVIDER(2, BENCH_ID_SPI_DIV2, BENCH_ID_SPIFIXED_DIV2);
+      BENCH_SPI_DIVIDER(4, BENCH_ID_SPI_DIV4, BENCH_ID_SPIFIXED_DIV4);
+      BENCH_SPI_DIVIDER(8, BENCH_ID_SPI_DIV8, BENCH_ID_SPIFIXED_DIV8);
+      BENCH_SPI_DIVIDER(16, BENCH_ID_SPI_DIV16, BENCH_ID_SPIFIXED_DIV16);
+      // Back to the defaults, which is what BENCH_ID_SPI_TRANSFER measures
+      SPI.beginTransaction(SPISettings());
+      SPI.endTransaction();
+    #endif
+
+    if (pwmpin != NOT_A_PIN) {
+      BENCH_BEGIN(BENCH_ID_ANALOGWRITE);
+      analogWrite(pwmpin, 64 + i);
+      BENCH_END();
+
+      PwmChannel ch = pwmAttach(pwmpin);
+      BENCH_BEGIN(BENCH_ID_PWMWRITE);
+      ch.write(64 + i);
+      BENCH_END();
+    }
+
+    if (intpin != NOT_A_PIN) {
+      // An edge on an output still fires INT0, so we can trigger it ourselves.
+      // The region starts on the write that raises the pin and ends inside the
+      // handler, so it covers the synchronizer, the vector and the attachInterrupt() dispatch.
+      volatile uint8_t *intout = portOutputRegister(digitalPinToPort(intpin));
+      uint8_t intmask = digitalPinToBitMask(intpin);
+      pinMode(intpin, OUTPUT);
+      digitalWrite(intpin, LOW);
+      attachInterrupt(0, isr_latency_handler, RISING);
+      BENCH_BEGIN(BENCH_ID_ISR_LATENCY);
+      *intout |= intmask;
+      uint16_t timeout = 0xFFFF;
+      while (GPIOR1 && --timeout);
+      if (!timeout) {
+        // Never fired (simulator without edge detection on outputs?) - mark the region invalid.
+        GPIOR0 = BENCH_ID_INVALID;
+        BENCH_END();
+      }
+      detachInterrupt(0);
+    }
+  }
+  BENCH_EXIT();
+}
+
+void loop() {
+}
@@ -0,0 +1,338 @@
+#!/usr/bin/env python3
+# run_benchmarks.py - cycle and size regression check for the core
+# Part of ATTinyCore - github.com/SpenceKonde/ATTinyCore
+# Free Software - LGPL 2.1, please see LICENCE.md for details
+#
+# Builds core_bench for one board per variant in avr/variants (as found in
+# boards.txt), runs it in simavr, and pulls the number of cycles for each
+# benchmarked call out of the VCD trace the sketch asks simavr to write. Sizes
+# come from avr-size (per section) and avr-nm (per function).
+#
+# Everything is compared against baseline.json. Any benchmark or function that
+# got slower or bigger than the baseline (plus the tolerance) fails the run.
+# Things that are not in the baseline yet are reported but never fail - run
+# with --update-baseline to record them once the change is known to be good.
+#
+# Requirements: arduino-cli with ATTinyCore installed (for the toolchain), and
+# simavr (run_avr plus its headers - libsimavr-dev on Debian/Ubuntu).
+
+import argparse
+import glob
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+AVRDIR = os.path.abspath(os.path.join(HERE, "..", "..", ".."))
+SKETCH = os.path.join(HERE, "core_bench")
+PLATFORM = "ATTinyCore:avr"
+
+# Must match the BENCH_ID_* table in core_bench/bench.h.
+BENCH_NAMES = {
+  1: "calibrate",
+  2: "digitalWrite",
+  3: "digitalRead",
+  4: "pinMode",
+  5: "analogRead",
+  6: "millis",
+  7: "micros",
+  8: "Serial.write",
+  9: "SPI.transfer",
+  10: "isr_latency",
+  11: "analogWrite",
+  12: "SPI.transfer/2",
+  13: "SPI.transfer/4",
+  14: "SPI.transfer/8",
+  15: "SPI.transfer/16",
+  16: "SPIFixed.transfer/2",
+  17: "SPIFixed.transfer/4",
+  18: "SPIFixed.transfer/8",
+  19: "SPIFixed.transfer/16",
+  20: "digitalWrite x4",
+  21: "digitalWriteMulti x4",
+  22: "shiftOut",
+  23: "shiftOut (var pins)",
+  24: "PwmChannel.write",
+}
+
+# Per-function sizes are only compared for symbols that match this - with LTO,
+# whatever is not on the list tends to come and go with inlining decisions.
+TRACKED_SYMBOLS = re.compile(r"^(_?digitalWrite|_digitalWriteMulti|_?digitalRead|_?pinMode|_openDrain|shiftOutBuf|shiftInBuf|analogRead|_analogRead|_?analogWrite|_pwmAttach|"
+                             r"turnOffPWM|millis|micros|delay|init|"
+                             r"HardwareSerial::.*|SPIClass::.*|__vector_\d+)$")
+
+TOOLS_MENU = {
+  "clock": "internal_8m",
+}
+
+
+def parse_boards_txt():
+  """Returns {variant: (board, fqbn options, mcu)} choosing the first board in boards.txt
+  that uses the variant and, where there is a chip menu, the biggest chip."""
+  props = {}
+  with open(os.path.join(AVRDIR, "boards.txt")) as f:
+    for line in f:
+      line = line.strip()
+      if not line or line.startswith("#") or "=" not in line:
+        continue
+      key, value = line.split("=", 1)
+      props[key] = value
+  boards = []
+  for key in props:
+    board = key.split(".")[0]
+    if board not in boards and board != "menu":
+      boards.append(board)
+  variants = {}
+  for board in boards:
+    # Stick to the plain boards; the bootloader ones use the same variants.
+    if board.endswith("opti") or board.endswith("micr"):
+      continue
+    chips = [k.split(".")[3] for k in props if k.startswith(board + ".menu.chip.") and k.endswith(".build.mcu")]
+    chips.sort(key=lambda c: int(props.get(board + ".menu.chip." + c + ".upload.maximum_size", "0")), reverse=True)
+    chip = chips[0] if chips else None
+    mcu = props.get(board + ".menu.chip." + chip + ".build.mcu") if chip else props.get(board + ".build.mcu")
+    if mcu is None:
+      continue
+    options = dict(TOOLS_MENU)
+    if chip:
+      options["chip"] = chip
+    candidates = [(None, props.get(board + ".build.variant"))]
+    for k in props:
+      m = re.match(re.escape(board) + r"\.menu\.pinmap\.([^.]+)\.build\.variant$", k)
+      if m:
+        candidates.append((m.group(1), props[k]))
+    for pinmap, variant in candidates:
+      if variant is None:
+        continue
+      # boards.txt and the directory names do not agree on case.
+      variant = variant.lower()
+      if variant in variants:
+        continue
+      opts = dict(options)
+      if pinmap:
+        opts["pinmap"] = pinmap
+      variants[variant] = (board, opts, mcu)
+  on_disk = sorted(d.lower() for d in os.listdir(os.path.join(AVRDIR, "variants")))
+  return {v: variants[v] for v in on_disk if v in variants}
+
+
+def fqbn_for(board, options):
+  return PLATFORM + ":" + board + ":" + ",".join(k + "=" + v for k, v in sorted(options.items()))
+
+
+def find_tool(name, hint):
+  if hint:
+    path = os.path.join(hint, name)
+    if os.path.exists(path):
+      return path
+  path = shutil.which(name)
+  if path:
+    return path
+  found = sorted(glob.glob(os.path.expanduser("~/.arduino15/packages/*/tools/avr-gcc/*/bin/" + name)))
+  if found:
+    return found[-1]
+  sys.exit("Could not find " + name + ", use --avr-bin")
+
+
+def compile_sketch(args, fqbn, outdir):
+  cmd = [args.arduino_cli, "compile", "--fqbn", fqbn, "--output-dir", outdir, SKETCH]
+  if args.simavr_include:
+    cmd[2:2] = ["--build-property", "build.extra_flags=-I" + args.simavr_include]
+  result = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+  if result.returncode != 0:
+    print(result.stdout)
+    return None
+  elfs = glob.glob(os.path.join(outdir, "*.elf"))
+  return elfs[0] if elfs else None
+
+
+def section_sizes(avr_size, elf):
+  out = subprocess.run([avr_size, "-A", elf], stdout=subprocess.PIPE, universal_newlines=True, check=True).stdout
+  sizes = {}
+  for line in out.splitlines():
+    parts = line.split()
+    if len(parts) >= 2 and parts[0] in (".text", ".data", ".bss"):
+      sizes[parts[0]] = int(parts[1])
+  return sizes
+
+
+def symbol_sizes(avr_nm, elf):
+  out = subprocess.run([avr_nm, "-S", "-C", "--size-sort", elf], stdout=subprocess.PIPE, universal_newlines=True, check=True).stdout
+  sizes = {}
+  for line in out.splitlines():
+    m = re.match(r"^[0-9a-fA-F]+ ([0-9a-fA-F]+) ([tTdDbB]) (.+)$", line)
+    if not m:
+      continue
+    name = re.sub(r"\(.*\)$", "", m.group(3)).strip()
+    section = {"t": ".text", "d": ".data", "b": ".bss"}[m.group(2).lower()]
+    sizes[section + ":" + name] = sizes.get(section + ":" + name, 0) + int(m.group(1), 16)
+  return sizes
+
+
+def run_simulator(args, elf, mcu, f_cpu, workdir):
+  """Runs the ELF and returns the path of the VCD, or None. A timeout is not an error on its
+  own: whatever made it into the trace is still used, and the comparison notices anything missing."""
+  vcd = os.path.join(workdir, "bench.vcd")
+  if os.path.exists(vcd):
+    os.remove(vcd)
+  try:
+    subprocess.run([args.run_avr, "-m", mcu, "-f", str(f_cpu), elf], cwd=workdir,
+                   stdout=subprocess.PIPE, stderr=subprocess.STDOUT, timeout=args.timeout)
+  except subprocess.TimeoutExpired:
+    print("  simulator timed out after %d s" % args.timeout)
+  return vcd if os.path.exists(vcd) else None
+
+
+def parse_vcd(path, f_cpu):
+  """Returns {benchmark name: [cycles, ...]} for every complete region in the trace."""
+  ids = {}
+  scale = 1e-9
+  with open(path) as f:
+    text = f.read()
+  m = re.search(r"\$timescale\s+(\d+)\s*(s|ms|us|ns|ps|fs)\s+\$end", text)
+  if m:
+    scale = int(m.group(1)) * {"s": 1, "ms": 1e-3, "us": 1e-6, "ns": 1e-9, "ps": 1e-12, "fs": 1e-15}[m.group(2)]
+  for m in re.finditer(r"\$var\s+\S+\s+\d+\s+(\S+)\s+(\S+)\s+\$end", text):
+    ids[m.group(1)] = m.group(2)
+  now = 0
+  bench_id = 0
+  running = False
+  start = 0
+  start_id = 0
+  regions = {}
+  for token in text[text.find("$enddefinitions"):].split("\n")[1:]:
+    token = token.strip()
+    if not token:
+      continue
+    if token[0] == "#":
+      now = int(token[1:])
+      continue
+    if token[0] in "bB":
+      value, ident = token[1:].split()
+      value = int(value.replace("x", "0").replace("z", "0"), 2)
+    elif token[0] in "01xz":
+      value, ident = (1 if token[0] == "1" else 0), token[1:]
+    else:
+      continue
+    name = ids.get(ident)
+    if name == "BENCH_ID":
+      bench_id = value
+    elif name == "BENCH_RUN":
+      if value and not running:
+        running, start, start_id = True, now, bench_id
+      elif not value and running:
+        running = False
+        if bench_id == start_id and bench_id in BENCH_NAMES:
+          cycles = int(round((now - start) * scale * f_cpu))
+          regions.setdefault(BENCH_NAMES[bench_id], []).append(cycles)
+  # Take out the cost of the markers themselves.
+  overhead = min(regions.pop("calibrate", [0]))
+  return {k: [c - overhead for c in v] for k, v in regions.items()}
+
+
+def compare(name, current, baseline, tolerance, failures):
+  if baseline is None:
+    return "new"
+  if current > baseline + tolerance:
+    failures.append("%s: %d -> %d" % (name, baseline, current))
+    return "WORSE"
+  if current < baseline:
+    return "better"
+  return ""
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__)
+  parser.add_argument("--arduino-cli", default="arduino-cli")
+  parser.add_argument("--run-avr", default="run_avr", help="simavr's run_avr")
+  parser.add_argument("--simavr-include", default=None, help="directory containing simavr/avr/avr_mcu_section.h, if not on the default path")
+  parser.add_argument("--avr-bin", default=None, help="directory with avr-size and avr-nm")
+  parser.add_argument("--baseline", default=os.path.join(HERE, "baseline.json"))
+  parser.add_argument("--report", default=None, help="write the full results here as JSON")
+  parser.add_argument("--update-baseline", action="store_true")
+  parser.add_argument("--cycle-tolerance", type=int, default=0, help="cycles a benchmark may get slower before failing")
+  parser.add_argument("--size-tolerance", type=int, default=0, help="bytes a section or function may grow before failing")
+  parser.add_argument("--timeout", type=int, default=60, help="seconds before the simulator is killed")
+  parser.add_argument("--build-dir", default=os.path.join(HERE, "build"))
+  parser.add_argument("variants", nargs="*", help="only these variants (default: all)")
+  args = parser.parse_args()
+
+  avr_size = find_tool("avr-size", args.avr_bin)
+  avr_nm = find_tool("avr-nm", args.avr_bin)
+  supported = subprocess.run([args.run_avr, "--list-cores"], stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                             universal_newlines=True).stdout
+
+  baseline = {"variants": {}}
+  if os.path.exists(args.baseline):
+    with open(args.baseline) as f:
+      baseline = json.load(f)
+  results = {}
+  failures = []
+
+  for variant, (board, options, mcu) in sorted(parse_boards_txt().items()):
+    if args.variants and variant not in args.variants:
+      continue
+    fqbn = fqbn_for(board, options)
+    print("== %s (%s)" % (variant, fqbn))
+    if mcu == "attiny26":
+      print("  skipped: no GPIOR registers, and not supported by simavr")
+      continue
+    outdir = os.path.join(args.build_dir, variant)
+    os.makedirs(outdir, exist_ok=True)
+    elf = compile_sketch(args, fqbn, outdir)
+    if elf is None:
+      failures.append(variant + ": build failed")
+      continue
+    entry = {"fqbn": fqbn, "sections": section_sizes(avr_size, elf), "symbols": symbol_sizes(avr_nm, elf), "cycles": {}}
+    if re.search(r"\b" + mcu + r"\b", supported):
+      f_cpu = 8000000
+      vcd = run_simulator(args, elf, mcu, f_cpu, outdir)
+      if vcd:
+        for name, samples in parse_vcd(vcd, f_cpu).items():
+          entry["cycles"][name] = {"min": min(samples), "max": max(samples)}
+      else:
+        print("  no trace produced")
+    else:
+      print("  %s not supported by this simavr - sizes only" % mcu)
+    results[variant] = entry
+
+    old = baseline["variants"].get(variant, {})
+    for name, value in sorted(entry["cycles"].items()):
+      was = old.get("cycles", {}).get(name)
+      status = compare(variant + " " + name + " cycles", value["max"], was["max"] if was else None, args.cycle_tolerance, failures)
+      print("  %-16s %6d .. %-6d cycles %s" % (name, value["min"], value["max"], status))
+    for name in old.get("cycles", {}):
+      if name not in entry["cycles"]:
+        failures.append("%s %s: in baseline but not measured" % (variant, name))
+    for section, size in sorted(entry["sections"].items()):
+      status = compare(variant + " " + section, size, old.get("sections", {}).get(section), args.size_tolerance, failures)
+      print("  %-16s %6d bytes %s" % (section, size, status))
+    for symbol, size in sorted(entry["symbols"].items()):
+      if not TRACKED_SYMBOLS.match(symbol.split(":", 1)[1]):
+        continue
+      status = compare(variant + " " + symbol, size, old.get("symbols", {}).get(symbol), args.size_tolerance, failures)
+      print("  %-40s %6d bytes %s" % (symbol, size, status))
+
+  if args.report:
+    with open(args.report, "w") as f:
+      json.dump({"variants": results}, f, indent=1, sort_keys=True)
+  if args.update_baseline:
+    baseline["variants"].update(results)
+    with open(args.baseline, "w") as f:
+      json.dump(baseline, f, indent=1, sort_keys=True)
+      f.write("\n")
+    print("Baseline updated.")
+    return 0
+  if failures:
+    print("\nRegressions against " + os.path.relpath(args.baseline) + ":")
+    for failure in failures:
+      print("  " + failure)
+    return 1
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+# run_host_tests.py - build and run the host-side tests of core arithmetic
+# Part of ATTinyCore - github.com/SpenceKonde/ATTinyCore
+# Free Software - LGPL 2.1, please see LICENCE.md for details
+#
+# The timekeeping arithmetic is all compile-time constants derived from F_CPU
+# and the millis timer prescaler, so test_micros.c is rebuilt with the host
+# compiler for every clock speed that create_boards_txt.py can put in
+# boards.txt, and with every prescaler wiring.c might pick at that speed.
+# test_ringbuffer.cpp doesn't depend on the clock, so it is built just once,
+# as is test_usi_twi_async.c, against stand-ins for the AVR headers that
+# USI_TWI_Master.c includes - the test defines the registers itself.
+# test_softi2c.py compiles SoftI2CMaster.h itself, for each clock and a range
+# of bus speeds.
+
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+sys.dont_write_bytecode = True
+import test_softi2c  # noqa: E402
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+AVRDIR = os.path.abspath(os.path.join(HERE, "..", "..", ".."))
+CORE = os.path.join(AVRDIR, "cores", "tiny")
+WIRE = os.path.join(AVRDIR, "libraries", "Wire", "src")
+GENERATOR = os.path.join(AVRDIR, "extras", "development", "create_boards_txt.py")
+CC = os.environ.get("CC", "cc")
+CXX = os.environ.get("CXX", "c++")
+
+USI_TWI_STUBS = {
+  "avr/io.h": "",
+  "Arduino.h": "#include <stdint.h>\n#include <stdbool.h>\n",
+  "util/delay_basic.h": "#include <stdint.h>\nstatic inline void _delay_loop_1(uint8_t n) { (void) n; }\n",
+}
+
+
+def board_clocks():
+  with open(GENERATOR) as f:
+    text = f.read()
+  clocks = set(int(x) for x in re.findall(r"f_cpu[\"']?\s*[:=]\s*[\"']?(\d+)", text))
+  return sorted(clocks)
+
+
+def millis_prescalers(f_cpu):
+  # Must agree with the timer0Prescaler selection at the top of wiring.c
+  if f_cpu < 3000000:
+    normal = [8]
+  elif f_cpu < 8000000:
+    normal = [64, 32]  # x7 runs timer0 at /32 below 8 MHz
+  else:
+    normal = [64]
+  # and with the MILLIS_TICKLESS one below it
+  if f_cpu >= 4000000:
+    tickless = 1024
+  elif f_cpu >= 1000000:
+    tickless = 256
+  elif f_cpu >= 250000:
+    tickless = 64
+  else:
+    tickless = 8
+  return normal + ([tickless] if tickless not in normal else [])
+
+
+def main():
+  failures = 0
+  with tempfile.TemporaryDirectory() as tmp:
+    exe = os.path.join(tmp, "test_micros")
+    for f_cpu in board_clocks():
+      for prescale in millis_prescalers(f_cpu):
+        build = [CC, "-O2", "-Wall", "-Werror", "-I", CORE, "-DF_CPU=%dUL" % f_cpu,
+                 "-DMillisTimer_Prescale_Value=%d" % prescale, os.path.join(HERE, "test_micros.c"), "-o", exe]
+        if subprocess.run(build).returncode != 0:
+          print("F_CPU=%d prescale=%d: build failed" % (f_cpu, prescale))
+          failures += 1
+          continue
+        if subprocess.run([exe]).returncode != 0:
+          failures += 1
+    exe = os.path.join(tmp, "test_ringbuffer")
+    build = [CXX, "-O2", "-Wall", "-Werror", "-std=gnu++17", "-I", CORE, os.path.join(HERE, "test_ringbuffer.cpp"), "-o", exe]
+    if subprocess.run(build).returncode != 0:
+      print("test_ringbuffer: build failed")
+      failures += 1
+    elif subprocess.run([exe]).returncode != 0:
+      failures += 1
+    stubs = os.path.join(tmp, "stubs")
+    for header, text in USI_TWI_STUBS.items():
+      os.makedirs(os.path.dirname(os.path.join(stubs, header)), exist_ok=True)
+      with open(os.path.join(stubs, header), "w") as f:
+        f.write(text)
+    exe = os.path.join(tmp, "test_usi_twi_async")
+    build = [CC, "-O2", "-Wall", "-Werror", "-I", stubs, "-I", WIRE, os.path.join(HERE, "test_usi_twi_async.c"), "-o", exe]
+    if subprocess.run(build).returncode != 0:
+      print("test_usi_twi_async: build failed")
+      failures += 1
+    elif subprocess.run([exe]).returncode != 0:
+      failures += 1
+  failures += test_softi2c.main(board_clocks())
+  print("%d failed" % failures if failures else "all passed")
+  return 1 if failures else 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,130 @@
+/* test_micros.c - host-side check of the millis()/micros() arithmetic
+ * Part of ATTinyCore - github.com/SpenceKonde/ATTinyCore
+ * Free Software - LGPL 2.1, please see LICENCE.md for details
+ *
+ * Built once per clock speed by run_host_tests.py, with F_CPU and
+ * MillisTimer_Prescale_Value on the command line, against the very same
+ * wiring_millis.h that wiring.c uses. For every overflow over a full period of
+ * the exactness correction, and every timer value within it, we check that
+ *  - micros() never goes backwards, including when the overflow flag is set
+ *    but the ISR hasn't run yet,
+ *  - it never gets ahead of, and stays within 16 us behind, the same base
+ *    plus the timer scaled by the true (fractional) microseconds per tick -
+ *    only the scaling differs, and
+ *  - it doesn't drift from real time by more than the 30 ppm that the millis
+ *    correction promises. The correction spreads its extra fracts over 256
+ *    overflows, so in between it is allowed to wander; we only hold it to real
+ *    time once every 256 overflows, when the correction has caught up.
+ * It also checks the two functions only the tickless mode uses: that
+ * millis_from_parts() is always exactly micros_from_parts() / 1000, and that
+ * micros_deadline_tick() finds the first tick at which a deadline is reached.
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include "wiring_millis.h"
+
+#define OVERFLOWS        (256UL * 128UL) /* > 256 (correct_exact) * 125 (fract), and < 2^32 us at 65.536 ms each */
+#define MAX_BEHIND       (16.0)          /* us */
+#define MAX_JITTER       (16.0)          /* us, on top of the drift */
+#define MAX_DRIFT_PPM    (30.0)
+
+static uint32_t millis_timer_millis;
+static uint8_t  millis_timer_fract;
+
+/* The body of the millis timer overflow ISR in wiring.c */
+static void overflow(void) {
+  uint32_t m = millis_timer_millis;
+  uint8_t f = millis_timer_fract;
+#ifdef CORRECT_EXACT_MILLIS
+  static uint8_t correct_exact = 0;     // rollover intended
+  if (++correct_exact < CORRECT_EXACT_MANY) {
+    ++f;
+  }
+#endif
+  f += FRACT_INC;
+  if (f >= FRACT_MAX) {
+    f -= FRACT_MAX;
+    m += MILLIS_INC + 1;
+  } else {
+    m += MILLIS_INC;
+  }
+  millis_timer_fract = f;
+  millis_timer_millis = m;
+}
+
+/* The same base, with the timer scaled exactly */
+static double exact_micros(uint32_t m, uint8_t f, uint8_t t, uint8_t q) {
+  double us = m * 1000.0 + f * 8.0 + t * (MillisTimer_Prescale_Value * 1e6 / (double)F_CPU);
+  return q ? us + MillisTimer_Prescale_Value * 256e6 / (double)F_CPU : us;
+}
+
+/* Returns nonzero if now is ahead of exact, or too far behind it */
+static int check_exact(uint32_t now, double exact, double *worst) {
+  if (exact - now > *worst) {
+    *worst = exact - now;
+  }
+  return now > exact + 0.5 || exact - now > MAX_BEHIND;
+}
+
+int main(void) {
+  const double us_per_tick = MillisTimer_Prescale_Value * 1e6 / (double)F_CPU;
+  uint32_t last = 0;
+  double worst_exact = 0;
+  double worst_real = 0;
+  unsigned long failures = 0;
+
+  for (uint32_t us = 1; us <= micros_ticks_to_us(255); us++) {
+    uint8_t t = micros_deadline_tick((uint16_t)us);
+    if (t == 0 || micros_ticks_to_us(t) < us || micros_ticks_to_us(t - 1) >= us) {
+      if (failures++ < 10) printf("  deadline %lu us past the overflow: got tick %u\n", (unsigned long)us, t);
+    }
+  }
+
+  for (uint32_t n = 0; n < OVERFLOWS; n++) {
+    for (uint16_t t = 0; t < 256; t++) {
+      uint32_t now = micros_from_parts(millis_timer_millis, millis_timer_fract, t, 0);
+      double real = (n * 256.0 + t) * us_per_tick;
+      double allowed = MAX_JITTER + real * MAX_DRIFT_PPM / 1e6;
+      if ((n || t) && now < last) {
+        if (failures++ < 10) printf("  backwards at overflow %lu, tick %u: %lu -> %lu\n", (unsigned long)n, t, (unsigned long)last, (unsigned long)now);
+      }
+      if (check_exact(now, exact_micros(millis_timer_millis, millis_timer_fract, t, 0), &worst_exact)) {
+        if (failures++ < 10) printf("  overflow %lu, tick %u: %lu too far from exact scaling\n", (unsigned long)n, t, (unsigned long)now);
+      }
+      if ((n & 0xFF) == 0 && ((now - real > worst_real) || (real - now > worst_real))) {
+        worst_real = now > real ? now - real : real - now;
+      }
+      if ((n & 0xFF) == 0 && (now - real > allowed || real - now > allowed)) {
+        if (failures++ < 10) printf("  off by %.1f us at overflow %lu, tick %u\n", now - real, (unsigned long)n, t);
+      }
+      if (millis_from_parts(millis_timer_millis, millis_timer_fract, t, 0) != now / 1000) {
+        if (failures++ < 10) printf("  overflow %lu, tick %u: millis is not micros / 1000\n", (unsigned long)n, t);
+      }
+      last = now;
+    }
+    /* The timer has wrapped but the ISR hasn't run: micros() sees the flag and a small timer
+     * value. That has to land between the last value before the wrap and the first one after. */
+    uint32_t before = last;
+    uint32_t m = millis_timer_millis;
+    uint8_t f = millis_timer_fract;
+    overflow();
+    for (uint8_t t = 0; t < 255; t++) {
+      uint32_t pending = micros_from_parts(m, f, t, 1);
+      uint32_t after = micros_from_parts(millis_timer_millis, millis_timer_fract, t, 0);
+      if (pending < before || pending > after) {
+        if (failures++ < 10) printf("  pending overflow %lu, tick %u: %lu not in [%lu, %lu]\n", (unsigned long)n, t,
+                                    (unsigned long)pending, (unsigned long)before, (unsigned long)after);
+      }
+      if (millis_from_parts(m, f, t, 1) != pending / 1000) {
+        if (failures++ < 10) printf("  pending overflow %lu, tick %u: millis is not micros / 1000\n", (unsigned long)n, t);
+      }
+      if (check_exact(pending, exact_micros(m, f, t, 1), &worst_exact)) {
+        if (failures++ < 10) printf("  pending overflow %lu, tick %u: %lu too far from exact scaling\n", (unsigned long)n, t, (unsigned long)pending);
+      }
+    }
+  }
+  printf("F_CPU=%lu prescale=%u step=%lu us: worst behind exact scaling %.1f us, worst vs real time %.1f us over %.0f s, %lu failures\n",
+         (unsigned long)F_CPU, MillisTimer_Prescale_Value, (unsigned long)MICROS_PER_OVERFLOW_STEP, worst_exact,
+         worst_real, OVERFLOWS * 256.0 * us_per_tick / 1e6, failures);
+  return failures ? 1 : 0;
+}
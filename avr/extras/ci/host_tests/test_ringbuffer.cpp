@@ -0,0 +1,86 @@
+/* test_ringbuffer.cpp - host-side check of the RingBuffer template
+ * Part of ATTinyCore - github.com/SpenceKonde/ATTinyCore
+ * Free Software - LGPL 2.1, please see LICENCE.md for details
+ *
+ * Built by run_host_tests.py against the very same cores/tiny/RingBuffer.h
+ * that the serial ports and the USI slave use. For the smallest, a typical and
+ * the largest size, it pushes and pops byte-at-a-time and in blocks of every
+ * length, mixed together, against a model FIFO, and checks that
+ *  - bytes come out in the order they went in, none lost or made up,
+ *  - it holds exactly SIZE - 1 bytes, and push()/push_n() refuse the rest,
+ *  - available() and space() always add up to SIZE - 1, and peek() agrees
+ *    with what pop() returns next.
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include "RingBuffer.h"
+
+static unsigned long failures;
+
+#define CHECK(cond, ...) do { if (!(cond)) { if (failures++ < 10) { printf("  SIZE=%u: ", SIZE); printf(__VA_ARGS__); printf("\n"); } } } while (0)
+
+template <uint16_t SIZE>
+static void test() {
+  static RingBuffer<SIZE> ring; // zeroed, like a global on the chip
+  uint8_t model[SIZE];          // what should be in it, oldest first
+  uint8_t count = 0;
+  uint8_t next_in = 0;
+  uint32_t state = 12345;
+  uint8_t block[300];
+
+  for (uint32_t step = 0; step < 200000; step++) {
+    state = state * 1103515245 + 12345;
+    uint8_t op = (state >> 16) & 3;
+    uint16_t n = (state >> 18) % (SIZE + 8);
+    if (op == 0) {
+      bool ok = ring.push(next_in);
+      CHECK(ok == (count < SIZE - 1), "push() returned %d with %u in it", ok, count);
+      if (ok) {
+        model[count++] = next_in++;
+      }
+    } else if (op == 1) {
+      for (uint16_t i = 0; i < n; i++) {
+        block[i] = next_in + i;
+      }
+      uint8_t room = SIZE - 1 - count;
+      uint8_t pushed = ring.push_n(block, n);
+      CHECK(pushed == (n < room ? n : room), "push_n(%u) took %u with room for %u", n, pushed, room);
+      for (uint8_t i = 0; i < pushed; i++) {
+        model[count++] = next_in++;
+      }
+    } else if (op == 2) {
+      int16_t p = ring.peek();
+      uint8_t c = 0;
+      bool ok = ring.pop(c);
+      CHECK(ok == (count > 0), "pop() returned %d with %u in it", ok, count);
+      CHECK(p == (count ? model[0] : -1), "peek() gave %d", p);
+      if (ok) {
+        CHECK(c == model[0], "popped %u, expected %u", c, model[0]);
+        memmove(model, model + 1, --count);
+      }
+    } else {
+      memset(block, 0xAA, sizeof(block));
+      uint8_t popped = ring.pop_n(block, n);
+      CHECK(popped == (n < count ? n : count), "pop_n(%u) gave %u with %u in it", n, popped, count);
+      CHECK(memcmp(block, model, popped) == 0, "pop_n(%u) bytes out of order", n);
+      CHECK(block[popped] == 0xAA, "pop_n(%u) wrote past the %u it returned", n, popped);
+      count -= popped;
+      memmove(model, model + popped, count);
+    }
+    CHECK(ring.available() == count, "available() is %u, should be %u", ring.available(), count);
+    CHECK(ring.available() + ring.space() == SIZE - 1, "available() %u + space() %u", ring.available(), ring.space());
+    CHECK(ring.empty() == (count == 0), "empty() is %d with %u in it", ring.empty(), count);
+  }
+  ring.clear();
+  CHECK(ring.empty() && ring.space() == SIZE - 1, "not empty after clear()");
+  printf("RingBuffer<%u>: done\n", SIZE);
+}
+
+int main(void) {
+  test<2>();
+  test<16>();
+  test<256>();
+  printf("%lu failures\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,459 @@
+#!/usr/bin/env python3
+# test_softi2c.py - cycle-count the SCL waveform SoftI2CMaster.h generates
+# Part of ATTinyCore - github.com/SpenceKonde/ATTinyCore
+# Free Software - LGPL 2.1, please see LICENCE.md for details
+#
+# The bit timing of the software I2C master is all hand-counted assembly with
+# delays worked out from F_CPU and I2C_FREQ by the preprocessor. To check it
+# without an AVR, the header is compiled with the host compiler to assembly
+# only (-S), with the AVR register clobber lists taken out of the preprocessed
+# source first: that's enough for the compiler to fill every operand of the inline
+# asm in with the value it would have on the chip. The AVR code between #APP
+# and #NO_APP is then run here on a small cycle-counting model of the handful
+# of instructions it uses, against a slave that ACKs and sends a fixed byte, and
+# every edge on SCL and SDA is timed.
+
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+AVRDIR = os.path.abspath(os.path.join(HERE, "..", "..", ".."))
+WIRE = os.path.join(AVRDIR, "libraries", "Wire", "src")
+CXX = os.environ.get("CXX", "c++")
+
+# Port B holds SCL on bit 2, port A SDA on bit 0, at their tiny84 I/O addresses.
+PORTB, SCL_PIN = 0x18, 2
+PORTA, SDA_PIN = 0x1B, 0
+SCL_DDR, SCL_IN = PORTB - 1, PORTB - 2
+SDA_DDR, SDA_IN = PORTA - 1, PORTA - 2
+
+# Minimum times from the I2C spec (UM10204 table 10), in ns, for each mode.
+SPEC = {
+  "Sm":  dict(low=4700, high=4000, hd_sta=4000, su_sta=4700, su_sto=4000, buf=4700),
+  "Fm":  dict(low=1300, high=600,  hd_sta=600,  su_sta=600,  su_sto=600,  buf=1300),
+  "Fm+": dict(low=500,  high=260,  hd_sta=260,  su_sta=260,  su_sto=260,  buf=500),
+}
+
+STUB_IO = "#define _SFR_IO_ADDR(x) (x)\n"
+STUB_ARDUINO = "#include <stdint.h>\n#include <stdbool.h>\n"
+SOURCE = """
+#define SDA_PORT %d
+#define SDA_PIN %d
+#define SCL_PORT %d
+#define SCL_PIN %d
+#include <SoftI2CMaster.h>
+extern const unsigned long i2c_timing[];
+const unsigned long i2c_timing[] = { I2C_T_LOW, I2C_T_HIGH, I2C_ACTUAL_FREQ, I2C_PERIOD_CYCLES, I2C_MIN_LOW + I2C_MIN_HIGH };
+""" % (PORTA, SDA_PIN, PORTB, SCL_PIN)
+
+
+class Fail(Exception):
+  pass
+
+
+def gas_eval(expr):
+  expr = expr.replace("$", "").replace("/", "//")
+  return int(eval(expr, {"lo8": lambda x: x & 0xFF, "hi8": lambda x: (x >> 8) & 0xFF}))
+
+
+def expand(lines):
+  # .if/.elseif/.else/.endif and .rept/.endr, as gas would
+  out = []
+  stack = []  # (taking, taken_already)
+  i = 0
+  while i < len(lines):
+    line = lines[i]
+    word = line.split(None, 1)
+    op = word[0] if word else ""
+    arg = word[1] if len(word) > 1 else ""
+    live = all(s[0] for s in stack)
+    if op == ".if":
+      ok = live and gas_eval(arg) != 0
+      stack.append([ok, ok])
+    elif op == ".elseif":
+      top = stack[-1]
+      outer = all(s[0] for s in stack[:-1])
+      top[0] = outer and not top[1] and gas_eval(arg) != 0
+      top[1] = top[1] or top[0]
+    elif op == ".else":
+      top = stack[-1]
+      top[0] = not top[1]
+      top[1] = True
+    elif op == ".endif":
+      stack.pop()
+    elif op == ".rept":
+      depth, j = 1, i + 1
+      while depth:
+        w = lines[j].split(None, 1)
+        depth += {".rept": 1, ".endr": -1}.get(w[0] if w else "", 0)
+        j += 1
+      if live:
+        out += expand(lines[i + 1:j - 1]) * gas_eval(arg)
+      i = j
+      continue
+    elif live:
+      out.append(line)
+    i += 1
+  return out
+
+
+def parse(asm_text):
+  # The AVR code, as a flat list of (mnemonic, operands), labels included; every
+  # function the compiler emitted is followed by the ret of its C epilogue.
+  prog = []
+  labels = {}
+  func = None
+  block = None
+  for raw in asm_text.splitlines():
+    s = raw.split(";", 1)[0].strip()
+    if s == "#APP":
+      block = []
+      if func:
+        labels[func] = len(prog)
+        func = None
+    elif s == "#NO_APP":
+      prog += expand_labels(expand(block))
+      prog.append(("ret", []))
+      block = None
+    elif block is None:
+      m = re.match(r"^([A-Za-z_][\w]*):", s)
+      if m:
+        func = m.group(1)
+    elif s and not s.startswith("#"):
+      block.append(s)
+  return prog, labels
+
+
+def expand_labels(pieces):
+  for p in pieces:
+    while True:
+      m = re.match(r"^([\w.]+):\s*(.*)$", p)
+      if not m:
+        break
+      yield ("label", [m.group(1)])
+      p = m.group(2)
+    if p:
+      w = p.split(None, 1)
+      yield (w[0].lower(), [a.strip() for a in w[1].split(",")] if len(w) > 1 else [])
+
+
+def link(prog, labels):
+  # Drop the label pseudo-instructions, resolving named and numeric labels.
+  code, named, numeric = [], dict(), []
+  entry = {}
+  start = {v: k for k, v in labels.items()}
+  for idx, (op, args) in enumerate(prog):
+    if idx in start:
+      entry[start[idx]] = len(code)
+    if op == "label":
+      if args[0].isdigit():
+        numeric.append((args[0], len(code)))
+      else:
+        named[args[0]] = len(code)
+      continue
+    code.append([op, args, len(code)])
+  named.update(entry)
+
+  def resolve(ref, at):
+    m = re.match(r"^(\d+)([bf])$", ref)
+    if m:
+      if m.group(2) == "b":
+        return max(a for n, a in numeric if n == m.group(1) and a <= at)
+      return min(a for n, a in numeric if n == m.group(1) and a > at)
+    return named[ref]
+  for ins in code:
+    op, args, at = ins
+    if op in ("rjmp", "rcall") or op.startswith("br"):
+      args[-1] = resolve(args[-1], at)
+  return code, entry
+
+
+class Avr:
+  def __init__(self, code, entry, extra):
+    self.code, self.entry = code, entry
+    self.reg = [0] * 32
+    self.mem = {"i2c_delay_extra": extra}
+    self.C = self.Z = self.N = False
+    self.cycle = 0
+    self.ddr = {SCL_DDR: 0, SDA_DDR: 0}
+    self.edges = []  # (cycle, "SCL"/"SDA", level)
+    self.rises = 0
+    self.sampled = []  # SDA at each SCL rise, as a slave would see it
+    self.slave = lambda bit: True  # what the slave leaves SDA at during bit n
+
+  def scl(self):
+    return not (self.ddr[SCL_DDR] >> SCL_PIN) & 1
+
+  def sda(self):
+    bit = self.rises if not self.scl() else self.rises - 1
+    return not (self.ddr[SDA_DDR] >> SDA_PIN) & 1 and self.slave(bit)
+
+  def pin(self, addr, bit):
+    if addr == SCL_IN and bit == SCL_PIN:
+      return self.scl()
+    if addr == SDA_IN and bit == SDA_PIN:
+      return self.sda()
+    raise Fail("read of unknown pin %d,%d" % (addr, bit))
+
+  def reg_no(self, name):
+    return int(name[1:])
+
+  def flags(self, v):
+    self.Z = v == 0
+    self.N = bool(v & 0x80)
+
+  def call(self, func, r24=0):
+    self.reg[24] = r24
+    stack = [None]
+    pc = self.entry[func]
+    steps = 0
+    while True:
+      steps += 1
+      if steps > 10000000:
+        raise Fail("runaway in " + func)
+      op, a, _ = self.code[pc]
+      pc += 1
+      if op == "nop":
+        self.cycle += 1
+      elif op == "ldi":
+        self.reg[self.reg_no(a[0])] = gas_eval(a[1]) & 0xFF
+        self.cycle += 1
+      elif op == "mov":
+        self.reg[self.reg_no(a[0])] = self.reg[self.reg_no(a[1])]
+        self.cycle += 1
+      elif op == "clr":
+        self.reg[self.reg_no(a[0])] = 0
+        self.Z, self.N = True, False
+        self.cycle += 1
+      elif op == "dec":
+        r = self.reg_no(a[0])
+        self.reg[r] = (self.reg[r] - 1) & 0xFF
+        self.flags(self.reg[r])
+        self.cycle += 1
+      elif op == "subi" or op == "cpi":
+        r, k = self.reg_no(a[0]), gas_eval(a[1])
+        v = (self.reg[r] - k) & 0xFF
+        self.C = self.reg[r] < k
+        self.flags(v)
+        if op == "subi":
+          self.reg[r] = v
+        self.cycle += 1
+      elif op == "tst":
+        self.flags(self.reg[self.reg_no(a[0])])
+        self.cycle += 1
+      elif op in ("lsl", "rol"):
+        r = self.reg_no(a[0])
+        v = (self.reg[r] << 1) | (1 if op == "rol" and self.C else 0)
+        self.C = bool(v & 0x100)
+        self.reg[r] = v & 0xFF
+        self.flags(self.reg[r])
+        self.cycle += 1
+      elif op in ("sec", "clc", "sen", "cln"):
+        setattr(self, op[2].upper(), op[0:2] == "se")
+        self.cycle += 1
+      elif op in ("cli", "sei"):
+        self.cycle += 1
+      elif op == "sbiw":
+        r = self.reg_no(a[0])
+        v = self.reg[r] | (self.reg[r + 1] << 8)
+        self.C = v < gas_eval(a[1])
+        v = (v - gas_eval(a[1])) & 0xFFFF
+        self.reg[r], self.reg[r + 1] = v & 0xFF, v >> 8
+        self.Z, self.N = v == 0, bool(v & 0x8000)
+        self.cycle += 2
+      elif op == "lds":
+        self.reg[self.reg_no(a[0])] = self.mem[a[1].replace("$", "")]
+        self.cycle += 2
+      elif op in ("sbi", "cbi"):
+        addr, bit = gas_eval(a[0]), gas_eval(a[1])
+        if addr not in self.ddr:
+          raise Fail("write to unknown I/O register %d" % addr)
+        before = (self.scl(), self.sda())
+        if op == "sbi":
+          self.ddr[addr] |= 1 << bit
+        else:
+          self.ddr[addr] &= ~(1 << bit)
+        self.cycle += 2
+        if self.scl() != before[0]:
+          self.edges.append((self.cycle, "SCL", self.scl()))
+          if self.scl():
+            self.rises += 1
+            self.sampled.append(self.sda())
+        if self.sda() != before[1]:
+          self.edges.append((self.cycle, "SDA", self.sda()))
+      elif op in ("sbis", "sbic"):
+        level = self.pin(gas_eval(a[0]), gas_eval(a[1]))
+        if level == (op == "sbis"):
+          pc += 1
+          self.cycle += 2
+        else:
+          self.cycle += 1
+      elif op == "rjmp":
+        pc = a[0]
+        self.cycle += 2
+      elif op == "rcall":
+        stack.append(pc)
+        pc = a[0]
+        self.cycle += 3
+      elif op == "ret":
+        self.cycle += 4
+        pc = stack.pop()
+        if pc is None:
+          return self.reg[24]
+      elif op.startswith("br"):
+        cond = {"breq": self.Z, "brne": not self.Z, "brcc": not self.C, "brcs": self.C,
+                "brmi": self.N, "brpl": not self.N}[op]
+        if cond:
+          pc = a[0]
+          self.cycle += 2
+        else:
+          self.cycle += 1
+      else:
+        raise Fail("unmodelled instruction " + op)
+
+
+def scl_bits(edges, since):
+  # (low, high) of each complete SCL clock after cycle `since`
+  scl = [(t, lvl) for t, line, lvl in edges if line == "SCL" and t > since]
+  out = []
+  for i in range(len(scl) - 2):
+    if not scl[i][1]:
+      out.append((scl[i + 1][0] - scl[i][0], scl[i + 2][0] - scl[i + 1][0]))
+  return out
+
+
+def check(f_cpu, freq, runtime, extra, tmp):
+  src = os.path.join(tmp, "softi2c.cpp")
+  pre = os.path.join(tmp, "softi2c.ii")
+  out = os.path.join(tmp, "softi2c.s")
+  with open(src, "w") as f:
+    f.write(SOURCE)
+  cmd = [CXX, "-E", "-std=gnu++17", "-I", tmp, "-I", WIRE, "-DF_CPU=%dUL" % f_cpu, "-DI2C_FREQ=%dUL" % freq,
+         "-DI2C_RUNTIME_CLOCK=%d" % runtime, src]
+  r = subprocess.run(cmd, capture_output=True, text=True)
+  if r.returncode:
+    raise Fail("preprocessing failed:\n" + r.stderr)
+  with open(pre, "w") as f:
+    f.write(re.sub(r':\s*"r\d+"(\s*,\s*"r\d+")*\s*\)', ")", r.stdout))
+  cmd = [CXX, "-S", "-O2", "-fno-pie", "-fcf-protection=none", "-fno-asynchronous-unwind-tables",
+         pre, "-o", out]
+  r = subprocess.run(cmd, capture_output=True, text=True)
+  if r.returncode:
+    raise Fail("compile failed:\n" + r.stderr)
+  with open(out) as f:
+    text = f.read()
+  vals = [int(v) for v in re.findall(r"\.quad\s+(\d+)", text.split("i2c_timing:", 1)[1])[:5]]
+  t_low, t_high, actual, period, fastest = vals
+  scale = 3 * extra if runtime else 0
+  want_low, want_high = t_low + scale, t_high + scale
+  mode = "Sm" if freq <= 100000 else "Fm" if freq <= 400000 else "Fm+"
+  spec = SPEC[mode]
+
+  def cycles(ns):
+    return -(-ns * f_cpu // 1000000000)
+
+  if actual != f_cpu // (t_low + t_high) or actual > freq:
+    raise Fail("I2C_ACTUAL_FREQ %d for %d requested" % (actual, freq))
+  if t_low + t_high != max(period, fastest):
+    raise Fail("period %d cycles, wanted %d" % (t_low + t_high, max(period, fastest)))
+  if t_low < cycles(spec["low"]) or t_high < cycles(spec["high"]):
+    raise Fail("T_LOW %d/T_HIGH %d under the %s minimum" % (t_low, t_high, mode))
+
+  prog, labels = parse(text)
+  code, entry = link(prog, labels)
+  start = next(k for k in entry if "i2c_start" in k and "wait" not in k)
+  rep = next(k for k in entry if "i2c_rep_start" in k)
+  read = next(k for k in entry if "i2c_read" in k)
+  avr = Avr(code, entry, extra)
+
+  # start + address byte, ACKed
+  avr.slave = lambda bit: bit != 8
+  avr.rises = 0
+  if avr.call(start, 0xA4) != 1:
+    raise Fail("address not ACKed")
+  sda_fall = next(t for t, line, lvl in avr.edges if line == "SDA" and not lvl)
+  scl_fall = next(t for t, line, lvl in avr.edges if line == "SCL" and not lvl)
+  if scl_fall - sda_fall < cycles(spec["hd_sta"]):
+    raise Fail("start hold time %d cycles" % (scl_fall - sda_fall))
+  bits = scl_bits(avr.edges, 0)
+  if len(bits) != 9 or any(b != (want_low, want_high) for b in bits):
+    raise Fail("address: SCL low/high %s, wanted %d/%d" % (bits, want_low, want_high))
+
+  # some data bytes
+  for value in (0x5A, 0xFF, 0x00):
+    avr.rises = 0
+    mark = avr.cycle
+    if avr.call("ass_i2c_write", value) != 1:
+      raise Fail("write of 0x%02X not ACKed" % value)
+    bits = scl_bits(avr.edges, mark)
+    # SCL has been low since the end of the last byte, so the first low half
+    # is however long the caller took to get here
+    if len(bits) != 8 or any(b != (want_low, want_high) for b in bits):
+      raise Fail("write 0x%02X: SCL low/high %s, wanted %d/%d" % (value, bits, want_low, want_high))
+    seen = avr.sampled[-9:-1]
+    if seen != [bool(value & (0x80 >> i)) for i in range(8)]:
+      raise Fail("wrote 0x%02X, slave saw %s" % (value, seen))
+
+  # repeated start for a read, then two bytes, the last NAKed
+  avr.rises = -1  # the first rise is the one before the start condition
+  mark = avr.cycle
+  avr.slave = lambda bit: bit != 8
+  if avr.call(rep, 0xA5) != 1:
+    raise Fail("repeated start not ACKed")
+  rise = next(t for t, line, lvl in avr.edges if t > mark and line == "SCL" and lvl)
+  fall = next(t for t, line, lvl in avr.edges if t > rise and line == "SDA" and not lvl)
+  if fall - rise < cycles(spec["su_sta"]):
+    raise Fail("repeated start setup time %d cycles" % (fall - rise))
+  for value, last in ((0xC3, False), (0x3C, True)):
+    avr.rises = 0
+    avr.slave = lambda bit, v=value: bit >= 8 or bool(v & (0x80 >> bit))
+    mark = avr.cycle
+    got = avr.call(read, 1 if last else 0)
+    if got != value:
+      raise Fail("read 0x%02X, sent 0x%02X" % (got, value))
+    bits = scl_bits(avr.edges, mark)
+    if len(bits) != 8 or any(b != (want_low, want_high) for b in bits):
+      raise Fail("read: SCL low/high %s, wanted %d/%d" % (bits, want_low, want_high))
+    if avr.sampled[-1] != last:
+      raise Fail("read: sent %s, wanted %s" % ("NAK" if avr.sampled[-1] else "ACK", "NAK" if last else "ACK"))
+
+  # stop
+  mark = avr.cycle
+  avr.call("ass_i2c_stop")
+  rise = next(t for t, line, lvl in avr.edges if t > mark and line == "SCL" and lvl)
+  sda_rise = next(t for t, line, lvl in avr.edges if t > rise and line == "SDA" and lvl)
+  if sda_rise - rise < cycles(spec["su_sto"]):
+    raise Fail("stop setup time %d cycles" % (sda_rise - rise))
+  if avr.cycle - sda_rise < cycles(spec["buf"]):
+    raise Fail("bus free time %d cycles" % (avr.cycle - sda_rise))
+  return actual
+
+
+def main(clocks):
+  failures = 0
+  with tempfile.TemporaryDirectory() as tmp:
+    os.makedirs(os.path.join(tmp, "avr"))
+    with open(os.path.join(tmp, "avr", "io.h"), "w") as f:
+      f.write(STUB_IO)
+    with open(os.path.join(tmp, "Arduino.h"), "w") as f:
+      f.write(STUB_ARDUINO)
+    for f_cpu in clocks:
+      cases = [(freq, 0, 0) for freq in (25000, 100000, 250000, 400000, 1000000)]
+      cases += [(400000, 1, 0), (400000, 1, 37)]
+      for freq, runtime, extra in cases:
+        try:
+          check(f_cpu, freq, runtime, extra, tmp)
+        except Fail as e:
+          print("softi2c F_CPU=%d I2C_FREQ=%d runtime=%d extra=%d: %s" % (f_cpu, freq, runtime, extra, e))
+          failures += 1
+  return failures
+
+
+if __name__ == "__main__":
+  from run_host_tests import board_clocks
+  n = main(board_clocks())
+  print("%d failed" % n if n else "all passed")
+  sys.exit(1 if n else 0)
@@ -0,0 +1,171 @@
+/* test_usi_twi_async.c - host-side check of the non-blocking USI I2C master
+ * Part of ATTinyCore - github.com/SpenceKonde/ATTinyCore
+ * Free Software - LGPL 2.1, please see LICENCE.md for details
+ *
+ * Built by run_host_tests.py against the very same USI_TWI_Master.c that Wire
+ * uses, with the USI and Timer1 registers replaced by variables and a small
+ * model of the USI in two-wire mode: a USITC strobe toggles SCL and counts,
+ * the counter overflowing sets USIOIF, writing a 1 to a flag clears it, and
+ * SDA changing while SCL is high sets USISIF or USIPF. The slave ACKs (unless
+ * told not to) and sends 0xA5 for every byte read. The two ISRs are called as
+ * the chip would: the overflow one whenever its flag and enable are both set,
+ * the timer one otherwise. For a write, a read and a NACKed address, each
+ * ending in a STOP, we check that
+ *  - done() is called exactly once, with the right error state,
+ *  - the bytes read are the ones the slave sent, and
+ *  - the overflow interrupt doesn't keep firing with nothing to shift, which
+ *    would starve the timer interrupt that sends the STOP.
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdint.h>
+
+static volatile uint8_t usidr, usisr, usicr;
+static volatile uint8_t portb, pinb, ddrb;
+static volatile uint8_t tccr1a, tccr1b, timsk1, tifr1;
+static volatile uint16_t ocr1b, tcnt1;
+
+#define F_CPU             8000000UL
+#define USIDR             usidr
+#define USISR             usisr
+#define USICR             usicr
+#define USISIF            7
+#define USIOIF            6
+#define USIPF             5
+#define USIDC             4
+#define USICNT0           0
+#define USISIE            7
+#define USIOIE            6
+#define USIWM1            5
+#define USIWM0            4
+#define USICS1            3
+#define USICS0            2
+#define USICLK            1
+#define USITC             0
+#define USI_PORT          portb
+#define USI_DDR           ddrb
+#define USI_PIN           pinb
+#define USI_DI_BIT        0
+#define USI_CLOCK_PORT    portb
+#define USI_CLOCK_DDR     ddrb
+#define USI_CLOCK_PIN     pinb
+#define USI_CLOCK_BIT     2
+#define TCCR1A            tccr1a
+#define TCCR1B            tccr1b
+#define CS10              0
+#define TCNT1             tcnt1
+#define OCR1B             ocr1b
+#define TIMSK1            timsk1
+#define TIFR1             tifr1
+#define OCIE1B            2
+#define OCF1B             2
+#define TIMER1_COMPB_vect timer1_compb_isr
+#define ISR(vector, ...)  void vector(void)
+
+#include "USI_TWI_Master/USI_TWI_Master.c"
+
+#define SCL               (1 << USI_CLOCK_BIT)
+#define SDA               (1 << USI_DI_BIT)
+#define MAX_STEPS         10000
+#define MAX_OVERFLOWS     4   /* in a row, without the timer getting a turn */
+
+static unsigned long failures;
+static uint8_t counter;       // the USI's 4-bit counter
+static uint8_t ack_shift;     // the counter was loaded for a single bit
+static uint8_t nack;          // the slave doesn't answer
+static uint8_t done_calls;
+static uint8_t done_state;
+
+#define CHECK(cond, ...) do { if (!(cond)) { if (failures++ < 10) { printf("  %s: ", name); printf(__VA_ARGS__); printf("\n"); } } } while (0)
+
+static void done(unsigned char state) {
+  done_calls++;
+  done_state = state;
+}
+
+static uint8_t sda(void) {
+  return (portb & SDA) ? 1 : 0;
+}
+
+/* What the USI does with what the code just wrote */
+static void usi_update(uint8_t old_port) {
+  if (usisr & (1 << USIDC)) {             // only ever set by a write from the code: clear flags, load the counter
+    uint8_t flags = (usisr & 0xE0) ^ 0xE0;
+    counter = usisr & 0x0F;
+    ack_shift = (counter == 0x0E);
+    usisr = flags;
+  }
+  if (usicr & (1 << USITC)) {
+    usicr &= ~(1 << USITC);
+    portb ^= SCL;
+    if (++counter == 16) {
+      counter = 0;
+      usisr |= (1 << USIOIF);
+      if (!(ddrb & SDA)) {                // the slave is driving SDA
+        usidr = ack_shift ? (nack ? 0xFF : 0x00) : 0xA5;
+      }
+    }
+  }
+  if ((old_port & SCL) && (portb & SCL)) {
+    if ((old_port & SDA) && !sda()) {
+      usisr |= (1 << USISIF);
+    } else if (!(old_port & SDA) && sda()) {
+      usisr |= (1 << USIPF);
+    }
+  }
+  usisr = (usisr & 0xE0) | counter;
+  pinb = portb;                           // no clock stretching
+}
+
+static void run(const char *name, uint8_t *msg, uint8_t size, uint8_t slave_nacks, uint8_t expect) {
+  uint8_t overflows = 0;
+  nack = slave_nacks;
+  done_calls = 0;
+  done_state = 0xEE;
+  portb = SCL | SDA;
+  pinb = portb;
+  ddrb = SCL | SDA;
+  usisr = 0;
+  usicr = 0;
+  counter = 0;
+  USI_TWI_Master_Initialise();
+  usi_update(portb);
+  USI_TWI_Start_Async(msg, size, 1, done);
+  usi_update(portb);
+  for (uint16_t step = 0; step < MAX_STEPS && USI_TWI_Async_Phase; step++) {
+    uint8_t old_port = portb;
+    if ((usicr & (1 << USIOIE)) && (usisr & (1 << USIOIF))) {
+      if (++overflows > MAX_OVERFLOWS) {
+        break;
+      }
+      USI_TWI_Master_Async_Overflow();
+    } else {
+      overflows = 0;
+      timer1_compb_isr();
+    }
+    usi_update(old_port);
+  }
+  CHECK(overflows <= MAX_OVERFLOWS, "the overflow interrupt kept firing in phase %u", USI_TWI_Async_Phase);
+  CHECK(!USI_TWI_Async_Phase, "still running in phase %u", USI_TWI_Async_Phase);
+  CHECK(done_calls == 1, "done() called %u times", done_calls);
+  CHECK(done_state == expect, "done() got %u, expected %u", done_state, expect);
+  CHECK(USI_TWI_Async_State() == expect, "USI_TWI_Async_State() is %u, expected %u", USI_TWI_Async_State(), expect);
+  CHECK(!(usicr & (1 << USIOIE)), "the overflow interrupt was left on");
+  CHECK((portb & (SCL | SDA)) == (SCL | SDA), "the bus wasn't released");
+}
+
+int main(void) {
+  const char *name = "read";
+  uint8_t write[] = {0x50 << 1, 0x12, 0x34};
+  uint8_t read[] = {(0x50 << 1) | 1, 0, 0};
+  uint8_t nacked[] = {0x51 << 1, 0x12};
+  run("write", write, sizeof(write), 0, 0);
+  run("read", read, sizeof(read), 0, 0);
+  CHECK(read[1] == 0xA5 && read[2] == 0xA5, "read %02x %02x, expected a5 a5", read[1], read[2]);
+  run("address NACK", nacked, sizeof(nacked), 1, USI_TWI_NO_ACK_ON_ADDRESS);
+  if (failures) {
+    printf("usi_twi_async: %lu failures\n", failures);
+    return 1;
+  }
+  return 0;
+}
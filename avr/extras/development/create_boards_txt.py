@@ -295,8 +295,19 @@ softsermenu_861= ["enable_AIN1=RX on PA7, TX on PA (default PA6)",
   "enable_AIN1.bootloader.uart=_rx7tx6", "enable_AIN0.bootloader.uart=_rx6tx7", "enable_AIN2.bootloader.uart=_rx5tx6", "txonly.bootloader.uart=_rx7tx6"]
 millismenu = [
   ".menu.millis.enabled=Enabled",".menu.millis.enabled.build.millis=",".menu.millis.enabled.build.millisabr=",
+  ".menu.millis.tickless=Enabled, tickless (delay() sleeps, no PWM on timer0)",".menu.millis.tickless.build.millis=-DMILLIS_TICKLESS",".menu.millis.tickless.build.millisabr=mTL",
   ".menu.millis.disabled=Disabled (saves flash)",".menu.millis.disabled.build.millis=-DDISABLEMILLIS",".menu.millis.disabled.build.millisabr=mNONE"]
 
+serialbufmenu = [
+  "default=Default (RX and TX the same, 16b, or 64b with 1k RAM)","default.build.serialbuf=","default.build.serialbufabr=",
+  "rxheavy=Bigger RX (RX twice the default, TX a quarter)","rxheavy.build.serialbuf=-DSERIAL_BUFFERS_RX_HEAVY","rxheavy.build.serialbufabr=sbRX",
+  "txunbuf=Bigger RX, unbuffered TX (write() waits for each byte)","txunbuf.build.serialbuf=-DSERIAL_BUFFERS_RX_HEAVY -DSERIAL_TX_BUFFER_SIZE=0","txunbuf.build.serialbufabr=sbTX0"]
+
+wirebufmenu = [
+  "default=Default","default.build.wirebuf=","default.build.wirebufabr=",
+  "small=16b (saves RAM)","small.build.wirebuf=-DWIRE_BUFFER_SIZE=16","small.build.wirebufabr=wb16",
+  "none=None (only readInto()/writeFrom() as master, no slave)","none.build.wirebuf=-DWIRE_BUFFER_SIZE=0","none.build.wirebufabr=wb0"]
+
 # all of the menus should have been done like this, instead of repeating the menu name a million times.
 # this is the last menu I added...
 wiremodesmenu = [
@@ -1594,6 +1605,8 @@ for x in boards:
   printProp(x,".build.tuneorcal=")
   printProp(x,".build.softserabr=")
   printProp(x,".build.softser=")
+  printProp(x,".build.serialbufabr=")
+  printProp(x,".build.serialbuf=")
   if not "wiremodes" in boards[x]:
     printProp(x,".build.wiremodeabr=")
     printProp(x,".build.wiremode=")
@@ -1779,6 +1792,9 @@ for x in boards:
     printSubMenuHeader("Wire Modes menu    ")
     for y in wiremodesmenu:
       printProp(x,".menu.wiremode."+y)
+  printSubMenuHeader("Wire Buffers menu  ")
+  for y in wirebufmenu:
+    printProp(x,".menu.wirebuf."+y)
   if "remap" in boards[x]:
       for y in boards[x]["remap"]:
         printProp(x,y)
@@ -1795,6 +1811,10 @@ for x in boards:
       printProp(x,".menu.softserial.enable=RX on P"+boards[x]["ssport"]+boards[x]["ssrx"]+", TX on P"+boards[x]["ssport"]+" (default P"+boards[x]["ssport"]+boards[x]["sstx"]+")")
       for y in softsermenu:
         printProp(x,y)
+  elif "861" not in x: # 861 Micronucleus has no software serial either, but no UART
+    printSubMenuHeader("Serial Buffers menu  ")
+    for y in serialbufmenu:
+      printProp(x,".menu.serialbuf."+y)
   printSubMenuHeader("BrownOut Detect menu ")
   if "bodmenu" in boards[x]:
     for y in boards[x]["bodmenu"]:
@@ -1,9 +1,33 @@
-#if defined(__AVR_ATtinyX5__)
+/* ATTinyCore.h - helper functions for features only a few parts have
+ * Part of ATTinyCore - github.com/SpenceKonde/ATTinyCore
+ *   Free Software - LGPL 2.1, please see LICENCE.md for details
+ *
+ * Everything here is inline, so only what's used takes any flash, and this can be included
+ * from more than one file - except with TIMER1_DITHER defined, which brings in the Timer1
+ * overflow interrupt, and must only be done in one.
+ *
+ * See README.md for the details.
+ *---------------------------------------------------------------------------*/
+
+#ifndef ATTinyCore_h
+#define ATTinyCore_h
+
+#include <Arduino.h>
+
+#if defined(__AVR_ATtinyX5__) || defined(__AVR_ATtinyX61__)
+  /* High speed PWM from Timer1, clocked from the 64 MHz PLL.
+   *
+   * Timer1 on these parts counts from 0 to TOP in OCR1C - 8 bits on the x5, and on the x61, 10
+   * if TC1H is used for the high bits. In fast PWM, the outputs are set at 0 and cleared when the
+   * count passes their compare value; on the x61, it can also count up and back down again (phase
+   * and frequency correct PWM), half the frequency for a given TOP, but symmetrical. Each channel
+   * has an inverted output next to it too (OC1x-bar), and a dead time generator, so the two can
+   * drive both sides of a half bridge. */
   typedef enum TIMERONE_CLOCK_enum
   {
-      TIMER1_FCPU    = (0x00),
-      TIMER1_64M_PLL = (0x06),
-      TIMER1_32M_PLL = (0x86)
+    TIMER1_FCPU    = (0x00),
+    TIMER1_64M_PLL = (0x06),
+    TIMER1_32M_PLL = (0x86)
   } TIMERONE_CLOCK_t;
   typedef enum TIMERONE_PRESC_enum
   {
@@ -24,279 +48,357 @@
     TIMER1_DIV8192  = (0x0E),
     TIMER1_DIV16384 = (0x0F)
   } TIMER1_PRESCALE_t;
+  typedef enum TIMER1_DT_PRESC_enum
+  {
+    TIMER1_DT_DIV1  = (0x00),
+    TIMER1_DT_DIV2  = (0x01),
+    TIMER1_DT_DIV4  = (0x02),
+    TIMER1_DT_DIV8  = (0x03)
+  } TIMER1_DT_PRESCALE_t;
+
+  #if defined(__AVR_ATtinyX5__)
+    #define TIMER1_CLOCK_REG    TCCR1
+    #define TIMER1_CHANNELS     2
+  #else
+    #define TIMER1_CLOCK_REG    TCCR1B
+    #define TIMER1_CHANNELS     3
+    typedef enum TIMER1_PWM_MODE_enum
+    {
+      TIMER1_PWM_FAST          = (0x00),
+      TIMER1_PWM_PHASE_CORRECT = (0x01)
+    } TIMER1_PWM_MODE_t;
+  #endif
+  #if F_CPU == 16500000 // tuned for VUSB - the PLL is 8 times the internal oscillator
+    #define TIMER1_PLL_SPEED    66000000UL
+  #else
+    #define TIMER1_PLL_SPEED    64000000UL
+  #endif
 
-  void setTimer1Clock(TIMERONE_CLOCK_t clk) {
-    uint8_t t = PLLCSR & 0x87;
-    if (t & 0x86 == clk) {    // already set right
+  inline void setTimer1Clock(TIMERONE_CLOCK_t clk) {
+    uint8_t pll = PLLCSR & ((1 << LSM) | (1 << PCKE) | (1 << PLLE));
+    if (pll == clk) {    // already set right
       return;
     }
-    uint8_t oldtccr = TCCR1;
-    TCCR1 = oldtccr & 0xF0;
-    if ((clk & 0x04) && (t & 0x03 != 3)) {
-      // PLL requested and not currently running
-      if (t & 0x02 == 0) {
-        PLLCSR = clk & 0x02; // enable the PLL
+    uint8_t oldtccr = TIMER1_CLOCK_REG;
+    TIMER1_CLOCK_REG = oldtccr & 0xF0; // stop the timer while the clock changes
+    if (clk & (1 << PCKE)) {
+      // The PLL has to be running and locked before the timer is switched over to it. Where it's the
+      // system clock, it always is, and LSM can't be set. PLOCK isn't meaningful until ~100us after
+      // PLLE is set (datasheet), so wait that out before polling it when we're the ones starting it.
+      uint8_t pllwasrunning = pll & (1 << PLLE);
+      PLLCSR = clk & ~(1 << PCKE);
+      if (!pllwasrunning) {
+        _delay_us(100);
       }
-      while (PLLCSR & 0x01 == 0); // Wait for lock
+      while (!(PLLCSR & (1 << PLOCK)));
     }
-    PLLCSR = clk; // now we can set the PLLCSR.
-    TCCR1 = oldtccr; // and turn back on the timer.
+    PLLCSR = clk;
+    TIMER1_CLOCK_REG = oldtccr;
   }
-  void setTimer1Prescaler(TIMER1_PRESCALE_t presc) {
-    uint8_t oldtccr = TCCR1;
-    tccr &= 0xF0;
-    tccr |= presc;
-    TCCR1 = tccr;
+
+  inline void setTimer1Prescaler(TIMER1_PRESCALE_t presc) {
+    TIMER1_CLOCK_REG = (TIMER1_CLOCK_REG & 0xF0) | presc;
   }
-  void setTimer1Top(uint8_t newtop) {
-    OCR1C = newtop;
+
+  inline void setTimer1Top(uint8_t newtop) {
+    #if defined(TC1H)
+      uint8_t oldsreg = SREG;
+      cli();
+      TC1H  = 0;
+      OCR1C = newtop;
+      SREG  = oldsreg;
+    #else
+      OCR1C = newtop;
+    #endif
   }
-  uint8_t setTimer1Frequency(uint32_t target) {
-    while (true) {
-      uint8_t pll = PLLCSR;
-      pll &= 0x84;
-      unsigned long speed;
-      if (pll == 0x84) {
-        #if F_CPU  == 16500000
-          speed     = 33000000;
-        #else
-          speed     = 32000000;
-        #endif
-      } else if (pll) {
-        #if F_CPU  == 16500000
-          speed     = 66000000;
-        #else
-          speed     = 64000000;
-        #endif
-      } else {
-        speed     = F_CPU;
-      }
-      uint32_t topval = speed/target;
-      if (topval < 64 && pll != 0x04) {
-        setTimer1Clock(TIMER1_64M_PLL);
-      } else if (topval < 128 && pll == 0) {
-        setTimer1Clock(TIMER1_32M_PLL);
-      } else {
-        uint8_t newpresc = 1;
-        while (topval > 255 && newpresc < 15) {
-          newpresc++;
-          topval    >>= 1;
-        }
-        uint8_t top;
-        if (topval > 255) {
-          top = 255;
-        } else {
-          top = topval;
-        }
-        OCR1C         = top;
-        uint8_t tccr  = TCCR1;
-        tccr         &= 0xF0;
-        tccr         |= newpresc;
-        TCCR1         = tccr;
-        return top;
-      }
+
+  #if defined(TC1H)
+    inline void setTimer1Top_10bit(uint16_t newtop) {
+      uint8_t oldsreg = SREG;
+      cli();
+      TC1H  = newtop >> 8;
+      OCR1C = (uint8_t) newtop;
+      TC1H  = 0; // the core's 8-bit writes to Timer1 count on this
+      SREG  = oldsreg;
+    }
+
+    inline void setTimer1Mode(TIMER1_PWM_MODE_t mode) {
+      TCCR1D = (TCCR1D & ~((1 << WGM11) | (1 << WGM10))) | mode;
+    }
+  #endif
+
+  /* Where the timer is clocked from before its prescaler */
+  inline uint32_t _timer1ClockSpeed() {
+    uint8_t pll = PLLCSR;
+    if (!(pll & (1 << PCKE))) {
+      return F_CPU;
     }
+    return (pll & (1 << LSM)) ? TIMER1_PLL_SPEED / 2 : TIMER1_PLL_SPEED;
   }
-#endif
 
-#if defined(__AVR_ATtinyX61__)
-    typedef enum TIMERONE_CLOCK_enum
-  {
-      TIMER1_FCPU    = (0x00),
-      TIMER1_64M_PLL = (0x06),
-      TIMER1_32M_PLL = (0x86)
-  } TIMERONE_CLOCK_t;
-  typedef enum TIMERONE_PRESC_enum
-  {
-    TIMER1_STOPPED  = (0x00),
-    TIMER1_DIV1     = (0x01),
-    TIMER1_DIV2     = (0x02),
-    TIMER1_DIV4     = (0x03),
-    TIMER1_DIV8     = (0x04),
-    TIMER1_DIV16    = (0x05),
-    TIMER1_DIV32    = (0x06),
-    TIMER1_DIV64    = (0x07),
-    TIMER1_DIV128   = (0x08),
-    TIMER1_DIV256   = (0x09),
-    TIMER1_DIV512   = (0x0A),
-    TIMER1_DIV1024  = (0x0B),
-    TIMER1_DIV2048  = (0x0C),
-    TIMER1_DIV4096  = (0x0D),
-    TIMER1_DIV8192  = (0x0E),
-    TIMER1_DIV16384 = (0x0F)
-  } TIMER1_PRESCALE_t;
+  /* The largest TOP no more than maxtop that gives the target frequency, with the smallest prescaler
+   * that allows that. Switches to the 64 MHz PLL first, unless the PLL is already in use (at either speed). */
+  inline uint16_t _setTimer1Frequency(uint32_t target, uint16_t maxtop) {
+    if (!target) {
+      return 0;
+    }
+    if (!(PLLCSR & (1 << PCKE))) {
+      setTimer1Clock(TIMER1_64M_PLL);
+    }
+    uint32_t speed = _timer1ClockSpeed();
+    bool dual = false;   // counting both ways takes twice as long
+    #if defined(TC1H)
+      dual = TCCR1D & (1 << WGM10);
+    #endif
+    if (dual) {
+      target <<= 1;
+    }
+    uint32_t ticks = speed / target;
+    uint8_t presc = 1;
+    while (ticks > (uint32_t)maxtop + 1 && presc < 15) {
+      presc++;
+      ticks >>= 1;
+    }
+    ticks = ((speed >> (presc - 1)) + (target >> 1)) / target;   // again, rounded, without the bits shifted out
+    // fast PWM takes TOP + 1 counts a cycle, phase correct takes 2 * TOP
+    uint16_t top;
+    if (dual) {
+      top = (ticks > maxtop ? maxtop : (ticks < 1 ? 1 : ticks));
+    } else {
+      top = (ticks > (uint32_t)maxtop + 1 ? maxtop : (ticks < 2 ? 1 : ticks - 1));
+    }
+    #if defined(TC1H)
+      setTimer1Top_10bit(top);
+    #else
+      OCR1C = top;
+    #endif
+    setTimer1Prescaler((TIMER1_PRESCALE_t)presc);
+    return top;
+  }
 
-  void setTimer1Clock(TIMERONE_CLOCK_t clk) {
-    uint8_t t = PLLCSR & 0x87;
-    if (t & 0x86 == clk) {    // already set right
-      return;
+  inline uint8_t setTimer1Frequency(uint32_t target) {
+    return _setTimer1Frequency(target, 255);
+  }
+
+  #if defined(TC1H)
+    inline uint16_t setTimer1Frequency_10bit(uint32_t target) {
+      return _setTimer1Frequency(target, 1023);
     }
-    uint8_t oldtccr = TCCR1B;
-    TCCR1B = oldtccr & 0xF0;
-    if ((clk & 0x04) && (t & 0x03 != 3)) {
-      // PLL requested and not currently running
-      if (t & 0x02 == 0) {
-        PLLCSR = clk & 0x02; // enable the PLL
+  #endif
+
+  /* The pins of channel 0 (OC1A), 1 (OC1B) and, on the x61, 2 (OC1D), and of their inverted outputs */
+  inline uint8_t _timer1Pin(uint8_t channel, bool inverted) {
+    #if defined(__AVR_ATtinyX5__)
+      if (channel == 0) {
+        return inverted ? PIN_PB0 : PIN_PB1;
       }
-      while (PLLCSR & 0x01 == 0); // Wait for lock
-    }
-    PLLCSR = clk; // now we can set the PLLCSR.
-    TCCR1B = oldtccr; // and turn back on the timer.
+      return inverted ? PIN_PB3 : PIN_PB4;
+    #else
+      if (channel == 0) {
+        return inverted ? PIN_PB0 : PIN_PB1;
+      } else if (channel == 1) {
+        return inverted ? PIN_PB2 : PIN_PB3;
+      }
+      return inverted ? PIN_PB4 : PIN_PB5;
+    #endif
   }
-  void setTimer1Prescaler(TIMER1_PRESCALE_t presc) {
-    uint8_t oldtccr = TCCR1B;
-    tccr &= 0xF0;
-    tccr |= presc;
-    TCCR1B = tccr;
+
+  /* COM1x1:0 for a channel - 0 is disconnected, 1 both outputs, 2 just OC1x */
+  inline uint8_t _timer1GetCom(uint8_t channel) {
+    #if defined(__AVR_ATtinyX5__)
+      return ((channel == 0 ? TCCR1 : GTCCR) >> COM1A0) & 3; // COM1B0 is the same bit in GTCCR
+    #else
+      if (channel == 2) {
+        return (TCCR1C >> COM1D0) & 3;
+      }
+      return (TCCR1A >> (channel == 0 ? COM1A0 : COM1B0)) & 3;
+    #endif
   }
-  void setTimer1Top(uint8_t newtop) {
+
+  inline void _timer1SetCom(uint8_t channel, uint8_t com) {
     uint8_t oldsreg = SREG;
     cli();
-    TC1H  = 0;
-    OCR1C = newtop;
-    SREG  = oldsreg;
+    #if defined(__AVR_ATtinyX5__)
+      if (channel == 0) {
+        TCCR1 = (TCCR1 & ~(3 << COM1A0)) | (com << COM1A0) | (1 << PWM1A);
+      } else {
+        GTCCR = (GTCCR & ~(3 << COM1B0)) | (com << COM1B0) | (1 << PWM1B);
+      }
+    #else
+      if (channel == 0) {
+        TCCR1A = (TCCR1A & ~(3 << COM1A0)) | (com << COM1A0) | (1 << PWM1A);
+      } else if (channel == 1) {
+        TCCR1A = (TCCR1A & ~(3 << COM1B0)) | (com << COM1B0) | (1 << PWM1B);
+      } else {
+        TCCR1C = (TCCR1C & ~(3 << COM1D0)) | (com << COM1D0) | (1 << PWM1D);
+      }
+    #endif
+    SREG = oldsreg;
   }
 
-  void setTimer1Top_10bit(uint16_t newtop) {
-    TC1H = (newtop >> 8);
-    OCR1C = newtop & 0xFF;
+  /* Which channels have their inverted output on as well - kept here rather than just in the COM
+   * bits, because those are cleared while the duty cycle is 0. */
+  inline uint8_t &_timer1Complementary() {
+    static uint8_t channels = 0;
+    return channels;
   }
-  uint8_t setTimer1Frequency(uint32_t target) {
-    while (true) {
-      unsigned long speed;
-      uint8_t pll   = PLLCSR;
-      pll          &= 0x84;
-      if (pll == 0x84) {
-        #if F_CPU  == 16500000
-          speed     = 33000000;
-        #else
-          speed     = 32000000;
-        #endif
-      } else if (pll) {
-        #if F_CPU  == 16500000
-          speed     = 66000000;
-        #else
-          speed     = 64000000;
-        #endif
+
+  inline void _timer1WriteOCR(uint8_t channel, uint16_t ocr) {
+    #if defined(TC1H)
+      uint8_t oldsreg = SREG;
+      cli();
+      TC1H = ocr >> 8;
+      if (channel == 0) {
+        OCR1A = (uint8_t) ocr;
+      } else if (channel == 1) {
+        OCR1B = (uint8_t) ocr;
       } else {
-        speed       = F_CPU;
+        OCR1D = (uint8_t) ocr;
       }
-      uint32_t topval = speed/target;
-      if (topval < 64 && pll != 0x04) {
-        setTimer1Clock(TIMER1_64M_PLL);
-      } else if (topval < 128 && pll == 0) {
-        setTimer1Clock(TIMER1_32M_PLL);
+      TC1H = 0;
+      SREG = oldsreg;
+    #else
+      if (channel == 0) {
+        OCR1A = ocr;
       } else {
-        uint8_t newpresc = 1;
-        while (topval > 255 && newpresc < 15) {
-          newpresc++;
-          topval    >>= 1;
-        }
-        uint8_t top;
-        if (topval > 256) {
-          top = 255;
-        } else {
-          top = (uint8_t)topval - 1;
-        }
-        OCR1C         = top;
-        uint8_t tccr  = TCCR1B;
-        tccr         &= 0xF0;
-        tccr         |= newpresc;
-        TCCR1B        = tccr;
-        return top;
+        OCR1B = ocr;
+      }
+    #endif
+  }
+
+  /* The compare value for a duty cycle, as described in README.md */
+  inline uint16_t _timer1DutyToOCR(uint16_t duty) {
+    #if defined(TC1H)
+      if (TCCR1D & (1 << WGM10)) {
+        return duty;
       }
+    #endif
+    return duty - 1;
+  }
+
+  /* Sets the channel to the given duty cycle, connecting it to its pin (or pins) if it wasn't already.
+   * 0 disconnects it and drives its pins LOW. */
+  inline void setTimer1DutyCycle(uint8_t channel, uint16_t duty) {
+    if (channel >= TIMER1_CHANNELS) {
+      return;
+    }
+    bool both = _timer1Complementary() & (1 << channel);
+    if (duty == 0) {
+      _timer1SetCom(channel, 0);
+      digitalWrite(_timer1Pin(channel, false), LOW);
+      if (both) {
+        digitalWrite(_timer1Pin(channel, true), LOW);
+      }
+      return;
+    }
+    _timer1WriteOCR(channel, _timer1DutyToOCR(duty));
+    if (!_timer1GetCom(channel)) {
+      pinMode(_timer1Pin(channel, false), OUTPUT);
+      if (both) {
+        pinMode(_timer1Pin(channel, true), OUTPUT);
+      }
+      _timer1SetCom(channel, both ? 1 : 2);
     }
   }
-  uint16_t setTimer1Frequency_10bit(uint32_t target) {
-    while (true) {
-      unsigned long speed;
-      uint8_t pll   = PLLCSR;
-      pll          &= 0x84;
-      if (pll == 0x84) {
-        #if F_CPU  == 16500000
-          speed     = 33000000;
-        #else
-          speed     = 32000000;
-        #endif
-      } else if (pll) {
-        #if F_CPU  == 16500000
-          speed     = 66000000;
-        #else
-          speed     = 64000000;
-        #endif
-      } else {
-        speed       = F_CPU;
+
+  #if defined(TC1H) // the old name - setTimer1DutyCycle() does 10 bits where the timer does
+    inline void setTimer1DutyCycle_10bit(uint8_t channel, uint16_t duty) {
+      setTimer1DutyCycle(channel, duty);
+    }
+  #endif
+
+  /* Turns the inverted output of a channel on or off. */
+  inline void setTimer1Complementary(uint8_t channel, bool enable) {
+    if (channel >= TIMER1_CHANNELS) {
+      return;
+    }
+    if (enable) {
+      _timer1Complementary() |= (1 << channel);
+    } else {
+      _timer1Complementary() &= ~(1 << channel);
+    }
+    if (_timer1GetCom(channel)) {
+      if (enable) {
+        pinMode(_timer1Pin(channel, true), OUTPUT);
       }
-      uint32_t topval = speed/target;
-      if (topval < 10 && pll != 0x04) {
-        setTimer1Clock(TIMER1_64M_PLL);
-      } else if (topval < 128 && pll == 0) {
-        setTimer1Clock(TIMER1_32M_PLL);
-      } else {
-        uint8_t newpresc = 1;
-        while (topval > 1024 && newpresc < 15) {
-          newpresc++;
-          topval    >>= 1;
-        }
-        uint16_t top;
-        if (topval >= 1024) {
-          top = 1023;
-        } else {
-          top = (uint16_t)topval - 1;
-          setTimer1Top_10bit(top);
-        }
-        uint8_t tccr  = TCCR1B;
-        tccr         &= 0xF0;
-        tccr         |= newpresc;
-        TCCR1B        = tccr;
-        return top;
+      _timer1SetCom(channel, enable ? 1 : 2);
+      if (!enable) {
+        digitalWrite(_timer1Pin(channel, true), LOW);
       }
     }
   }
-  uint8_t pwmchannneltopin(uint8_t ch) {
-    #if defined (PINMAPPING_NEW)
-      if (ch < 3) {
-        return (uint8_t)9 + ch + ch;
+
+  /* Dead time, in counts of the timer's clock (before its prescaler) divided by presc: OC1x goes high
+   * risingDelay (0-15) after it would have, and OC1x-bar fallingDelay (0-15) after OC1x goes low.
+   * The x5 has a pair for each channel, the x61 one for all three; presc is shared on both. */
+  inline void setTimer1DeadTime(uint8_t channel, uint8_t risingDelay, uint8_t fallingDelay, TIMER1_DT_PRESCALE_t presc = TIMER1_DT_DIV1) {
+    uint8_t dt = (risingDelay << 4) | (fallingDelay & 0x0F);
+    #if defined(__AVR_ATtinyX5__)
+      DTPS1 = presc;
+      if (channel == 0) {
+        DT1A = dt;
+      } else {
+        DT1B = dt;
       }
     #else
-      if (ch <3) {
-        return (uint8_t)8 - ch - ch;
-      }
+      (void) channel;
+      TCCR1B = (TCCR1B & ~((1 << DTPS11) | (1 << DTPS10))) | (presc << DTPS10);
+      DT1 = dt;
     #endif
-    return NOT_A_PIN;
   }
-  void setTimer1DutyCycle_10bit(uint8_t channel, uint16_t duty) {
-    if (channel > 2 || duty > 1023) {
-      return; // invalid channel
+
+  #if defined(TIMER1_DITHER)
+    #if TIMER_TO_USE_FOR_MILLIS == 1
+      #error "TIMER1_DITHER needs the Timer1 overflow interrupt, which millis is using"
+    #endif
+    /* Neither part can dither in hardware, so it's done with the overflow interrupt: the compare value
+     * is raised by one for fraction (0-15) of every 16 PWM cycles, for 4 more bits of average
+     * resolution. The interrupt runs every cycle, so this only works well up to about F_CPU/200. */
+    struct _Timer1Dither {
+      uint16_t ocr;
+      uint8_t  fraction;
+      uint8_t  error;
+    };
+
+    inline volatile _Timer1Dither *_timer1Dither() {
+      static volatile _Timer1Dither dither[TIMER1_CHANNELS];
+      return dither;
     }
-    if (duty == 0) {
-      digitalWrite(pwmchanneltopin(channel), LOW);
-    } else if (duty == 1023) {
-      digitalWrite(pwmchanneltopin(channel), HIGH; );
-    } else {
+
+    inline void setTimer1DutyCycleDithered(uint8_t channel, uint16_t duty, uint8_t fraction) {
+      if (channel >= TIMER1_CHANNELS) {
+        return;
+      }
       uint8_t oldsreg = SREG;
       cli();
-      TC1H    = duty >> 8;
-      if (channel == 0) {
-        TCCR1C |= (1 << COM1A1S);
-        OCR1A = (uint8_t) duty;
-      } else if (channel == 1) {
-        TCCR1C |= (1 << COM1B1S);
-        OCR1B = (uint8_t) duty;
-      } else {
-        TCCR1C |= (1 << COM1D1);
-        OCR1D = (uint8_t) duty;
+      _timer1Dither()[channel].ocr = _timer1DutyToOCR(duty);
+      _timer1Dither()[channel].fraction = (duty ? fraction & 0x0F : 0);
+      SREG = oldsreg;
+      setTimer1DutyCycle(channel, duty);
+      TIMSK |= (1 << TOIE1);
+    }
+
+    ISR(TIMER1_OVF_vect) {
+      volatile _Timer1Dither *d = _timer1Dither();
+      for (uint8_t channel = 0; channel < TIMER1_CHANNELS; channel++, d++) {
+        if (d->fraction) {
+          uint8_t error = d->error + d->fraction;
+          uint16_t ocr = d->ocr;
+          if (error >= 16) {
+            error -= 16;
+            ocr++;
+          }
+          d->error = error;
+          _timer1WriteOCR(channel, ocr);
+        }
       }
-      SREG    = oldsreg;
     }
-  }
+  #endif
 #endif
 
 /* a grab-bag of miscellaneous functionality */
 
-
-
-uint8_t enableHighSinkPort(uint8_t port, bool mode) {
+inline uint8_t enableHighSinkPort(uint8_t port, bool mode) {
   #if defined(__AVR_ATtiny828__)
     if (port == PC) {
       PHDE = mode ? 0x04 : 0;
@@ -305,41 +407,48 @@ uint8_t enableHighSinkPort(uint8_t port, bool mode) {
       return 1;
     }
   #else
+    (void) port; (void) mode;
     badCall("Only the 828 has a whole port that can be set high-sink, though the 841/441 can set PA5 and PA7 high sink with enableHighSinkPin()");
+    return 1;
   #endif
 }
 
-uint8_t enableHighSinkPin(uint8_t pin, bool mode) {
-  #if defined(__AVR_ATtinyx41__)
+inline uint8_t enableHighSinkPin(uint8_t pin, bool mode) {
+  #if defined(__AVR_ATtinyX41__)
     if (pin == PIN_PA7 || pin == PIN_PA5) {
       if (mode) {
-        PHDE |= (pin==PIN_PA7,2,1);
+        PHDE |= (pin == PIN_PA7 ? 2 : 1);
       } else {
-        PHDE &= (pin==PIN_PA7,0xFD,0xFE);
+        PHDE &= (pin == PIN_PA7 ? 0xFD : 0xFE);
       }
       return 0;
     } else {
       return 1;
     }
   #else
+    (void) pin; (void) mode;
     badCall("Only the 841 and 441 support this. The 828 can set PORTC high-sink with enableHighSinkPort()");
+    return 1;
   #endif
 }
 
-uint8_t enableISRC(bool mode) {
-// The T167 can connect PA3 toan internal current source. This is much more precise than the internal pullups, and does not vary over voltage changes like they do. It was proposed for LIN addressing and a variety of other uncommon tasks,
-  #if defined(__AVR_ATtinyx7__)
+inline uint8_t enableISRC(bool mode) {
+// The T167 can connect PA3 to an internal current source. This is much more precise than the internal pullups, and does not vary over voltage changes like they do. It was proposed for LIN addressing and a variety of other uncommon tasks,
+  #if defined(__AVR_ATtinyX7__)
     if (mode) {
-      AMICR |= 1;
+      AMISCR |= 1;
     } else {
-      AMICR &= 0xFE;
+      AMISCR &= 0xFE;
     }
+    return 0;
   #else
+    (void) mode;
     badCall("The internal current source is only available on the t87 and t167");
+    return 1;
   #endif
 }
 
-void disableAllPullups(bool mode) {
+inline void disableAllPullups(bool mode) {
   #if defined(PUD)
     if (mode) {
       MCUCR |= 1 << PUD;
@@ -347,74 +456,87 @@ void disableAllPullups(bool mode) {
       MCUCR &= ~(1 << PUD);
     }
   #else
+    (void) mode;
     badCall("The global pullup disable feature is not available on this part");
   #endif
 }
 
-uint8_t enableBBM(uint8_t port, uint8_t mode) {
+inline uint8_t disablePortPullups(uint8_t port, bool mode) {
   #if defined(PORTCR) && defined(PUDB) //All parts have PORTB
+    uint8_t bit;
     #if defined(PORTA) && defined(PUDA)
       if (port == PA) {
-        PORTCR |= 1 << PUDA;
-        return 0;
+        bit = 1 << PUDA;
       } else
     #endif
     #if defined(PORTB) && defined(PUDB)
-      if (PORT == PB) {
-        PORTCR |= 1 << PUDB;
-        return 0;
+      if (port == PB) {
+        bit = 1 << PUDB;
       } else
     #endif
     #if defined(PORTC) && defined(PUDC)
-      if (PORT == PC) {
-        PORTCR |= 1 << PUDA;
-        return 0;
+      if (port == PC) {
+        bit = 1 << PUDC;
       } else
     #endif
     #if defined(PORTD) && defined(PUDD)
-      if (PORT == PD) {
-        PORTCR |= 1 << PUDD;
-        return 0;
+      if (port == PD) {
+        bit = 1 << PUDD;
       } else
     #endif
     {
       return 1;
     }
+    if (mode) {
+      PORTCR |= bit;
+    } else {
+      PORTCR &= ~bit;
+    }
+    return 0;
   #else
+    (void) port; (void) mode;
     badCall("This part does not support portwise pullup disabling");
+    return 1;
   #endif
 }
 
-uint8_t enableBBM(uint8_t port, uint8_t mode) {
-  #if defined(PORTCR)
+inline uint8_t enableBBM(uint8_t port, bool mode) {
+  #if defined(PORTCR) && (defined(BBMA) || defined(BBMB))
+    uint8_t bit;
     #if defined(PORTA) && defined(BBMA)
       if (port == PA) {
-        PORTCR |= 1 << BBMA;
-        return 0;
+        bit = 1 << BBMA;
       } else
     #endif
     #if defined(PORTB) && defined(BBMB)
-      if (PORT == PB) {
-        PORTCR |= 1 << BBMB;
-        return 0;
+      if (port == PB) {
+        bit = 1 << BBMB;
       } else
     #endif
     #if defined(PORTC) && defined(BBMC)
-      if (PORT == PC) {
-        PORTCR |= 1 << BBMC;
-        return 0;
+      if (port == PC) {
+        bit = 1 << BBMC;
       } else
     #endif
     #if defined(PORTD) && defined(BBMD)
-      if (PORT == PD) {
-        PORTCR |= 1 << BBMD;
-        return 0;
+      if (port == PD) {
+        bit = 1 << BBMD;
       } else
     #endif
     {
       return 1;
     }
+    if (mode) {
+      PORTCR |= bit;
+    } else {
+      PORTCR &= ~bit;
+    }
+    return 0;
   #else
+    (void) port; (void) mode;
     badCall("This port does not support BBM mode.");
+    return 1;
   #endif
 }
+
+#endif
@@ -240,8 +240,6 @@ void SPIClass::notUsingInterrupt(uint8_t interruptNumber) {
 #else
 #ifdef USICR
 
-#include <util/delay_basic.h>
-
 SPIClass::SPIClass() {
 }
 
@@ -279,29 +277,6 @@ USI_impl::ClockOut USI_impl::dispatchClockout_slow(uint8_t div, uint8_t* delay)
     return dispatchClockout(div, delay);
 }
 
-static byte reverse (byte x) {
- byte result;
- asm("mov __tmp_reg__, %[in] \n\t"
-  "lsl __tmp_reg__  \n\t"   /* shift out high bit to carry */
-  "ror %[out] \n\t"  /* rotate carry __tmp_reg__to low bit (eventually) */
-  "lsl __tmp_reg__  \n\t"   /* 2 */
-  "ror %[out] \n\t"
-  "lsl __tmp_reg__  \n\t"   /* 3 */
-  "ror %[out] \n\t"
-  "lsl __tmp_reg__  \n\t"   /* 4 */
-  "ror %[out] \n\t"
-  "lsl __tmp_reg__  \n\t"   /* 5 */
-  "ror %[out] \n\t"
-  "lsl __tmp_reg__  \n\t"   /* 6 */
-  "ror %[out] \n\t"
-  "lsl __tmp_reg__  \n\t"   /* 7 */
-  "ror %[out] \n\t"
-  "lsl __tmp_reg__  \n\t"   /* 8 */
-  "ror %[out] \n\t"
-  : [out] "=r" (result) : [in] "r" (x));
-  return(result);
-}
-
 uint8_t USI_impl::clockoutUSI2(uint8_t data, uint8_t) {
     // Unlike other clockout methods, this one cannot rely on the
     // "external" clock source (USICS1) because it is too slow and
@@ -312,83 +287,68 @@ uint8_t USI_impl::clockoutUSI2(uint8_t data, uint8_t) {
     bool mode1 = usicr & _BV(USICS0);
     USISR = _BV(USIOIF);  //clear counter and counter overflow interrupt flag
     USIDR = data;
-    // Use asm to prevent instruction reordering.
-    if (!mode1) {
-        asm volatile("out %[usicr], %[strobe1] \n\t"
-                     "out %[usicr], %[strobe2] \n\t"
-                     "out %[usicr], %[strobe1] \n\t"
-                     "out %[usicr], %[strobe2] \n\t"
-                     "out %[usicr], %[strobe1] \n\t"
-                     "out %[usicr], %[strobe2] \n\t"
-                     "out %[usicr], %[strobe1] \n\t"
-                     "out %[usicr], %[strobe2] \n\t"
-                     "out %[usicr], %[strobe1] \n\t"
-                     "out %[usicr], %[strobe2] \n\t"
-                     "out %[usicr], %[strobe1] \n\t"
-                     "out %[usicr], %[strobe2] \n\t"
-                     "out %[usicr], %[strobe1] \n\t"
-                     "out %[usicr], %[strobe2] \n\t"
-                     "out %[usicr], %[strobe1] \n\t"
-                     "out %[usicr], %[strobe2] \n\t"
-                     :: [usicr] "I" (_SFR_IO_ADDR(USICR)),
-                        [strobe1] "r" (strobe1),
-                        [strobe2] "r" (strobe2));
-    } else {
-        asm volatile("out %[usicr], %[strobe1] \n\t"
-                     "out %[usicr], %[strobe1] \n\t"
-                     "out %[usicr], %[strobe1] \n\t"
-                     "out %[usicr], %[strobe2] \n\t"
-                     "out %[usicr], %[strobe1] \n\t"
-                     "out %[usicr], %[strobe2] \n\t"
-                     "out %[usicr], %[strobe1] \n\t"
-                     "out %[usicr], %[strobe2] \n\t"
-                     "out %[usicr], %[strobe1] \n\t"
-                     "out %[usicr], %[strobe2] \n\t"
-                     "out %[usicr], %[strobe1] \n\t"
-                     "out %[usicr], %[strobe2] \n\t"
-                     "out %[usicr], %[strobe1] \n\t"
-                     "out %[usicr], %[strobe2] \n\t"
-                     "out %[usicr], %[strobe1] \n\t"
-                     "out %[usicr], %[strobe2] \n\t"
-                     :: [usicr] "I" (_SFR_IO_ADDR(USICR)),
-                        [strobe1] "r" (strobe1),
-                        [strobe2] "r" (strobe2));
-    }
+    shiftUSI2(strobe1, strobe2, mode1);
     uint8_t retval = USIDR;
     USICR = usicr;
     return retval;
 }
 
-__attribute__((optimize (3, "unroll-all-loops")))
 uint8_t USI_impl::clockoutUSI4(uint8_t data, uint8_t) {
     USISR = _BV(USIOIF);
     USIDR = data;
-    for (byte i = 0; i < 16; ++i) {
-        USICR |= _BV(USITC); // compiles to sbi, two cycles
-    }
+    shiftUSI4();
     return USIDR;
 }
 
-__attribute__((optimize (3, "unroll-all-loops")))
 uint8_t USI_impl::clockoutUSI8(uint8_t data, uint8_t) {
     USISR = _BV(USIOIF);
     USIDR = data;
-    for (byte i = 0; i < 16; ++i) {
-        USICR |= _BV(USITC); // compiles to sbi, two cycles
-        USICR &= ~_BV(USITC); // compiles to cbi, two cycles, effectively nop
-    }
+    shiftUSI8();
     return USIDR;
 }
 
+/* Block versions: NULL tx sends 0xFF's, NULL rx throws away what comes back. The counter is
+ * only cleared once - 16 strobes take it all the way around, so it's back at 0 for the next byte. */
+void USI_impl::transferUSI2(const uint8_t *tx, uint8_t *rx, size_t count) {
+    uint8_t strobe1 = _BV(USIWM0) | _BV(USITC);
+    uint8_t strobe2 = _BV(USIWM0) | _BV(USITC) | _BV(USICLK);
+    uint8_t usicr = USICR;
+    bool mode1 = usicr & _BV(USICS0);
+    USISR = _BV(USIOIF);
+    while (count--) {
+        USIDR = tx ? *tx++ : 0xFF;
+        shiftUSI2(strobe1, strobe2, mode1);
+        uint8_t in = USIDR;
+        if (rx) *rx++ = in;
+    }
+    USICR = usicr;
+}
+
+void USI_impl::transferUSI4(const uint8_t *tx, uint8_t *rx, size_t count) {
+    USISR = _BV(USIOIF);
+    while (count--) {
+        USIDR = tx ? *tx++ : 0xFF;
+        shiftUSI4();
+        uint8_t in = USIDR;
+        if (rx) *rx++ = in;
+    }
+}
+
+void USI_impl::transferUSI8(const uint8_t *tx, uint8_t *rx, size_t count) {
+    USISR = _BV(USIOIF);
+    while (count--) {
+        USIDR = tx ? *tx++ : 0xFF;
+        shiftUSI8();
+        uint8_t in = USIDR;
+        if (rx) *rx++ = in;
+    }
+}
+
 __attribute__((optimize ("Os")))
 uint8_t USI_impl::clockoutUSI(uint8_t data, uint8_t delay) {
-    uint8_t tmp = USICR | _BV(USITC);
     USISR = _BV(USIOIF);
     USIDR = data;
-    for (byte i = 0; i < 16; ++i) {
-        USICR = tmp; // compiles to out, one cycle
-        _delay_loop_1(delay); // delay calculated by SPISettings.
-    }
+    USI_impl::shiftUSI(delay); // delay calculated by SPISettings.
     return USIDR;
 }
 
@@ -396,7 +356,7 @@ uint8_t SPIClass::transfer(uint8_t spiData) {
     if (msb1st) {
         return clockoutfn(spiData, delay);
     } else {
-        return reverse(clockoutfn(reverse(spiData), delay));
+        return USI_impl::reverse(clockoutfn(USI_impl::reverse(spiData), delay));
     }
 }
 
@@ -407,26 +367,38 @@ uint16_t SPIClass::transfer16(uint16_t data) {
         tmp.msb = clockoutfn(tmp.msb, delay);
         tmp.lsb = clockoutfn(tmp.lsb, delay);
     } else {
-        tmp.lsb = reverse(clockoutfn(reverse(tmp.lsb), delay));
-        tmp.msb = reverse(clockoutfn(reverse(tmp.msb), delay));
+        tmp.lsb = USI_impl::reverse(clockoutfn(USI_impl::reverse(tmp.lsb), delay));
+        tmp.msb = USI_impl::reverse(clockoutfn(USI_impl::reverse(tmp.msb), delay));
     }
     return tmp.val;
 }
 
 void SPIClass::transfer(void* _buf, size_t count) {
-    uint8_t* buf = (uint8_t*)_buf;
-    if (!msb1st) {
-        for (uint8_t i = 0; i < count; ++i) {
-            buf[i] = reverse(buf[i]);
+    transfer(_buf, _buf, count);
+}
+
+void SPIClass::transfer(const void* _txbuf, void* _rxbuf, size_t count) {
+    const uint8_t* tx = (const uint8_t*)_txbuf;
+    uint8_t* rx = (uint8_t*)_rxbuf;
+    // Pick the loop once, here, rather than going through clockoutfn for every byte.
+    if (msb1st) {
+        if (clockoutfn == USI_impl::clockoutUSI2) {
+            USI_impl::transferUSI2(tx, rx, count);
+            return;
         }
-    }
-    for (uint8_t i = 0; i < count; ++i) {
-        buf[i] = clockoutfn(buf[i], delay);
-    }
-    if (!msb1st) {
-        for (uint8_t i = 0; i < count; ++i) {
-            buf[i] = reverse(buf[i]);
+        if (clockoutfn == USI_impl::clockoutUSI4) {
+            USI_impl::transferUSI4(tx, rx, count);
+            return;
         }
+        if (clockoutfn == USI_impl::clockoutUSI8) {
+            USI_impl::transferUSI8(tx, rx, count);
+            return;
+        }
+    }
+    // LSB first, or the slow speeds, where the call is lost in the delays anyway
+    while (count--) {
+        uint8_t in = transfer(tx ? *tx++ : (uint8_t)0xFF);
+        if (rx) *rx++ = in;
     }
 }
 
@@ -263,6 +263,10 @@ public:
     }
     return out.val;
   }
+  /* In the block transfers, the next byte is fetched while the last one is still being shifted,
+   * so the gap between bytes is just the in and out. The byte received is read before the next
+   * one goes out, not after - the receive buffer would let us do it the other way around, but
+   * then an interrupt in between that lasted longer than a byte would lose it. */
   inline static void transfer(void *buf, size_t count) {
     if (count == 0) return;
     uint8_t *p = (uint8_t *)buf;
@@ -277,6 +281,36 @@ public:
     while (!(SPSR & _BV(SPIF))) ;
     *p = SPDR;
   }
+  // Send count bytes from txbuf (or 0xFF's, if it's NULL) and put what comes back in rxbuf (unless that's NULL)
+  inline static void transfer(const void *txbuf, void *rxbuf, size_t count) {
+    if (count == 0) return;
+    const uint8_t *tx = (const uint8_t *)txbuf;
+    uint8_t *rx = (uint8_t *)rxbuf;
+    SPDR = tx ? *tx++ : 0xFF;
+    while (--count > 0) {
+      uint8_t out = tx ? *tx++ : 0xFF;
+      while (!(SPSR & _BV(SPIF))) ;
+      uint8_t in = SPDR;
+      SPDR = out;
+      if (rx) *rx++ = in;
+    }
+    while (!(SPSR & _BV(SPIF))) ;
+    uint8_t in = SPDR;
+    if (rx) *rx = in;
+  }
+  // Send count bytes from txbuf, ignoring what comes back
+  inline static void transmit(const void *txbuf, size_t count) {
+    if (count == 0) return;
+    const uint8_t *tx = (const uint8_t *)txbuf;
+    SPDR = *tx++;
+    while (--count > 0) {
+      uint8_t out = *tx++;
+      while (!(SPSR & _BV(SPIF))) ;
+      SPDR = out;
+    }
+    while (!(SPSR & _BV(SPIF))) ;
+    (void)SPDR; // clears SPIF
+  }
   // After performing a group of transfers and releasing the chip select
   // signal, this function allows others to access the SPI bus
   inline static void endTransaction(void) {
@@ -343,11 +377,43 @@ private:
 
 extern SPIClass SPI;
 
+/* SPIFixed<clock, bitOrder, dataMode> - for settings known at compile time. On the USI parts
+ * this inlines the clocking for those settings into the sketch; with real SPI hardware there's
+ * nothing to gain, since SPISettings is worked out at compile time and the transfers are inline
+ * already, so this just hands its settings to SPI - it's here so code that uses it is portable. */
+template <uint32_t clock, uint8_t bitOrder = MSBFIRST, uint8_t dataMode = SPI_MODE0>
+class SPIFixed {
+public:
+  inline static void beginTransaction() {
+    SPIClass::beginTransaction(SPISettings(clock, bitOrder, dataMode));
+  }
+  inline static void endTransaction() {
+    SPIClass::endTransaction();
+  }
+  inline static uint8_t transfer(uint8_t data) {
+    return SPIClass::transfer(data);
+  }
+  inline static uint16_t transfer16(uint16_t data) {
+    return SPIClass::transfer16(data);
+  }
+  inline static void transfer(void *buf, size_t count) {
+    SPIClass::transfer(buf, count);
+  }
+  inline static void transfer(const void *txbuf, void *rxbuf, size_t count) {
+    SPIClass::transfer(txbuf, rxbuf, count);
+  }
+  inline static void transmit(const void *txbuf, size_t count) {
+    SPIClass::transmit(txbuf, count);
+  }
+};
+
 
 #else
 
 #ifdef USICR //if we have a USI instead, use that
 
+#include <util/delay_basic.h>
+
 //SPI data modes
 #define SPI_MODE0 0x00
 #define SPI_MODE1 0x01
@@ -373,6 +439,119 @@ namespace USI_impl {
     uint8_t clockoutUSI2(uint8_t data, uint8_t delay);
     uint8_t clockoutUSI4(uint8_t data, uint8_t delay);
     uint8_t clockoutUSI8(uint8_t data, uint8_t delay);
+    // Whole buffers, MSB first, at the three fixed speeds; tx and rx as for SPIClass::transfer()
+    void transferUSI2(const uint8_t *tx, uint8_t *rx, size_t count);
+    void transferUSI4(const uint8_t *tx, uint8_t *rx, size_t count);
+    void transferUSI8(const uint8_t *tx, uint8_t *rx, size_t count);
+
+    // Clock divider for a requested SCK frequency, rounded up
+    constexpr uint8_t clockDiv(uint32_t clock) {
+      return F_CPU / clock + (F_CPU % clock ? 1 : 0);
+    }
+    // Delay loop count for the slow speeds (clock dividers over 8)
+    constexpr uint8_t slowDelay(uint8_t div) {
+      // Round it to nearest integer.
+      return (uint8_t)(((uint16_t)div*100 - 780) / 59) < 10 ? 1 : ((uint8_t)(((uint16_t)div*100 - 780) / 59) + 5) / 10;
+    }
+
+    // The USI only shifts MSB first, so for LSB first every byte is reversed on the way in and out
+    __attribute__((always_inline))
+    inline uint8_t reverse(uint8_t x) {
+        uint8_t result;
+        asm("mov __tmp_reg__, %[in] \n\t"
+            "lsl __tmp_reg__  \n\t"   /* shift out high bit to carry */
+            "ror %[out] \n\t"  /* rotate carry __tmp_reg__to low bit (eventually) */
+            "lsl __tmp_reg__  \n\t"   /* 2 */
+            "ror %[out] \n\t"
+            "lsl __tmp_reg__  \n\t"   /* 3 */
+            "ror %[out] \n\t"
+            "lsl __tmp_reg__  \n\t"   /* 4 */
+            "ror %[out] \n\t"
+            "lsl __tmp_reg__  \n\t"   /* 5 */
+            "ror %[out] \n\t"
+            "lsl __tmp_reg__  \n\t"   /* 6 */
+            "ror %[out] \n\t"
+            "lsl __tmp_reg__  \n\t"   /* 7 */
+            "ror %[out] \n\t"
+            "lsl __tmp_reg__  \n\t"   /* 8 */
+            "ror %[out] \n\t"
+            : [out] "=r" (result) : [in] "r" (x));
+        return result;
+    }
+
+    /* The 16 clock strobes for one byte at each of the fixed speeds. These are used by the one-byte
+     * clockout functions, by the block transfers, where they get inlined into the loop so a buffer
+     * costs one call rather than one (indirect) call per byte, and by SPIFixed, where they get
+     * inlined into the sketch. They're written out 16 times rather than looped over because at -Os
+     * the loop wouldn't be unrolled once inlined into a caller, and the loop overhead would be
+     * between the strobes. */
+    #define USI_STROBE_X16(s) do { s; s; s; s; s; s; s; s; s; s; s; s; s; s; s; s; } while (0)
+    __attribute__((always_inline))
+    inline void shiftUSI2(uint8_t strobe1, uint8_t strobe2, bool mode1) {
+        // Use asm to prevent instruction reordering.
+        if (!mode1) {
+            asm volatile("out %[usicr], %[strobe1] \n\t"
+                         "out %[usicr], %[strobe2] \n\t"
+                         "out %[usicr], %[strobe1] \n\t"
+                         "out %[usicr], %[strobe2] \n\t"
+                         "out %[usicr], %[strobe1] \n\t"
+                         "out %[usicr], %[strobe2] \n\t"
+                         "out %[usicr], %[strobe1] \n\t"
+                         "out %[usicr], %[strobe2] \n\t"
+                         "out %[usicr], %[strobe1] \n\t"
+                         "out %[usicr], %[strobe2] \n\t"
+                         "out %[usicr], %[strobe1] \n\t"
+                         "out %[usicr], %[strobe2] \n\t"
+                         "out %[usicr], %[strobe1] \n\t"
+                         "out %[usicr], %[strobe2] \n\t"
+                         "out %[usicr], %[strobe1] \n\t"
+                         "out %[usicr], %[strobe2] \n\t"
+                         :: [usicr] "I" (_SFR_IO_ADDR(USICR)),
+                            [strobe1] "r" (strobe1),
+                            [strobe2] "r" (strobe2));
+        } else {
+            asm volatile("out %[usicr], %[strobe1] \n\t"
+                         "out %[usicr], %[strobe1] \n\t"
+                         "out %[usicr], %[strobe1] \n\t"
+                         "out %[usicr], %[strobe2] \n\t"
+                         "out %[usicr], %[strobe1] \n\t"
+                         "out %[usicr], %[strobe2] \n\t"
+                         "out %[usicr], %[strobe1] \n\t"
+                         "out %[usicr], %[strobe2] \n\t"
+                         "out %[usicr], %[strobe1] \n\t"
+                         "out %[usicr], %[strobe2] \n\t"
+                         "out %[usicr], %[strobe1] \n\t"
+                         "out %[usicr], %[strobe2] \n\t"
+                         "out %[usicr], %[strobe1] \n\t"
+                         "out %[usicr], %[strobe2] \n\t"
+                         "out %[usicr], %[strobe1] \n\t"
+                         "out %[usicr], %[strobe2] \n\t"
+                         :: [usicr] "I" (_SFR_IO_ADDR(USICR)),
+                            [strobe1] "r" (strobe1),
+                            [strobe2] "r" (strobe2));
+        }
+    }
+
+    __attribute__((always_inline))
+    inline void shiftUSI4() {
+        USI_STROBE_X16(USICR |= _BV(USITC)); // compiles to sbi, two cycles
+    }
+
+    __attribute__((always_inline))
+    inline void shiftUSI8() {
+        // sbi, two cycles, then cbi, two cycles, effectively nop
+        USI_STROBE_X16(USICR |= _BV(USITC); USICR &= ~_BV(USITC));
+    }
+
+    // The slow speeds: delay as worked out by dispatchClockout()
+    __attribute__((always_inline))
+    inline void shiftUSI(uint8_t delay) {
+        uint8_t tmp = USICR | _BV(USITC);
+        for (byte i = 0; i < 16; ++i) {
+            USICR = tmp; // compiles to out, one cycle
+            _delay_loop_1(delay);
+        }
+    }
 
     __attribute__((always_inline))
     inline ClockOut dispatchClockout(uint8_t div, uint8_t* delay) {
@@ -385,10 +564,7 @@ namespace USI_impl {
           return clockoutUSI8;
       } else {
         // Slow mode, convert clockdiv into delay loop count.
-        // Calculated inline to allow compile-time evaluation.
-        *delay = ((uint16_t)div*100 - 780) / 59;
-        // Round it to nearest integer.
-        *delay = *delay < 10 ? 1 : (*delay + 5) / 10;
+        *delay = slowDelay(div);
         return clockoutUSI;
       }
     }
@@ -440,6 +616,10 @@ class SPIClass
   static uint8_t transfer(uint8_t data);
   static uint16_t transfer16(uint16_t data);
   static void transfer(void *buf, size_t count);
+  // Send count bytes from txbuf (or 0xFF's, if it's NULL) and put what comes back in rxbuf (unless that's NULL)
+  static void transfer(const void *txbuf, void *rxbuf, size_t count);
+  // Send count bytes from txbuf, ignoring what comes back
+  static void transmit(const void *txbuf, size_t count) {transfer(txbuf, NULL, count);}
   static void endTransaction(void);
   static void end();
 
@@ -475,6 +655,82 @@ private:
 
 extern SPIClass SPI;
 
+/* SPIFixed<clock, bitOrder, dataMode> - the same transfers as SPIClass, for settings that are
+ * known at compile time. SPIClass has to look up what to do from the last beginTransaction() on
+ * every byte, and call it through a pointer; here the strobe sequence for that clock (and the
+ * bit reversal, for LSB first) is inlined right where transfer() is called, so a byte at
+ * SPI_CLOCK_DIV2 is 16 outs and the loads and stores around them. This makes every call site
+ * bigger, of course - for lots of calls, or for big buffers, the block transfers of SPIClass
+ * are generally the better choice.
+ *
+ *   SPIFixed<4000000, MSBFIRST, SPI_MODE0> dac;
+ *   dac.beginTransaction();
+ *   dac.transfer(0x30);
+ *   dac.endTransaction();
+ *
+ * beginTransaction() and endTransaction() are those of SPI (so usingInterrupt() applies, and
+ * SPI.transfer() is fine inside the transaction, too); beginTransaction() must be called before
+ * the transfers, as it's what puts the USI in the right mode. */
+template <uint32_t clock, uint8_t bitOrder = MSBFIRST, uint8_t dataMode = SPI_MODE0>
+class SPIFixed {
+  static constexpr uint8_t div = USI_impl::clockDiv(clock);
+  static constexpr bool mode1 = dataMode == SPI_MODE1 || dataMode == SPI_MODE3;
+  static constexpr uint8_t usicr = _BV(USIWM0) | _BV(USICS1) | _BV(USICLK) | (mode1 ? _BV(USICS0) : 0);
+
+  __attribute__((always_inline)) static inline void shift() {
+    if (div <= 2) {
+      USI_impl::shiftUSI2(_BV(USIWM0) | _BV(USITC), _BV(USIWM0) | _BV(USITC) | _BV(USICLK), mode1);
+      USICR = usicr;
+    } else if (div <= 4) {
+      USI_impl::shiftUSI4();
+    } else if (div <= 8) {
+      USI_impl::shiftUSI8();
+    } else {
+      USI_impl::shiftUSI(USI_impl::slowDelay(div));
+    }
+  }
+
+public:
+  static void beginTransaction() {
+    SPIClass::beginTransaction(SPISettings(clock, bitOrder, dataMode));
+  }
+  static void endTransaction() {
+    SPIClass::endTransaction();
+  }
+  __attribute__((always_inline)) static inline uint8_t transfer(uint8_t data) {
+    if (bitOrder == LSBFIRST) data = USI_impl::reverse(data);
+    USISR = _BV(USIOIF);
+    USIDR = data;
+    shift();
+    data = USIDR;
+    if (bitOrder == LSBFIRST) data = USI_impl::reverse(data);
+    return data;
+  }
+  __attribute__((always_inline)) static inline uint16_t transfer16(uint16_t data) {
+    if (bitOrder == LSBFIRST) {
+      uint8_t lsb = transfer((uint8_t)data);
+      return lsb | (uint16_t)transfer(data >> 8) << 8;
+    }
+    uint8_t msb = transfer(data >> 8);
+    return (uint16_t)msb << 8 | transfer((uint8_t)data);
+  }
+  // As for SPIClass: NULL txbuf sends 0xFF's, NULL rxbuf throws away what comes back
+  static inline void transfer(const void *txbuf, void *rxbuf, size_t count) {
+    const uint8_t *tx = (const uint8_t *)txbuf;
+    uint8_t *rx = (uint8_t *)rxbuf;
+    while (count--) {
+      uint8_t in = transfer(tx ? *tx++ : (uint8_t)0xFF);
+      if (rx) *rx++ = in;
+    }
+  }
+  static inline void transfer(void *buf, size_t count) {
+    transfer(buf, buf, count);
+  }
+  static inline void transmit(const void *txbuf, size_t count) {
+    transfer(txbuf, NULL, count);
+  }
+};
+
 
 
 #else
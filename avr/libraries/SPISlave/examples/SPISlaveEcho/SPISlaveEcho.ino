@@ -0,0 +1,37 @@
+/* SPISlaveEcho - answers every byte with that byte plus one
+
+  Each byte the master sends is read back out of SPISlave, and the byte after
+  it is queued to go out. The byte that goes out during the next transfer is
+  already in the SPI by the time the sketch sees the one that came in, so the
+  answer comes back one byte later than that - a master sending 1, 2, 3, 4, 5
+  gets back 0xFF, 0xFF (nothing queued yet), 2, 3, 4. Give the sketch time to
+  answer between bytes, too: SPISlave never holds the master up.
+
+  The LED (if there is one) is lit while the master has SS low.
+
+  The circuit:
+   * Master's SCK to SCK, master's MOSI to MOSI (on USI parts, that's DI),
+     master's MISO to MISO (on USI parts, DO), and a chip select to SS.
+*/
+
+#include <SPISlave.h>
+
+void selectChanged(bool selected) {
+  #ifdef LED_BUILTIN
+    digitalWrite(LED_BUILTIN, selected ? HIGH : LOW);
+  #endif
+}
+
+void setup() {
+  #ifdef LED_BUILTIN
+    pinMode(LED_BUILTIN, OUTPUT);
+  #endif
+  SPISlave.onSelect(selectChanged);
+  SPISlave.begin(SPI_MODE0);
+}
+
+void loop() {
+  while (SPISlave.available()) {
+    SPISlave.write(SPISlave.read() + 1);
+  }
+}
@@ -0,0 +1,226 @@
+/* SPISlave.cpp - interrupt driven SPI slave on hardware SPI or the USI
+ * Part of ATTinyCore - github.com/SpenceKonde/ATTinyCore
+ *   Free Software - LGPL 2.1, please see LICENCE.md for details
+ *---------------------------------------------------------------------------*/
+
+#include "SPISlave.h"
+
+SPISlaveClass SPISlave;
+
+/* Which pin change interrupt SS is on. On every part here, SS's bit in its PCMSK is its bit in
+ * the port, so only the register, the enable bit and the vector need looking up. */
+#if defined(__AVR_ATtiny1634__) || defined(__AVR_ATtiny828__)
+  #define SPISLAVE_CS_PCMSK     PCMSK2
+  #define SPISLAVE_CS_PCIE      PCIE2
+  #define SPISLAVE_CS_VECT      PCINT2_vect
+#elif defined(__AVR_ATtiny43U__)
+  #define SPISLAVE_CS_PCMSK     PCMSK1
+  #define SPISLAVE_CS_PCIE      PCIE1
+  #define SPISLAVE_CS_VECT      PCINT1_vect
+#elif defined(__AVR_ATtiny261__) || defined(__AVR_ATtiny461__) || defined(__AVR_ATtiny861__) || \
+      defined(__AVR_ATtiny261A__) || defined(__AVR_ATtiny461A__) || defined(__AVR_ATtiny861A__)
+  // PCIE0 is PCINT8-11, PCIE1 everything else
+  #ifdef SET_REMAPUSI
+    #define SPISLAVE_CS_PCMSK   PCMSK0
+    #define SPISLAVE_CS_PCIE    PCIE1
+  #else
+    #define SPISLAVE_CS_PCMSK   PCMSK1
+    #define SPISLAVE_CS_PCIE    PCIE0
+  #endif
+  #define SPISLAVE_CS_VECT      PCINT_vect
+#elif defined(PCMSK0) // x4, x7, x8, x41
+  #define SPISLAVE_CS_PCMSK     PCMSK0
+  #define SPISLAVE_CS_PCIE      PCIE0
+  #define SPISLAVE_CS_VECT      PCINT0_vect
+#else // x5, x313
+  #define SPISLAVE_CS_PCMSK     PCMSK
+  #ifdef PCIE0
+    #define SPISLAVE_CS_PCIE    PCIE0
+  #else
+    #define SPISLAVE_CS_PCIE    PCIE
+  #endif
+  #if defined(PCINT0_vect)
+    #define SPISLAVE_CS_VECT    PCINT0_vect
+  #elif defined(PCINT_B_vect)
+    #define SPISLAVE_CS_VECT    PCINT_B_vect
+  #else
+    #define SPISLAVE_CS_VECT    PCINT_vect
+  #endif
+#endif
+#if defined(PCICR)
+  #define SPISLAVE_CS_PCICR     PCICR
+#else
+  #define SPISLAVE_CS_PCICR     GIMSK
+#endif
+
+#if defined(SPDR)
+  #if defined(SPI_STC_vect)
+    #define SPISLAVE_VECT       SPI_STC_vect
+  #else
+    #define SPISLAVE_VECT       SPI_vect
+  #endif
+  #define SPISLAVE_DATA         SPDR
+#else
+  #define SPISLAVE_VECT         USI_OVERFLOW_VECTOR
+  #define SPISLAVE_DATA         USIDR
+#endif
+
+void SPISlaveClass::begin(uint8_t dataMode, uint8_t bitOrder) {
+  uint8_t sreg = SREG;
+  cli();
+  _rx_buffer.reset();
+  _tx_buffer.reset();
+  _cs_port = portInputRegister(digitalPinToPort(SS));
+  _cs_mask = digitalPinToBitMask(SS);
+  _selected = false;
+  pinMode(SS, INPUT);
+  #if defined(SPDR)
+    pinMode(MOSI, INPUT);
+    pinMode(SCK, INPUT);
+    /* In slave mode, the SPI module takes over the value of MISO, but not its direction - left an
+     * output while SS is high, it would fight the other slaves on the bus - so it's made an output
+     * only while selected, in the pin change interrupt, like DO is on the USI. */
+    pinMode(MISO, INPUT);
+    _miso_ddr = portModeRegister(digitalPinToPort(MISO));
+    _miso_mask = digitalPinToBitMask(MISO);
+    SPCR = _BV(SPE) | _BV(SPIE) | (dataMode & SPI_MODE_MASK) | (bitOrder == LSBFIRST ? _BV(DORD) : 0);
+    (void)SPSR;
+    (void)SPDR; // clear any old SPIF
+  #else
+    pinMode(USI_DI, INPUT);
+    pinMode(USI_SCK, INPUT);
+    pinMode(USI_DO, INPUT); // until selected
+    /* Three wire mode, clocked by USCK. Modes 0 and 3 sample on the rising edge, 1 and 2 on the
+     * falling one; the counter counts both, so it overflows after the 8th sampling edge. */
+    _usicr = _BV(USIOIE) | _BV(USIWM0) | _BV(USICS1);
+    if (dataMode == SPI_MODE1 || dataMode == SPI_MODE2) {
+      _usicr |= _BV(USICS0);
+    }
+    _lsb1st = (bitOrder == LSBFIRST);
+    USICR = 0; // no clock until selected, so USIDR keeps what's put in it
+  #endif
+  _prefetch();
+  SPISLAVE_DATA = _next;
+  _cur_is_fill = _next_is_fill;
+  _prefetch();
+  SPISLAVE_CS_PCMSK |= _cs_mask;
+  SPISLAVE_CS_PCICR |= _BV(SPISLAVE_CS_PCIE);
+  SREG = sreg;
+}
+
+void SPISlaveClass::end() {
+  uint8_t sreg = SREG;
+  cli();
+  SPISLAVE_CS_PCMSK &= ~_cs_mask;
+  #if defined(SPDR)
+    SPCR = 0;
+    pinMode(MISO, INPUT);
+  #else
+    USICR = 0;
+    pinMode(USI_DO, INPUT);
+  #endif
+  _selected = false;
+  SREG = sreg;
+}
+
+/* Where the fill byte is lined up to go out, and the sketch has since queued something, send that
+ * instead. Called with interrupts off. While SS is low, that can only be the byte after the one in
+ * the shift register; while it's high, nothing is being shifted, so that one can be replaced too. */
+void SPISlaveClass::_reprime() {
+  if (_next_is_fill) {
+    _prefetch();
+  }
+  if (!_selected && _cur_is_fill && !_next_is_fill) {
+    SPISLAVE_DATA = _next;
+    _cur_is_fill = false;
+    _prefetch();
+  }
+}
+
+int SPISlaveClass::available(void) {
+  return _rx_buffer.available();
+}
+
+int SPISlaveClass::peek(void) {
+  int16_t c = _rx_buffer.peek();
+  #if !defined(SPDR)
+    if (c >= 0 && _lsb1st) c = USI_impl::reverse(c);
+  #endif
+  return c;
+}
+
+int SPISlaveClass::read(void) {
+  uint8_t c;
+  if (!_rx_buffer.pop(c)) {
+    return -1;
+  }
+  #if !defined(SPDR)
+    if (_lsb1st) c = USI_impl::reverse(c);
+  #endif
+  return c;
+}
+
+void SPISlaveClass::flush(void) {
+  while (!_tx_buffer.empty());
+}
+
+int SPISlaveClass::availableForWrite(void) {
+  return _tx_buffer.space();
+}
+
+size_t SPISlaveClass::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t SPISlaveClass::write(const uint8_t *buffer, size_t size) {
+  size_t n = _tx_buffer.push_n(buffer, size);
+  if (n) {
+    uint8_t sreg = SREG;
+    cli();
+    _reprime();
+    SREG = sreg;
+  }
+  return n;
+}
+
+/* Transfer complete: the byte that came in is swapped for the one going out before anything else. */
+ISR(SPISLAVE_VECT) {
+  uint8_t in = SPISLAVE_DATA;
+  SPISLAVE_DATA = SPISlave._next;
+  #if !defined(SPDR)
+    USISR = _BV(USIOIF); // clears the flag, and the counter, which has just wrapped to 0 anyway
+  #endif
+  SPISlave._cur_is_fill = SPISlave._next_is_fill;
+  SPISlave._rx_buffer.push(in);
+  SPISlave._prefetch();
+}
+
+ISR(SPISLAVE_CS_VECT) {
+  bool selected = !(*SPISlave._cs_port & SPISlave._cs_mask);
+  if (selected == SPISlave._selected) {
+    return; // some other pin on the port
+  }
+  SPISlave._selected = selected;
+  #if defined(SPDR)
+    if (selected) {
+      *SPISlave._miso_ddr |= SPISlave._miso_mask;
+    } else {
+      *SPISlave._miso_ddr &= ~SPISlave._miso_mask;
+    }
+  #else
+    if (selected) {
+      USISR = _BV(USIOIF); // start counting from the first edge, whatever a short byte last time left behind
+      USICR = SPISlave._usicr;
+      USI_DDR |= _BV(USI_DO_BIT);
+    } else {
+      USICR = 0;
+      USI_DDR &= ~_BV(USI_DO_BIT);
+    }
+  #endif
+  if (!selected) {
+    SPISlave._reprime();
+  }
+  if (SPISlave._onSelect) {
+    SPISlave._onSelect(selected);
+  }
+}
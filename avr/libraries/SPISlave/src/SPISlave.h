@@ -0,0 +1,114 @@
+/* SPISlave.h - interrupt driven SPI slave on hardware SPI or the USI
+ * Part of ATTinyCore - github.com/SpenceKonde/ATTinyCore
+ *   Free Software - LGPL 2.1, please see LICENCE.md for details
+ *
+ * For using a tiny as an SPI peripheral. Bytes from the master go into an RX
+ * ring that the sketch reads like Serial; the sketch preloads what it wants to
+ * send into a TX ring, and each byte the master clocks in clocks the next one
+ * out of it - or the fill byte, if there's nothing queued.
+ *
+ * Chip select is SS, as defined by the variant. On hardware SPI the SPI module
+ * looks after it itself, except for the direction of MISO; the USI knows
+ * nothing about chip select. So we do the rest in the pin change interrupt:
+ * MISO (or DO) is only an output, and the USI only gets a clock, while SS is
+ * low. Either way, the same pin change interrupt calls the
+ * onSelect() callback, if there is one, on both edges.
+ *
+ * The byte after the one being shifted is always fetched ahead of time, so the
+ * first thing the transfer complete ISR does is swap it for the one that came
+ * in; putting that in the RX ring and fetching the one after it come after.
+ * Within a byte, SCK can be as fast as the hardware allows a slave, F_CPU/4.
+ * Between bytes, the master has to give the ISR time to load the next byte
+ * (like any AVR SPI slave - on the USI, nothing stops the next byte from
+ * starting with the old one still in the shift register), and on average the
+ * whole ISR has to fit in a byte, or the RX ring will fill up. A few us of gap
+ * at 8 MHz is plenty.
+ *
+ * This library owns the SPI or USI overflow interrupt, and the pin change
+ * interrupt for the port SS is on, so it can't be used together with Wire's
+ * USI slave or SoftwareSerial (on the same port). Not available on the tiny26,
+ * which has no pin change interrupt for just SS.
+ *---------------------------------------------------------------------------*/
+
+#ifndef SPISlave_h
+#define SPISlave_h
+
+#include <Arduino.h>
+#include <SPI.h>
+#include "RingBuffer.h"
+
+#if defined(__AVR_ATtiny26__)
+  #error "SPISlave needs a pin change interrupt for SS, which the ATtiny26 does not have"
+#endif
+
+/* Sizes must be powers of two, 2 to 256, and hold one less than their size */
+#ifndef SPISLAVE_RX_BUFFER_SIZE
+  #if (RAMEND < 1000)
+    #define SPISLAVE_RX_BUFFER_SIZE 16
+  #else
+    #define SPISLAVE_RX_BUFFER_SIZE 32
+  #endif
+#endif
+#ifndef SPISLAVE_TX_BUFFER_SIZE
+  #define SPISLAVE_TX_BUFFER_SIZE SPISLAVE_RX_BUFFER_SIZE
+#endif
+
+class SPISlaveClass : public Stream
+{
+  public:
+    void begin(uint8_t dataMode = SPI_MODE0, uint8_t bitOrder = MSBFIRST);
+    void end();
+    // The byte sent when nothing is queued - 0xFF unless set otherwise
+    void setFill(uint8_t fill) { _fill = fill; }
+    // Called from the pin change ISR whenever SS changes, with true when it has gone low
+    void onSelect(void (*callback)(bool selected)) { _onSelect = callback; }
+    bool selected() { return _selected; }
+
+    virtual int available(void);
+    virtual int peek(void);
+    virtual int read(void);
+    // Waits until everything queued has left the TX buffer - the last two bytes may still be waiting for the master
+    virtual void flush(void);
+    // Never waits: if the TX buffer is full, the byte is dropped, and 0 returned
+    virtual size_t write(uint8_t);
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    virtual int availableForWrite(void);
+    using Print::write; // pull in write(str) from Print
+
+    // Public only so that the ISRs can get at them.
+    RingBuffer<SPISLAVE_RX_BUFFER_SIZE> _rx_buffer;
+    RingBuffer<SPISLAVE_TX_BUFFER_SIZE> _tx_buffer;
+    volatile uint8_t _next;         // the byte after the one in the shift register, already bit reversed if need be
+    volatile bool _next_is_fill;    // _next didn't come from the TX buffer
+    volatile bool _cur_is_fill;     // nor did the one in the shift register
+    volatile bool _selected;
+    volatile uint8_t *_cs_port;     // PINx of SS
+    uint8_t _cs_mask;
+    uint8_t _fill = 0xFF;
+    void (*_onSelect)(bool) = NULL;
+    #if defined(SPDR)
+      volatile uint8_t *_miso_ddr;  // DDRx of MISO, which only drives the bus while selected
+      uint8_t _miso_mask;
+    #else
+      uint8_t _usicr;               // USICR while selected
+      bool _lsb1st;                 // the USI can't, so we reverse each byte
+    #endif
+    inline __attribute__((always_inline)) void _prefetch() {
+      uint8_t c;
+      if (_tx_buffer.pop(c)) {
+        #if !defined(SPDR)
+          if (_lsb1st) c = USI_impl::reverse(c);
+        #endif
+        _next = c;
+        _next_is_fill = false;
+      } else {
+        _next = _fill;
+        _next_is_fill = true;
+      }
+    }
+    void _reprime();
+};
+
+extern SPISlaveClass SPISlave;
+
+#endif
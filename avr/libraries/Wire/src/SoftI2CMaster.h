@@ -37,6 +37,8 @@
  * - I2C_CPUFREQ, when changing CPU clock frequency dynamically
  * - I2C_FASTMODE = 1 meaning that the I2C bus allows speeds up to 400 kHz
  * - I2C_SLOWMODE = 1 meaning that the I2C bus will allow only up to 25 kHz
+ * - I2C_FREQ = the SCL frequency in Hz, up to 1000000; this overrides the two above
+ * - I2C_RUNTIME_CLOCK = 1 to be able to slow the bus down with i2c_set_clock()
  * - I2C_NOINTERRUPT = 1 in order to prohibit interrupts while
  *   communicating (see below). This can be useful if you use the library
  *   for communicating with SMbus devices, which have timeouts.
@@ -47,6 +49,9 @@
  */
 
 /* Changelog:
+ * ATTinyCore:
+ * - SCL timing is generated to the cycle for any I2C_FREQ, including Fm+;
+ *   I2C_ACTUAL_FREQ says what that came out as
  * Version 1.3:
  * - added "__attribute__ ((used))" for all functions declared with "__attribute__ ((noinline))"
  *   Now the module is also usable in Arduino 1.6.11+
@@ -156,21 +161,128 @@ uint8_t __attribute__ ((noinline)) i2c_read(bool last) __attribute__ ((used));
 #endif
 #endif
 
-#if I2C_FASTMODE
-#define I2C_DELAY_COUNTER (((I2C_CPUFREQ/350000L)/2-18)/3)
-#else
-#if I2C_SLOWMODE
-#define I2C_DELAY_COUNTER (((I2C_CPUFREQ/23500L)/2-18)/3)
+// I2C_FREQ is the SCL frequency, in Hz, to generate. It defaults to 400kHz,
+// 100kHz or 25kHz according to I2C_FASTMODE and I2C_SLOWMODE, and anything up
+// to 1MHz (Fast-mode Plus) can be asked for. The delays are worked out here to
+// the cycle, so the clock never runs faster than asked and SCL is never low or
+// high for less than the I2C spec allows for that speed; if the CPU is too slow
+// to get there, it runs as fast as it can. I2C_ACTUAL_FREQ is what you get.
+#ifndef I2C_FREQ
+  #if I2C_FASTMODE
+    #define I2C_FREQ 400000UL
+  #elif I2C_SLOWMODE
+    #define I2C_FREQ 25000UL
+  #else
+    #define I2C_FREQ 100000UL
+  #endif
+#endif
+
+// Minimum SCL low and high times, and the longest rise time, for the bus mode
+// that I2C_FREQ falls in, in ns. After letting go of SCL we allow it up to
+// I2C_RISE_NS to get up before checking whether a slave is stretching the clock;
+// with stiff pullups on a short bus, a smaller value here buys a faster clock.
+#if I2C_FREQ > 400000UL
+  #define I2C_TLOW_NS   500
+  #define I2C_THIGH_NS  260
+  #ifndef I2C_RISE_NS
+    #define I2C_RISE_NS 120
+  #endif
+#elif I2C_FREQ > 100000UL
+  #define I2C_TLOW_NS  1300
+  #define I2C_THIGH_NS  600
+  #ifndef I2C_RISE_NS
+    #define I2C_RISE_NS 300
+  #endif
 #else
-#define I2C_DELAY_COUNTER (((I2C_CPUFREQ/90000L)/2-18)/3)
+  #define I2C_TLOW_NS  4700
+  #define I2C_THIGH_NS 4000
+  #ifndef I2C_RISE_NS
+    #define I2C_RISE_NS 1000
+  #endif
+#endif
+
+// If I2C_RUNTIME_CLOCK is 1, i2c_set_clock() can slow the bus down from
+// I2C_FREQ at runtime, in steps of 6 cycles per bit. That costs 4 cycles in
+// each half of every bit, which come out of the delays below.
+#ifndef I2C_RUNTIME_CLOCK
+#define I2C_RUNTIME_CLOCK 0
+#endif
+#define I2C_EXTRA_CYCLES (I2C_RUNTIME_CLOCK ? 4 : 0)
+
+#define I2C_NS_CYCLES(ns) ((((ns) * (I2C_CPUFREQ / 1000UL)) + 999999UL) / 1000000UL)
+#define I2C_RISE_CYCLES   I2C_NS_CYCLES(I2C_RISE_NS)
+#define I2C_PERIOD_CYCLES ((I2C_CPUFREQ + I2C_FREQ - 1) / I2C_FREQ)
+
+// Every bit below spends at most 8 cycles of its low half and 12 of its high
+// half (plus the rise allowance) doing something other than waiting, which is
+// as fast as it can go. Each half is then the longer of that and the spec
+// minimum; whatever the period has left over goes first to the shorter half and
+// then evenly to both.
+#define I2C_MIN_LOW       (I2C_NS_CYCLES(I2C_TLOW_NS) > 8 + I2C_EXTRA_CYCLES ? I2C_NS_CYCLES(I2C_TLOW_NS) : 8 + I2C_EXTRA_CYCLES)
+#define I2C_MIN_HIGH      (I2C_NS_CYCLES(I2C_THIGH_NS) > 12 + I2C_EXTRA_CYCLES + I2C_RISE_CYCLES ? I2C_NS_CYCLES(I2C_THIGH_NS) : 12 + I2C_EXTRA_CYCLES + I2C_RISE_CYCLES)
+#define I2C_SPARE         (I2C_PERIOD_CYCLES > I2C_MIN_LOW + I2C_MIN_HIGH ? I2C_PERIOD_CYCLES - I2C_MIN_LOW - I2C_MIN_HIGH : 0)
+#define I2C_GAP           (I2C_MIN_LOW > I2C_MIN_HIGH ? I2C_MIN_LOW - I2C_MIN_HIGH : I2C_MIN_HIGH - I2C_MIN_LOW)
+#define I2C_EVEN_UP       (I2C_SPARE < I2C_GAP ? I2C_SPARE : I2C_GAP)
+#define I2C_SPLIT         (I2C_SPARE - I2C_EVEN_UP)
+#define I2C_T_LOW         (I2C_MIN_LOW + (I2C_MIN_LOW < I2C_MIN_HIGH ? I2C_EVEN_UP : 0) + (I2C_SPLIT + 1) / 2)
+#define I2C_T_HIGH        (I2C_MIN_HIGH + (I2C_MIN_LOW < I2C_MIN_HIGH ? 0 : I2C_EVEN_UP) + I2C_SPLIT / 2)
+#define I2C_ACTUAL_FREQ   (I2C_CPUFREQ / (I2C_T_LOW + I2C_T_HIGH))
+
+#if I2C_T_LOW + I2C_T_HIGH > 250000
+#error "I2C_FREQ is too low for this clock speed"
 #endif
+
+// What's left of each half of a bit to burn, given how many cycles of it the
+// code at that point spends on other things.
+#define I2C_LOW_DELAY(busy)  (I2C_T_LOW - (busy) - I2C_EXTRA_CYCLES)
+#define I2C_HIGH_DELAY(busy) (I2C_T_HIGH - (busy) - I2C_EXTRA_CYCLES - I2C_RISE_CYCLES)
+
+// Burns exactly the number of cycles in the given operand: a 16-bit loop of 4
+// cycles, an 8-bit loop of 3, or just nops, with nops to make up the remainder.
+// Uses r25, r26 and r27.
+#define I2C_DELAY(cycles) \
+  " .if " cycles " >= 768 \n\t" \
+  " ldi r26, lo8((" cycles " - 1) / 4) \n\t" \
+  " ldi r27, hi8((" cycles " - 1) / 4) \n\t" \
+  "1: sbiw r26, 1 \n\t" \
+  " brne 1b \n\t" \
+  " .rept (" cycles " - 1) - ((" cycles " - 1) / 4) * 4 \n\t" \
+  " nop \n\t" \
+  " .endr \n\t" \
+  " .elseif " cycles " >= 3 \n\t" \
+  " ldi r25, " cycles " / 3 \n\t" \
+  "1: dec r25 \n\t" \
+  " brne 1b \n\t" \
+  " .rept " cycles " - (" cycles " / 3) * 3 \n\t" \
+  " nop \n\t" \
+  " .endr \n\t" \
+  " .else \n\t" \
+  " .rept " cycles " \n\t" \
+  " nop \n\t" \
+  " .endr \n\t" \
+  " .endif \n\t"
+
+// The runtime part: 4 + 3 * i2c_delay_extra cycles. Uses r25.
+#if I2C_RUNTIME_CLOCK
+uint8_t i2c_delay_extra;
+#define I2C_DELAY_EXTRA \
+  " lds r25, %[EXTRA] \n\t" \
+  "1: subi r25, 1 \n\t" \
+  " brcc 1b \n\t"
+#define I2C_EXTRA_OPERAND , [EXTRA] "i" (&i2c_delay_extra)
+#else
+#define I2C_DELAY_EXTRA
+#define I2C_EXTRA_OPERAND
 #endif
 
-// Table of I2C bus speed in kbit/sec:
+// Bus speed in kHz for some common clocks, from the above:
 // CPU clock:           1MHz   2MHz    4MHz   8MHz   16MHz   20MHz
-// Fast I2C mode          40     80     150    300     400     400
-// Standard I2C mode      40     80     100    100     100     100
+// Fm+ I2C mode (1MHz)    47     95     190    380     727     800
+// Fast I2C mode          47     95     181    307     400     400
+// Standard I2C mode      47     83     100    100     100     100
 // Slow I2C mode          25     25      25     25      25      25
+// A bit can't take less than 8 cycles low and 12 high plus the rise allowance, so
+// Fm+ doesn't quite reach 1MHz at 20MHz: it gets 800kHz, or 909kHz with I2C_RISE_NS 0.
 
 // constants for reading & writing
 #define I2C_READ    1
@@ -190,25 +302,30 @@ uint8_t __attribute__ ((noinline)) i2c_read(bool last) __attribute__ ((used));
 
 
 // Internal delay functions.
-void __attribute__ ((noinline)) i2c_delay_half(void) asm("ass_i2c_delay_half")  __attribute__ ((used));
+void __attribute__ ((noinline)) i2c_delay_low(void) asm("ass_i2c_delay_low")  __attribute__ ((used));
+void __attribute__ ((noinline)) i2c_delay_high(void) asm("ass_i2c_delay_high")  __attribute__ ((used));
 void __attribute__ ((noinline)) i2c_wait_scl_high(void) asm("ass_i2c_wait_scl_high")  __attribute__ ((used));
 
-void  i2c_delay_half(void)
-{ // function call 3 cycles => 3C
-#if I2C_DELAY_COUNTER < 1
-  __asm__ __volatile__ (" ret");
-  // 7 cycles for call and return
-#else
+// Start and stop conditions are built out of these: each takes as long as the low
+// (or high) half of a bit, counting the call and return (7 cycles).
+void  i2c_delay_low(void)
+{
   __asm__ __volatile__
     (
-     " ldi      r25, %[DELAY]           ; load delay constant   ; 4C \n\t"
-     "_Lidelay: \n\t"
-     " dec r25                          ; decrement counter     ; 4C + xC \n\t"
-     " brne _Lidelay                                           ; 5C+(x-1)2C + xC\n\t"
-     " ret                                                     ; 9C+(x-1)2C + xC = 7C + xC"
-     : : [DELAY] "M" I2C_DELAY_COUNTER : "r25");
-  // 7 cycles + 3 times x cycles
-#endif
+     I2C_DELAY("%[DELAY]")
+     I2C_DELAY_EXTRA
+     " ret"
+     : : [DELAY] "n" (I2C_T_LOW - 7 - I2C_EXTRA_CYCLES) I2C_EXTRA_OPERAND : "r25", "r26", "r27");
+}
+
+void  i2c_delay_high(void)
+{
+  __asm__ __volatile__
+    (
+     I2C_DELAY("%[DELAY]")
+     I2C_DELAY_EXTRA
+     " ret"
+     : : [DELAY] "n" (I2C_T_HIGH - 7 - I2C_EXTRA_CYCLES) I2C_EXTRA_OPERAND : "r25", "r26", "r27");
 }
 
 void i2c_wait_scl_high(void) {
@@ -288,7 +405,7 @@ bool  i2c_start(uint8_t addr) {
      " sbis     %[SCLIN],%[SCLPIN]      ; check for clock stretching slave\n\t"
      " rcall    ass_i2c_wait_scl_high   ; wait until SCL = H\n\t"
      " sbi      %[SDADDR],%[SDAPIN]     ; force SDA low  \n\t"
-     " rcall    ass_i2c_delay_half      ; wait T/2 \n\t"
+     " rcall    ass_i2c_delay_high      ; start hold time \n\t"
      " rcall    ass_i2c_write           ; now write address \n\t"
      " ret"
      : : [SDADDR] "I"  (SDA_DDR), [SDAPIN] "I" (SDA_PIN),
@@ -304,15 +421,14 @@ bool  i2c_rep_start(uint8_t addr) {
      " cli \n\t"
 #endif
      " sbi  %[SCLDDR],%[SCLPIN] ; force SCL low \n\t"
-     " rcall  ass_i2c_delay_half  ; delay  T/2 \n\t"
      " cbi  %[SDADDR],%[SDAPIN] ; release SDA \n\t"
-     " rcall  ass_i2c_delay_half  ; delay T/2 \n\t"
+     " rcall  ass_i2c_delay_low   ; SCL low time \n\t"
      " cbi  %[SCLDDR],%[SCLPIN] ; release SCL \n\t"
-     " rcall  ass_i2c_delay_half  ; delay  T/2 \n\t"
+     " rcall  ass_i2c_delay_low   ; repeated start setup time \n\t"
      " sbis     %[SCLIN],%[SCLPIN]      ; check for clock stretching slave\n\t"
      " rcall    ass_i2c_wait_scl_high   ; wait until SCL = H\n\t"
      " sbi  %[SDADDR],%[SDAPIN] ; force SDA low \n\t"
-     " rcall  ass_i2c_delay_half  ; delay  T/2 \n\t"
+     " rcall  ass_i2c_delay_high  ; start hold time \n\t"
      " rcall    ass_i2c_write       \n\t"
      " ret"
      : : [SCLDDR] "I"  (SCL_DDR), [SCLPIN] "I" (SCL_PIN),[SCLIN] "I" (SCL_IN),
@@ -333,7 +449,7 @@ void  i2c_start_wait(uint8_t addr) {
     " sbis     %[SCLIN],%[SCLPIN]      ; check for clock stretching slave\n\t"
     " rcall    ass_i2c_wait_scl_high   ; wait until SCL = H\n\t"
     " sbi   %[SDADDR],%[SDAPIN] ; force SDA low \n\t"
-    " rcall   ass_i2c_delay_half  ; delay T/2 \n\t"
+    " rcall   ass_i2c_delay_high  ; start hold time \n\t"
     " rcall   ass_i2c_write         ; write address \n\t"
     " tst r24           ; if device not busy -> done \n\t"
     " brne  _Li2c_start_wait_done \n\t"
@@ -351,13 +467,13 @@ void  i2c_stop(void) {
     (
      " sbi      %[SCLDDR],%[SCLPIN]     ; force SCL low \n\t"
      " sbi      %[SDADDR],%[SDAPIN]     ; force SDA low \n\t"
-     " rcall    ass_i2c_delay_half      ; T/2 delay \n\t"
+     " rcall    ass_i2c_delay_low       ; SCL low time \n\t"
      " cbi      %[SCLDDR],%[SCLPIN]     ; release SCL \n\t"
-     " rcall    ass_i2c_delay_half      ; T/2 delay \n\t"
+     " rcall    ass_i2c_delay_high      ; stop setup time \n\t"
      " sbis     %[SCLIN],%[SCLPIN]      ; check for clock stretching slave\n\t"
      " rcall    ass_i2c_wait_scl_high   ; wait until SCL = H\n\t"
      " cbi      %[SDADDR],%[SDAPIN]     ; release SDA \n\t"
-     " rcall    ass_i2c_delay_half \n\t"
+     " rcall    ass_i2c_delay_low       ; bus free time \n\t"
 #if I2C_NOINTERRUPT
      " sei                              ; enable interrupts again!\n\t"
 #endif
@@ -365,6 +481,12 @@ void  i2c_stop(void) {
          [SDADDR] "I"  (SDA_DDR), [SDAPIN] "I" (SDA_PIN));
 }
 
+// The two bit loops below are where the time goes, so every path through them
+// is counted, and the delay operands are whatever is left of I2C_T_LOW and
+// I2C_T_HIGH, counting from the end of the sbi/cbi on SCLDDR that starts each
+// half. All the paths through a half take the same time (hence the odd nop),
+// so that as long as no slave stretches the clock every bit - the ACK included -
+// is exactly I2C_T_LOW low and I2C_T_HIGH high.
 bool i2c_write(uint8_t value) {
   __asm__ __volatile__
     (
@@ -372,72 +494,62 @@ bool i2c_write(uint8_t value) {
      " rol      r24                     ; shift in carry and shift out MSB \n\t"
      " rjmp _Li2c_write_first \n\t"
      "_Li2c_write_bit:\n\t"
-     " lsl      r24                     ; left shift into carry ; 1C\n\t"
+     " lsl      r24                     ; left shift into carry ; high 8C \n\t"
      "_Li2c_write_first:\n\t"
-     " breq     _Li2c_get_ack           ; jump if TXreg is empty; +1 = 2C \n\t"
-     " sbi      %[SCLDDR],%[SCLPIN]     ; force SCL low         ; +2 = 4C \n\t"
-     " nop \n\t"
-     " nop \n\t"
-     " nop \n\t"
-     " brcc     _Li2c_write_low                                ; +1/+2 = 5/6C\n\t"
-     " nop                                                     ; +1 = 7C \n\t"
-     " cbi %[SDADDR],%[SDAPIN]          ; release SDA           ; +2 = 9C \n\t"
-     " rjmp      _Li2c_write_high                              ; +2 = 11C \n\t"
+     " breq     _Li2c_get_ack           ; jump if TXreg is empty; high 9C/10C \n\t"
+     " nop                                                     ; high 10C \n\t"
+     " sbi      %[SCLDDR],%[SCLPIN]     ; force SCL low         ; high 12C \n\t"
+     " brcc     _Li2c_write_low                                ; low 1C/2C \n\t"
+     " nop                                                     ; low 2C \n\t"
+     " cbi %[SDADDR],%[SDAPIN]          ; release SDA           ; low 4C \n\t"
+     " rjmp      _Li2c_write_high                              ; low 6C \n\t"
      "_Li2c_write_low: \n\t"
-     " sbi  %[SDADDR],%[SDAPIN] ; force SDA low         ; +2 = 9C \n\t"
-     " rjmp _Li2c_write_high                               ; +2 = 11C \n\t"
+     " sbi  %[SDADDR],%[SDAPIN] ; force SDA low         ; low 4C \n\t"
+     " rjmp _Li2c_write_high                               ; low 6C \n\t"
      "_Li2c_write_high: \n\t"
-#if I2C_DELAY_COUNTER >= 1
-     " rcall  ass_i2c_delay_half  ; delay T/2             ; +X = 11C + X\n\t"
-#endif
-     " cbi  %[SCLDDR],%[SCLPIN] ; release SCL           ; +2 = 13C + X\n\t"
-     " cln                              ; clear N-bit           ; +1 = 14C + X\n\t"
-     " nop \n\t"
-     " nop \n\t"
-     " nop \n\t"
-     " sbis %[SCLIN],%[SCLPIN]  ; check for SCL high    ; +2 = 16C + X\n\t"
+     I2C_DELAY("%[WL]")
+     I2C_DELAY_EXTRA
+     " cbi  %[SCLDDR],%[SCLPIN] ; release SCL           ; low 8C \n\t"
+     I2C_DELAY("%[RISE]")
+     " cln                              ; clear N-bit           ; high 1C \n\t"
+     " sbis %[SCLIN],%[SCLPIN]  ; check for SCL high    ; high 3C \n\t"
      " rcall    ass_i2c_wait_scl_high \n\t"
-     " brpl     _Ldelay_scl_high                              ; +2 = 18C + X\n\t"
+     " brpl     _Ldelay_scl_high                              ; high 5C \n\t"
      "_Li2c_write_return_false: \n\t"
      " clr      r24                     ; return false because of timeout \n\t"
      " rjmp     _Li2c_write_return \n\t"
      "_Ldelay_scl_high: \n\t"
-#if I2C_DELAY_COUNTER >= 1
-     " rcall  ass_i2c_delay_half  ; delay T/2             ; +X= 18C + 2X\n\t"
-#endif
-     " rjmp _Li2c_write_bit \n\t"
-     "              ; +2 = 20C +2X for one bit-loop \n\t"
+     I2C_DELAY("%[WH]")
+     I2C_DELAY_EXTRA
+     " rjmp _Li2c_write_bit                                    ; high 7C \n\t"
      "_Li2c_get_ack: \n\t"
-     " sbi  %[SCLDDR],%[SCLPIN] ; force SCL low ; +2 = 5C \n\t"
-     " nop \n\t"
-     " nop \n\t"
-     " cbi  %[SDADDR],%[SDAPIN] ; release SDA ; +2 = 7C \n\t"
-#if I2C_DELAY_COUNTER >= 1
-     " rcall  ass_i2c_delay_half  ; delay T/2 ; +X = 7C + X \n\t"
-#endif
-     " clr  r25                                            ; 17C + 2X \n\t"
-     " clr  r24           ; return 0              ; 14C + X \n\t"
-     " cbi  %[SCLDDR],%[SCLPIN] ; release SCL ; +2 = 9C + X\n\t"
-     "_Li2c_ack_wait: \n\t"
-     " cln                              ; clear N-bit          ; 10C + X\n\t"
-     " nop \n\t"
-     " sbis %[SCLIN],%[SCLPIN]  ; wait SCL high         ; 12C + X \n\t"
+     " sbi  %[SCLDDR],%[SCLPIN] ; force SCL low         ; high 12C \n\t"
+     " cbi  %[SDADDR],%[SDAPIN] ; release SDA           ; low 2C \n\t"
+     " clr  r24           ; return 0              ; low 3C \n\t"
+     I2C_DELAY("%[KL]")
+     I2C_DELAY_EXTRA
+     " cbi  %[SCLDDR],%[SCLPIN] ; release SCL           ; low 5C \n\t"
+     I2C_DELAY("%[RISE]")
+     " cln                              ; clear N-bit           ; high 1C \n\t"
+     " sbis %[SCLIN],%[SCLPIN]  ; wait SCL high         ; high 3C \n\t"
      " rcall    ass_i2c_wait_scl_high \n\t"
-     " brmi     _Li2c_write_return_false                       ; 13C + X \n\t "
-     " sbis %[SDAIN],%[SDAPIN]      ; if SDA hi -> return 0 ; 15C + X \n\t"
-     " ldi  r24,1                   ; return true           ; 16C + X \n\t"
-#if I2C_DELAY_COUNTER >= 1
-     " rcall  ass_i2c_delay_half  ; delay T/2             ; 16C + 2X \n\t"
-#endif
+     " brmi     _Li2c_write_return_false                       ; high 4C \n\t "
+     " sbis %[SDAIN],%[SDAPIN]      ; if SDA hi -> return 0 ; \n\t"
+     " ldi  r24,1                   ; return true           ; high 6C \n\t"
+     I2C_DELAY("%[KH]")
+     I2C_DELAY_EXTRA
      "_Li2c_write_return: \n\t"
-     " nop \n\t "
-     " nop \n\t "
-     " sbi  %[SCLDDR],%[SCLPIN] ; force SCL low so SCL = H is short\n\t"
-     " ret \n\t"
-     "              ; + 4 = 17C + 2X for acknowldge bit"
+     " sbi  %[SCLDDR],%[SCLPIN] ; force SCL low so SCL = H is short ; high 8C \n\t"
+     " clr  r25 \n\t"
+     " ret"
      ::
       [SCLDDR] "I"  (SCL_DDR), [SCLPIN] "I" (SCL_PIN), [SCLIN] "I" (SCL_IN),
-      [SDADDR] "I"  (SDA_DDR), [SDAPIN] "I" (SDA_PIN), [SDAIN] "I" (SDA_IN));
+      [SDADDR] "I"  (SDA_DDR), [SDAPIN] "I" (SDA_PIN), [SDAIN] "I" (SDA_IN),
+      [RISE] "n" (I2C_RISE_CYCLES),
+      [WL] "n" (I2C_LOW_DELAY(8)), [WH] "n" (I2C_HIGH_DELAY(12)),
+      [KL] "n" (I2C_LOW_DELAY(5)), [KH] "n" (I2C_HIGH_DELAY(8))
+      I2C_EXTRA_OPERAND
+     : "r25", "r26", "r27");
   return true; // fooling the compiler
 }
 
@@ -446,70 +558,77 @@ uint8_t i2c_read(bool last) {
     (
      " ldi  r23,0x01 \n\t"
      "_Li2c_read_bit: \n\t"
-     " sbi  %[SCLDDR],%[SCLPIN] ; force SCL low         ; 2C \n\t"
-     " cbi  %[SDADDR],%[SDAPIN] ; release SDA(prev. ACK); 4C \n\t"
-     " nop \n\t"
-     " nop \n\t"
-     " nop \n\t"
-#if I2C_DELAY_COUNTER >= 1
-     " rcall  ass_i2c_delay_half  ; delay T/2             ; 4C + X \n\t"
-#endif
-     " cbi  %[SCLDDR],%[SCLPIN] ; release SCL           ; 6C + X \n\t"
-#if I2C_DELAY_COUNTER >= 1
-     " rcall  ass_i2c_delay_half  ; delay T/2             ; 6C + 2X \n\t"
-#endif
-     " cln                              ; clear N-bit          ; 7C + 2X \n\t"
-     " nop \n\t "
-     " nop \n\t "
-     " nop \n\t "
-     " sbis     %[SCLIN], %[SCLPIN]     ; check for SCL high    ; 9C +2X \n\t"
+     " sbi  %[SCLDDR],%[SCLPIN] ; force SCL low         ; high 12C \n\t"
+     " cbi  %[SDADDR],%[SDAPIN] ; release SDA(prev. ACK); low 2C \n\t"
+     I2C_DELAY("%[RL]")
+     I2C_DELAY_EXTRA
+     " cbi  %[SCLDDR],%[SCLPIN] ; release SCL           ; low 4C \n\t"
+     I2C_DELAY("%[RISE]")
+     " cln                              ; clear N-bit          ; high 1C \n\t"
+     " sbis     %[SCLIN], %[SCLPIN]     ; check for SCL high    ; high 3C \n\t"
      " rcall    ass_i2c_wait_scl_high \n\t"
-     " brmi     _Li2c_read_return       ; return if timeout     ; 10C + 2X\n\t"
-     " clc                ; clear carry flag      ; 11C + 2X\n\t"
-     " sbic %[SDAIN],%[SDAPIN]  ; if SDA is high        ; 11C + 2X\n\t"
-     " sec              ; set carry flag        ; 12C + 2X\n\t"
-     " rol  r23           ; store bit             ; 13C + 2X\n\t"
-     " brcc _Li2c_read_bit          ; while receiv reg not full \n\t"
-     "                         ; 15C + 2X for one bit loop \n\t"
+     " brmi     _Li2c_read_return       ; return if timeout     ; high 4C \n\t"
+     I2C_DELAY("%[RH]")
+     I2C_DELAY_EXTRA
+     " clc                ; clear carry flag      ; high 5C \n\t"
+     " sbic %[SDAIN],%[SDAPIN]  ; if SDA is high        ; \n\t"
+     " sec              ; set carry flag        ; high 7C \n\t"
+     " rol  r23           ; store bit             ; high 8C \n\t"
+     " brcc _Li2c_read_bit          ; while receiv reg not full ; high 10C \n\t"
+     " nop                                                     ; high 10C \n\t"
 
      "_Li2c_put_ack: \n\t"
-     " sbi  %[SCLDDR],%[SCLPIN] ; force SCL low         ; 2C \n\t"
-     " cpi  r24,0                                          ; 3C \n\t"
-     " breq _Li2c_put_ack_low ; if (ack = 0) ; 5C \n\t"
-     " cbi  %[SDADDR],%[SDAPIN] ; release SDA \n\t"
-     " rjmp _Li2c_put_ack_high \n\t"
+     " sbi  %[SCLDDR],%[SCLPIN] ; force SCL low         ; high 12C \n\t"
+     " cpi  r24,0                                          ; low 1C \n\t"
+     " breq _Li2c_put_ack_low ; if (ack = 0) ; low 2C/3C \n\t"
+     " cbi  %[SDADDR],%[SDAPIN] ; release SDA           ; low 4C \n\t"
+     " rjmp _Li2c_put_ack_high                             ; low 6C \n\t"
      "_Li2c_put_ack_low:                ; else \n\t"
-     " sbi  %[SDADDR],%[SDAPIN] ; force SDA low         ; 7C \n\t"
+     " nop                                                 ; low 4C \n\t"
+     " sbi  %[SDADDR],%[SDAPIN] ; force SDA low         ; low 6C \n\t"
      "_Li2c_put_ack_high: \n\t"
-     " nop \n\t "
-     " nop \n\t "
-     " nop \n\t "
-#if I2C_DELAY_COUNTER >= 1
-     " rcall  ass_i2c_delay_half  ; delay T/2             ; 7C + X \n\t"
-#endif
-     " cbi  %[SCLDDR],%[SCLPIN] ; release SCL           ; 9C +X \n\t"
-     " cln                              ; clear N               ; +1 = 10C\n\t"
-     " nop \n\t "
-     " nop \n\t "
-     " sbis %[SCLIN],%[SCLPIN]  ; wait SCL high         ; 12C + X\n\t"
+     I2C_DELAY("%[AL]")
+     I2C_DELAY_EXTRA
+     " cbi  %[SCLDDR],%[SCLPIN] ; release SCL           ; low 8C \n\t"
+     I2C_DELAY("%[RISE]")
+     " cln                              ; clear N               ; high 1C \n\t"
+     " sbis %[SCLIN],%[SCLPIN]  ; wait SCL high         ; high 3C \n\t"
      " rcall    ass_i2c_wait_scl_high \n\t"
-#if I2C_DELAY_COUNTER >= 1
-     " rcall  ass_i2c_delay_half  ; delay T/2             ; 11C + 2X\n\t"
-#endif
+     I2C_DELAY("%[AH]")
+     I2C_DELAY_EXTRA
      "_Li2c_read_return: \n\t"
-     " nop \n\t "
-     " nop \n\t "
-     "sbi %[SCLDDR],%[SCLPIN] ; force SCL low so SCL = H is short\n\t"
-     " mov  r24,r23                                        ; 12C + 2X \n\t"
-     " clr  r25                                            ; 13 C + 2X\n\t"
-     " ret                                                     ; 17C + X"
+     "sbi %[SCLDDR],%[SCLPIN] ; force SCL low so SCL = H is short ; high 5C \n\t"
+     " mov  r24,r23 \n\t"
+     " clr  r25 \n\t"
+     " ret"
      ::
       [SCLDDR] "I"  (SCL_DDR), [SCLPIN] "I" (SCL_PIN), [SCLIN] "I" (SCL_IN),
-      [SDADDR] "I"  (SDA_DDR), [SDAPIN] "I" (SDA_PIN), [SDAIN] "I" (SDA_IN)
-     );
+      [SDADDR] "I"  (SDA_DDR), [SDAPIN] "I" (SDA_PIN), [SDAIN] "I" (SDA_IN),
+      [RISE] "n" (I2C_RISE_CYCLES),
+      [RL] "n" (I2C_LOW_DELAY(4)), [RH] "n" (I2C_HIGH_DELAY(12)),
+      [AL] "n" (I2C_LOW_DELAY(8)), [AH] "n" (I2C_HIGH_DELAY(5))
+      I2C_EXTRA_OPERAND
+     : "r25", "r26", "r27");
   return ' '; // fool the compiler!
 }
 
+#if I2C_RUNTIME_CLOCK
+// Slow the bus down to no faster than hz (it can't go faster than I2C_FREQ), and
+// return the SCL frequency it will now run at.
+uint32_t i2c_set_clock(uint32_t hz) {
+  uint32_t period = hz ? (I2C_CPUFREQ + hz - 1) / hz : 0xFFFFFFFFUL;
+  uint32_t extra = 0;
+  if (period > I2C_T_LOW + I2C_T_HIGH) {
+    extra = (period - (I2C_T_LOW + I2C_T_HIGH) + 5) / 6;
+    if (extra > 255) {
+      extra = 255;
+    }
+  }
+  i2c_delay_extra = extra;
+  return I2C_CPUFREQ / (I2C_T_LOW + I2C_T_HIGH + 6 * extra);
+}
+#endif
+
 
 #pragma GCC diagnostic pop
 
@@ -20,11 +20,20 @@
 #ifndef _SoftWire_h
 #define _SoftWire_h
 
+// Built for the fastest clock setClock() can ask for; begin() slows it to 100kHz.
+#ifndef I2C_FREQ
+  #define I2C_FREQ 400000UL
+#endif
+#define I2C_RUNTIME_CLOCK 1
 #include <SoftI2CMaster.h>
 #include <inttypes.h>
 #include "Stream.h"
 
-#define BUFFER_LENGTH 32
+#ifdef WIRE_BUFFER_SIZE
+  #define BUFFER_LENGTH WIRE_BUFFER_SIZE
+#else
+  #define BUFFER_LENGTH 32
+#endif
 
 // WIRE_HAS_END means Wire has end()
 #define WIRE_HAS_END 1
@@ -47,13 +56,16 @@ public:
     error = 0;
     transmitting = false;
 
+    i2c_set_clock(100000);
     i2c_init();
   }
 
   void end(void) {
   }
 
+  // runs as close to _clock as it can without going over, up to I2C_FREQ
   void setClock(uint32_t _clock) {
+    i2c_set_clock(_clock);
   }
 
   void beginTransmission(uint8_t address) {
@@ -139,6 +151,36 @@ public:
     return quantity;
   }
 
+  // read straight into dst, rather than rxBuffer; returns how many bytes were read
+  uint8_t readInto(uint8_t address, uint8_t *dst, uint8_t len, uint8_t sendStop) {
+    if (!(transmitting ? i2c_rep_start((address<<1) | I2C_READ) : i2c_start((address<<1) | I2C_READ))) {
+      i2c_stop();
+      transmitting = 0;
+      return 0;
+    }
+    for (uint8_t cnt = 0; cnt < len; cnt++)
+      dst[cnt] = i2c_read(cnt == len-1);
+    transmitting = !sendStop;
+    if (sendStop) {
+      i2c_stop();
+    }
+    return len;
+  }
+
+  // write straight from src; returns what endTransmission() would
+  uint8_t writeFrom(uint8_t address, const uint8_t *src, uint8_t len, uint8_t sendStop) {
+    beginTransmission(address);
+    if (error == 0) {
+      for (uint8_t cnt = 0; cnt < len; cnt++) {
+        if (!i2c_write(src[cnt])) {
+          error = 3;
+          break;
+        }
+      }
+    }
+    return endTransmission(sendStop || error);
+  }
+
   uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop) {
   return requestFrom((uint8_t)address, (uint8_t)quantity, (uint32_t)0, (uint8_t)0, (uint8_t)sendStop);
   }
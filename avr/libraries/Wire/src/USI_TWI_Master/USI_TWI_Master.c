@@ -37,6 +37,7 @@
 
 unsigned char USI_TWI_Master_Transfer(unsigned char);
 unsigned char USI_TWI_Master_Stop(void);
+static unsigned char USI_TWI_Master_Write_Byte(unsigned char, unsigned char, unsigned char);
 static unsigned char USI_TWI_MASTER_SPEED = 0;
 
 union USI_TWI_state {
@@ -110,6 +111,19 @@ unsigned char USI_TWI_Start_Transceiver_With_Data(unsigned char *msg, unsigned c
 ---------------------------------------------------------------*/
 
 unsigned char USI_TWI_Start_Transceiver_With_Data_Stop(unsigned char *msg, unsigned char msgSize, unsigned char stop) {
+  return USI_TWI_Start_Transfer(msg[0], msg + 1, msgSize ? msgSize - 1 : 0, stop);
+}
+
+/*---------------------------------------------------------------
+ USI Transmit and receive function, with the address byte (address
+ and R/W in the LSB) passed on its own, so that data is just the
+ data, read into or written from where the caller has it.
+
+ Function generates (Repeated) Start Condition, sends address and
+ R/W, Reads/Writes dataSize bytes of data, and verifies/sends ACK.
+---------------------------------------------------------------*/
+
+unsigned char USI_TWI_Start_Transfer(unsigned char slarw, unsigned char *data, unsigned char dataSize, unsigned char stop) {
   unsigned char tempUSISR_8bit = (1 << USISIF) | (1 << USIOIF) | (1 << USIPF) | (1 << USIDC) | (0x0 << USICNT0);
   // Prepare register value to: Clear flags set USI to shift 8 bits i.e. count 16 clock edges.
 
@@ -120,12 +134,12 @@ unsigned char USI_TWI_Start_Transceiver_With_Data_Stop(unsigned char *msg, unsig
   USI_TWI_state.addressMode = TRUE;
 
 #ifdef PARAM_VERIFICATION
-  if (msg > (unsigned char *)RAMEND) // Test if address is outside SRAM space
+  if (data > (unsigned char *)RAMEND) // Test if address is outside SRAM space
   {
     USI_TWI_state.errorState = USI_TWI_DATA_OUT_OF_BOUND;
     return (FALSE);
   }
-  if (msgSize <= 1) // Test if the transmission buffer is empty
+  if (dataSize == 0) // Test if the transmission buffer is empty
   {
     USI_TWI_state.errorState = USI_TWI_NO_DATA;
     return (FALSE);
@@ -147,7 +161,7 @@ unsigned char USI_TWI_Start_Transceiver_With_Data_Stop(unsigned char *msg, unsig
   }
 #endif
 
-  if (!(*msg & (1 << TWI_READ_BIT))) // The LSB in the address byte determines if is a masterRead or masterWrite operation.
+  if (!(slarw & (1 << TWI_READ_BIT))) // The LSB in the address byte determines if is a masterRead or masterWrite operation.
   {
     USI_TWI_state.masterWriteDataMode = TRUE;
   }
@@ -167,37 +181,33 @@ unsigned char USI_TWI_Start_Transceiver_With_Data_Stop(unsigned char *msg, unsig
   }
 #endif
 
-  /*Write address and Read/Write data */
-  do {
-    /* If masterWrite cycle (or initial address transmission)*/
-    if (USI_TWI_state.addressMode || USI_TWI_state.masterWriteDataMode) {
-                                                /* Write a byte */
-      USI_CLOCK_PORT &= ~(1 << USI_CLOCK_BIT);  // Pull SCL LOW.
-      USIDR = *(msg++);                         // Setup data.
-      USI_TWI_Master_Transfer(tempUSISR_8bit);  // Send 8 bits on bus.
-                                                /* Clock and verify (N)ACK from slave */
-      USI_DDR &= ~(1 << USI_DI_BIT);            // Enable SDA as input.
-      if (USI_TWI_Master_Transfer(tempUSISR_1bit) & (1 << TWI_NACK_BIT)) {
-        if (USI_TWI_state.addressMode) {
-          USI_TWI_state.errorState = USI_TWI_NO_ACK_ON_ADDRESS;
-        } else {
-          USI_TWI_state.errorState = USI_TWI_NO_ACK_ON_DATA;
-        }
+  /* Write address */
+  if (USI_TWI_Master_Write_Byte(slarw, tempUSISR_8bit, tempUSISR_1bit)) {
+    USI_TWI_state.errorState = USI_TWI_NO_ACK_ON_ADDRESS;
+    return (FALSE);
+  }
+  USI_TWI_state.addressMode = FALSE; // Only perform address transmission once.
+
+  /* Read/Write data */
+  for (; dataSize; dataSize--) {
+    /* If masterWrite cycle */
+    if (USI_TWI_state.masterWriteDataMode) {
+      if (USI_TWI_Master_Write_Byte(*(data++), tempUSISR_8bit, tempUSISR_1bit)) {
+        USI_TWI_state.errorState = USI_TWI_NO_ACK_ON_DATA;
         return (FALSE);
       }
-      USI_TWI_state.addressMode = FALSE; // Only perform address transmission once.
     } else {                /* Else masterRead cycle - Read a data byte */
       USI_DDR &= ~(1 << USI_DI_BIT);           // Enable SDA as input.
-      *(msg++) = USI_TWI_Master_Transfer(tempUSISR_8bit);
+      *(data++) = USI_TWI_Master_Transfer(tempUSISR_8bit);
                             /* Prepare to generate ACK (or NACK) */
-      if (msgSize == 1) {   // If transmission of last byte was performed.
+      if (dataSize == 1) {  // If transmission of last byte was performed.
         USIDR = 0xFF;       // Load NACK to confirm End Of Transmission.
       } else {
         USIDR = 0x00;       // Load ACK. Set data register bit 7 (output for SDA) low.
       }
       USI_TWI_Master_Transfer(tempUSISR_1bit);      // Generate ACK/NACK.
     }
-  } while (--msgSize);      // repeat until all data sent/received.
+  }
 
   if (stop) {
     USI_TWI_Master_Stop();  // Send a STOP condition on the TWI bus.
@@ -205,6 +215,19 @@ unsigned char USI_TWI_Start_Transceiver_With_Data_Stop(unsigned char *msg, unsig
   return (TRUE);            /* Transmission successfully completed */
 }
 
+/*---------------------------------------------------------------
+ Write one byte (the address or data) and clock in the (N)ACK
+ from the slave. Returns nonzero if it was a NACK.
+---------------------------------------------------------------*/
+static unsigned char USI_TWI_Master_Write_Byte(unsigned char value, unsigned char usisr_8bit, unsigned char usisr_1bit) {
+  USI_CLOCK_PORT &= ~(1 << USI_CLOCK_BIT);  // Pull SCL LOW.
+  USIDR = value;                            // Setup data.
+  USI_TWI_Master_Transfer(usisr_8bit);      // Send 8 bits on bus.
+                                            /* Clock and verify (N)ACK from slave */
+  USI_DDR &= ~(1 << USI_DI_BIT);            // Enable SDA as input.
+  return USI_TWI_Master_Transfer(usisr_1bit) & (1 << TWI_NACK_BIT);
+}
+
 /*---------------------------------------------------------------
  Core function for shifting data in and out from the USI.
  Data to be sent has to be placed into the USIDR prior to calling
@@ -254,4 +277,272 @@ unsigned char USI_TWI_Master_Stop(void) {
 
   return (TRUE);
 }
+/*---------------------------------------------------------------
+ Non-blocking master.
+
+ USI_TWI_Start_Async() does the same transfer as
+ USI_TWI_Start_Transceiver_With_Data_Stop(), but returns as soon as it
+ has started it. Timer1 is borrowed for the duration: its compare B
+ interrupt comes every half SCL period and toggles SCL with USITC
+ (that's all it does while a byte is being shifted), and the USI
+ counter overflow interrupt - once per byte and once per (N)ACK -
+ sets up the next one. Start and stop conditions are a few steps of
+ the timer interrupt. When it's over, Timer1 gets back what it had
+ and done() is called, from the interrupt, with the error state
+ (0 for success).
+
+ On parts where Timer1 doesn't fit (or isn't there), the transfer is
+ done the blocking way and done() called before returning.
+
+ The compare B vector is weak, so a sketch that defines its own
+ still links - but then it can't use the non-blocking transfers.
+---------------------------------------------------------------*/
+#define USI_ASYNC_IDLE      0
+#define USI_ASYNC_START1    1 // waiting for SCL to be released, then pull SDA low
+#define USI_ASYNC_START2    2 // pull SCL low, release SDA, start shifting the address
+#define USI_ASYNC_SHIFT     3 // the USI is clocking a byte or an (N)ACK
+#define USI_ASYNC_STOP1     4 // pull SDA low
+#define USI_ASYNC_STOP2     5 // release SCL
+#define USI_ASYNC_STOP3     6 // waiting for SCL to be released, then release SDA
+#define USI_ASYNC_STOP4     7 // check the stop condition was seen
+
+#define USI_ASYNC_BYTE_OUT  0 // what the USI is shifting while in USI_ASYNC_SHIFT
+#define USI_ASYNC_ACK_IN    1
+#define USI_ASYNC_BYTE_IN   2
+#define USI_ASYNC_ACK_OUT   3
+
+#define USI_ASYNC_8BIT ((1 << USISIF) | (1 << USIOIF) | (1 << USIPF) | (1 << USIDC) | (0x0 << USICNT0))
+#define USI_ASYNC_1BIT ((1 << USISIF) | (1 << USIOIF) | (1 << USIPF) | (1 << USIDC) | (0xE << USICNT0))
+#define USI_ASYNC_USICR ((0 << USISIE) | (1 << USIOIE) | (1 << USIWM1) | (0 << USIWM0) | \
+                         (1 << USICS1) | (0 << USICS0) | (1 << USICLK))
+
+volatile unsigned char USI_TWI_Async_Phase;
+static unsigned char  usi_async_shift;
+static volatile unsigned char usi_async_state; // error state of the last transfer, or USI_TWI_ASYNC_BUSY
+static unsigned char *usi_async_msg;
+static unsigned char  usi_async_left;         // bytes still to go after the one being shifted
+static unsigned char  usi_async_read;
+static unsigned char  usi_async_addr;         // 1 until the slave has acknowledged its address
+static unsigned char  usi_async_stop;
+static void (*usi_async_done)(unsigned char);
+
+unsigned char USI_TWI_Async_State(void) {
+  return usi_async_state;
+}
+
+#if defined(TIMER1_COMPB_vect) && defined(OCR1B) && (defined(TCCR1) || defined(TCCR1E) || defined(TCCR1A))
+  #define USI_TWI_ASYNC_TIMER
+  #if defined(TIMSK1)
+    #define USI_ASYNC_TIMSK TIMSK1
+    #define USI_ASYNC_TIFR  TIFR1
+  #else
+    #define USI_ASYNC_TIMSK TIMSK
+    #define USI_ASYNC_TIFR  TIFR
+  #endif
+  static unsigned char usi_async_ticks;
+  static unsigned char usi_async_saved[3];
+  static uint16_t      usi_async_saved_ocr1b;
+
+  // Run Timer1 free at F_CPU, counting to 0xFF or 0xFFFF, after saving what it was doing (probably PWM)
+  static void usi_async_timer_start(void) {
+    usi_async_saved_ocr1b = OCR1B;
+    #if defined(TCCR1)        // x5: 8-bit, the B channel's PWM is in GTCCR
+      usi_async_saved[0] = TCCR1;
+      usi_async_saved[1] = GTCCR;
+      TCCR1 = (1 << CS10);
+      GTCCR &= ~((1 << PWM1B) | (1 << COM1B1) | (1 << COM1B0));
+    #elif defined(TCCR1E)     // x61: 10-bit, TOP is OCR1C when not doing PWM
+      usi_async_saved[0] = TCCR1A;
+      usi_async_saved[1] = TCCR1B;
+      usi_async_saved[2] = OCR1C;
+      TCCR1A = 0;
+      TCCR1B = (1 << CS10);
+      OCR1C = 0xFF;
+    #else                     // Everything else: WGM 0 is normal mode
+      usi_async_saved[0] = TCCR1A;
+      usi_async_saved[1] = TCCR1B;
+      TCCR1A = 0;
+      TCCR1B = (1 << CS10);
+    #endif
+    OCR1B = TCNT1 + usi_async_ticks;
+    USI_ASYNC_TIFR = (1 << OCF1B);
+    USI_ASYNC_TIMSK |= (1 << OCIE1B);
+  }
+
+  static void usi_async_timer_stop(void) {
+    USI_ASYNC_TIMSK &= ~(1 << OCIE1B);
+    #if defined(TCCR1)
+      TCCR1 = usi_async_saved[0];
+      GTCCR = usi_async_saved[1];
+    #elif defined(TCCR1E)
+      TCCR1A = usi_async_saved[0];
+      TCCR1B = usi_async_saved[1];
+      OCR1C = usi_async_saved[2];
+    #else
+      TCCR1A = usi_async_saved[0];
+      TCCR1B = usi_async_saved[1];
+    #endif
+    OCR1B = usi_async_saved_ocr1b;
+  }
+
+  static void usi_async_finish(unsigned char state) {
+    usi_async_timer_stop();
+    USICR = USI_ASYNC_USICR & ~(1 << USIOIE);
+    USI_TWI_Async_Phase = USI_ASYNC_IDLE;
+    usi_async_state = state;
+    if (usi_async_done) {
+      usi_async_done(state);
+    }
+  }
+
+  /* Either the transfer is over, or a NACK ended it early; both leave SCL low. Without a STOP,
+   * it's left that way for the repeated start, just like the blocking version. */
+  static void usi_async_end(unsigned char state) {
+    if (usi_async_stop) {
+      usi_async_state = state; // until USI_ASYNC_STOP4 decides if there's anything to add
+      // The rest is up to the timer: with the overflow flag left set and its interrupt on, the
+      // overflow ISR would just run again, and take the 0xFF in USIDR for a NACK.
+      USISR = USI_ASYNC_8BIT;
+      USICR = USI_ASYNC_USICR & ~(1 << USIOIE);
+      USI_TWI_Async_Phase = USI_ASYNC_STOP1;
+    } else {
+      usi_async_finish(state);
+    }
+  }
+
+  ISR(TIMER1_COMPB_vect, __attribute__((weak))) {
+    OCR1B += usi_async_ticks;
+    switch (USI_TWI_Async_Phase) {
+      case USI_ASYNC_SHIFT:
+        if (USISR & (1 << USIOIF)) {
+          break;                                              // the overflow interrupt hasn't set up the next one yet
+        }
+        if ((USI_CLOCK_PORT & (1 << USI_CLOCK_BIT)) && !(USI_CLOCK_PIN & (1 << USI_CLOCK_BIT))) {
+          break;                                              // a slave is stretching the clock
+        }
+        USICR = USI_ASYNC_USICR | (1 << USITC);               // toggle SCL
+        break;
+      case USI_ASYNC_START1:
+        if (!(USI_CLOCK_PIN & (1 << USI_CLOCK_BIT))) {
+          break;
+        }
+        USI_PORT &= ~(1 << USI_DI_BIT);                       // Force SDA LOW.
+        USI_TWI_Async_Phase = USI_ASYNC_START2;
+        break;
+      case USI_ASYNC_START2:
+        USI_CLOCK_PORT &= ~(1 << USI_CLOCK_BIT);              // Pull SCL LOW.
+        USI_PORT |= (1 << USI_DI_BIT);                        // Release SDA.
+        #ifdef SIGNAL_VERIFY
+        if (!(USISR & (1 << USISIF))) {
+          usi_async_finish(USI_TWI_MISSING_START_CON);
+          break;
+        }
+        #endif
+        USIDR = *(usi_async_msg++);                           // the address
+        usi_async_shift = USI_ASYNC_BYTE_OUT;
+        USISR = USI_ASYNC_8BIT;
+        USICR = USI_ASYNC_USICR;
+        USI_TWI_Async_Phase = USI_ASYNC_SHIFT;
+        break;
+      case USI_ASYNC_STOP1:
+        USI_PORT &= ~(1 << USI_DI_BIT);                       // Pull SDA low.
+        USI_TWI_Async_Phase = USI_ASYNC_STOP2;
+        break;
+      case USI_ASYNC_STOP2:
+        USI_CLOCK_PORT |= (1 << USI_CLOCK_BIT);               // Release SCL.
+        USI_TWI_Async_Phase = USI_ASYNC_STOP3;
+        break;
+      case USI_ASYNC_STOP3:
+        if (!(USI_CLOCK_PIN & (1 << USI_CLOCK_BIT))) {
+          break;
+        }
+        USI_PORT |= (1 << USI_DI_BIT);                        // Release SDA.
+        USI_TWI_Async_Phase = USI_ASYNC_STOP4;
+        break;
+      case USI_ASYNC_STOP4:
+        #ifdef SIGNAL_VERIFY
+        if (!usi_async_state && !(USISR & (1 << USIPF))) {
+          usi_async_state = USI_TWI_MISSING_STOP_CON;
+        }
+        #endif
+        usi_async_finish(usi_async_state);
+        break;
+    }
+  }
+
+  void USI_TWI_Master_Async_Overflow(void) {
+    unsigned char data = USIDR;
+    switch (usi_async_shift) {
+      case USI_ASYNC_BYTE_OUT:                                // address or data sent, now clock in the (N)ACK
+        USIDR = 0xFF;
+        USI_DDR &= ~(1 << USI_DI_BIT);                        // Enable SDA as input.
+        usi_async_shift = USI_ASYNC_ACK_IN;
+        USISR = USI_ASYNC_1BIT;
+        break;
+      case USI_ASYNC_ACK_IN:
+        USIDR = 0xFF;
+        USI_DDR |= (1 << USI_DI_BIT);                         // Enable SDA as output (released).
+        if (data & (1 << TWI_NACK_BIT)) {
+          usi_async_end(usi_async_addr ? USI_TWI_NO_ACK_ON_ADDRESS : USI_TWI_NO_ACK_ON_DATA);
+          break;
+        }
+        usi_async_addr = 0;
+        if (!usi_async_left) {
+          usi_async_end(0);
+        } else if (usi_async_read) {
+          USI_DDR &= ~(1 << USI_DI_BIT);                      // Enable SDA as input.
+          usi_async_shift = USI_ASYNC_BYTE_IN;
+          USISR = USI_ASYNC_8BIT;
+        } else {
+          usi_async_left--;
+          USIDR = *(usi_async_msg++);
+          usi_async_shift = USI_ASYNC_BYTE_OUT;
+          USISR = USI_ASYNC_8BIT;
+        }
+        break;
+      case USI_ASYNC_BYTE_IN:
+        *(usi_async_msg++) = data;
+        usi_async_left--;
+        USIDR = usi_async_left ? 0x00 : 0xFF;                 // ACK, or NACK the last one
+        USI_DDR |= (1 << USI_DI_BIT);
+        usi_async_shift = USI_ASYNC_ACK_OUT;
+        USISR = USI_ASYNC_1BIT;
+        break;
+      case USI_ASYNC_ACK_OUT:
+        USIDR = 0xFF;                                         // Release SDA.
+        if (usi_async_left) {
+          USI_DDR &= ~(1 << USI_DI_BIT);
+          usi_async_shift = USI_ASYNC_BYTE_IN;
+          USISR = USI_ASYNC_8BIT;
+        } else {
+          usi_async_end(0);
+        }
+        break;
+    }
+  }
+#else
+  void USI_TWI_Master_Async_Overflow(void) {
+  }
+#endif
+
+void USI_TWI_Start_Async(unsigned char *msg, unsigned char msgSize, unsigned char stop, void (*done)(unsigned char)) {
+  usi_async_done = done;
+  #ifdef USI_TWI_ASYNC_TIMER
+    usi_async_msg   = msg;
+    usi_async_left  = msgSize - 1;                          // not counting the address
+    usi_async_read  = (*msg & (1 << TWI_READ_BIT));
+    usi_async_addr  = 1;
+    usi_async_stop  = stop;
+    usi_async_ticks = USI_TWI_MASTER_SPEED ? USI_TWI_ASYNC_TICKS_FM : USI_TWI_ASYNC_TICKS_SM;
+    usi_async_state = USI_TWI_ASYNC_BUSY;
+    USI_TWI_Async_Phase = USI_ASYNC_START1;
+    USI_CLOCK_PORT |= (1 << USI_CLOCK_BIT);                 // Release SCL; the timer takes it from here.
+    usi_async_timer_start();
+  #else
+    usi_async_state = USI_TWI_Start_Transceiver_With_Data_Stop(msg, msgSize, stop) ? 0 : USI_TWI_state.errorState;
+    if (done) {
+      done(usi_async_state);
+    }
+  #endif
+}
 #endif
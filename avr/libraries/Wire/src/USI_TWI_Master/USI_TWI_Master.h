@@ -29,6 +29,8 @@
 *
 ****************************************************************************/
 
+#ifndef USI_TWI_Master_h
+#define USI_TWI_Master_h
 #include <avr/io.h>
 #include <Arduino.h>
 #ifndef TWDR
@@ -89,11 +91,35 @@
 #define DELAY_T4TWI_FM (_delay_loop_1(T4_TWI_FM))
 #define DELAY_T2TWI (_delay_loop_1(T2_TWI))
 #define DELAY_T4TWI (_delay_loop_1(T4_TWI))
-//********** Prototypes **********//
+// Non-blocking transfers: the SCL half-period, in clocks, taken from Timer1 (see USI_TWI_Master.c)
+// It is never less than USI_TWI_ASYNC_MIN_TICKS, so the sketch still gets to run between edges;
+// on slow clocks that means the bus runs slower than asked.
+#ifndef USI_TWI_ASYNC_MIN_TICKS
+  #define USI_TWI_ASYNC_MIN_TICKS 64
+#endif
+#define USI_TWI_ASYNC_TICKS(us_x10) ((F_CPU / 100000UL * (us_x10) / 100) > USI_TWI_ASYNC_MIN_TICKS ? (F_CPU / 100000UL * (us_x10) / 100) : USI_TWI_ASYNC_MIN_TICKS)
+#define USI_TWI_ASYNC_TICKS_SM (USI_TWI_ASYNC_TICKS(50)) // 5us, 100 kHz
+#define USI_TWI_ASYNC_TICKS_FM (USI_TWI_ASYNC_TICKS(15)) // 1.5us, about 333 kHz
 
+#define USI_TWI_ASYNC_BUSY 0xFF // USI_TWI_Async_State() while a transfer is running
+
+//********** Prototypes **********//
+#ifdef __cplusplus
+extern "C" {
+#endif
 void USI_TWI_Master_Initialise(void);
 void USI_TWI_Master_Speed(uint8_t);
 unsigned char USI_TWI_Start_Transceiver_With_Data_Stop(unsigned char *, unsigned char, unsigned char);
 unsigned char USI_TWI_Start_Transceiver_With_Data(unsigned char *, unsigned char);
+unsigned char USI_TWI_Start_Transfer(unsigned char, unsigned char *, unsigned char, unsigned char);
 unsigned char USI_TWI_Get_State_Info(void);
+void USI_TWI_Start_Async(unsigned char *, unsigned char, unsigned char, void (*)(unsigned char));
+unsigned char USI_TWI_Async_State(void);
+// Called by the USI overflow ISR (in USI_TWI_Slave.cpp, which owns the vector) while USI_TWI_Async_Phase is nonzero
+void USI_TWI_Master_Async_Overflow(void);
+extern volatile unsigned char USI_TWI_Async_Phase;
+#ifdef __cplusplus
+}
+#endif
+#endif
 #endif
@@ -5,7 +5,7 @@
  *
  * Atmel Corporation
  *
- * File              : USI_TWI_Slave.c
+ * File              : USI_TWI_Slave.c (now .cpp, for the RingBuffer template)
  * Compiler          : IAR EWAAVR 4.11A
  * Revision          : $Revision: 614 $
  * Date              : $Date: 2006-07-07 16:27:05 +0800 (Fri, 07 Jul 2006) $
@@ -27,29 +27,34 @@
 #include "avr/interrupt.h"
 #ifdef USIDR
 #include "USI_TWI_Slave.h"
+#include "../USI_TWI_Master/USI_TWI_Master.h"
 
 //********** Buffer **********//
-uint8_t TWI_Buffer[TWI_BUFFER_SIZE];
+usi_twi_buffers_t TWI_Buffers;
+
+void (*USI_TWI_On_Slave_Transmit)(void);
+void (*USI_TWI_On_Slave_Receive)(int);
 
 //********** Static Variables **********//
 
 static unsigned char          TWI_slaveAddress;
 static volatile unsigned char USI_TWI_Overflow_State;
 
-/*=========================> Locals <=======================================*/
-static uint8_t *        TWI_RxBuf = TWI_Buffer;
-static volatile uint8_t TWI_RxHead;
-static volatile uint8_t TWI_RxTail;
+// Register map mode, when TWI_Regs is set: see USI_TWI_Slave_Register_Map()
+static volatile uint8_t *TWI_Regs;
+static const uint8_t    *TWI_Regs_Writable;
+static uint8_t           TWI_Regs_Size;
+static uint8_t           TWI_Regs_Index;
+static uint8_t           TWI_Regs_Index_Next; // 1 while the next byte written is the register number
 
-static uint8_t *        TWI_TxBuf = TWI_Buffer + TWI_RX_BUFFER_SIZE;
-static volatile uint8_t TWI_TxHead;
-static volatile uint8_t TWI_TxTail;
+/*=========================> Locals <=======================================*/
+// The ISR produces into TWI_Rx and consumes from TWI_Tx; the sketch does the opposite.
+#define TWI_Rx (TWI_Buffers.slave.rx)
+#define TWI_Tx (TWI_Buffers.slave.tx)
 
 void Flush_TWI_Buffers(void) {
-  TWI_RxTail = 0;
-  TWI_RxHead = 0;
-  TWI_TxTail = 0;
-  TWI_TxHead = 0;
+  TWI_Rx.reset();
+  TWI_Tx.reset();
 }
 
 //********** USI_TWI functions **********//
@@ -64,6 +69,7 @@ void USI_TWI_Slave_Initialise(unsigned char TWI_ownAddress) {
 
   USI_TWI_On_Slave_Transmit = 0;
   USI_TWI_On_Slave_Receive = 0;
+  TWI_Regs = 0;
 
   USI_CLOCK_PORT  |= (1 << USI_CLOCK_BIT);    // Set SCL high
   USI_PORT        |= (1 << USI_DI_BIT);          // Set SDA high
@@ -87,48 +93,31 @@ void USI_TWI_Slave_Disable() {
 
 // Puts data in the transmission buffer, Waits if buffer is full.
 void USI_TWI_Transmit_Byte(unsigned char data) {
-  unsigned char tmphead;
-  tmphead = (TWI_TxHead + 1) & TWI_TX_BUFFER_MASK; // Calculate buffer index.
-  while (tmphead == TWI_TxTail);                   // Wait for free space in buffer.
-  TWI_TxBuf[tmphead] = data;      // Store data in buffer.
-  TWI_TxHead         = tmphead;   // Store new index.
+  while (!TWI_Tx.push(data));      // Wait for free space in buffer.
 }
 
 // Returns a byte from the receive buffer. Waits if buffer is empty.
 unsigned char USI_TWI_Receive_Byte(void) {
-  unsigned char tmptail;
-  unsigned char tmpRxTail; // Temporary variable to store volatile
-  tmpRxTail = TWI_RxTail;  // Not necessary, but prevents warnings
-  while (TWI_RxHead == tmpRxTail)
-    ;
-  tmptail    = (TWI_RxTail + 1) & TWI_RX_BUFFER_MASK; // Calculate buffer index
-  TWI_RxTail = tmptail;                               // Store new index
-  return TWI_RxBuf[tmptail];                          // Return data from the buffer.
+  uint8_t data;
+  while (!TWI_Rx.pop(data));
+  return data;
 }
 
-// Returns a byte from the receive buffer without incrementing TWI_RxTail. Waits if buffer is empty.
+// Returns a byte from the receive buffer without removing it. Waits if buffer is empty.
 unsigned char USI_TWI_Peek_Receive_Byte(void) {
-  unsigned char tmptail;
-  unsigned char tmpRxTail; // Temporary variable to store volatile
-  tmpRxTail = TWI_RxTail;  // Not necessary, but prevents warnings
-  while (TWI_RxHead == tmpRxTail)
-    ;
-  tmptail    = (TWI_RxTail + 1) & TWI_RX_BUFFER_MASK; // Calculate buffer index
-  return TWI_RxBuf[tmptail];                          // Return data from the buffer.
+  int16_t data;
+  while ((data = TWI_Rx.peek()) < 0);
+  return data;
 }
 
 // Check if there is data in the receive buffer.
 unsigned char USI_TWI_Data_In_Receive_Buffer(void) {
-  unsigned char tmpRxTail;                              // Temporary variable to store volatile
-  tmpRxTail = TWI_RxTail;                               // Not necessary, but prevents warnings
-  return (TWI_RxHead - tmpRxTail) & TWI_RX_BUFFER_MASK; // Return 0 (FALSE) if the receive buffer is empty.
+  return TWI_Rx.available();       // Return 0 (FALSE) if the receive buffer is empty.
 }
 
 // Check if there is space in the transmission buffer.
 unsigned char USI_TWI_Space_In_Transmission_Buffer(void) {
-  unsigned char tmpTxHead;
-  tmpTxHead = (TWI_TxHead + 1) & TWI_TX_BUFFER_MASK;    // Calculate next buffer index.
-  return (TWI_TxTail - tmpTxHead) & TWI_TX_BUFFER_MASK; // Return 0 (FALSE) if the transmission buffer is full.
+  return TWI_Tx.space();           // Return 0 (FALSE) if the transmission buffer is full.
 }
 
 // Check if there is an active data session.
@@ -137,6 +126,29 @@ unsigned char USI_TWI_Slave_Is_Active() {
   return (USICR & (1 << USIOIE)) && ((USISR & (1 << USIPF)) == 0);
 }
 
+/*----------------------------------------------------------
+  Serve the bus straight out of regs[size] instead of the
+  buffers, the way most I2C sensors work: the first byte of a
+  write picks the register (it's NACKed if there's no such
+  register), the rest are written there and on, and a read
+  starts wherever the last one left off. Either way the index
+  wraps around at the end. Only the bits set in writable[n] can
+  be written in regs[n]; writable can be NULL to let the master
+  write everything. No callbacks are made, so the clock is only
+  ever held for as long as the overflow ISR takes to copy one
+  byte. Call after USI_TWI_Slave_Initialise(), which turns it
+  off again; regs = NULL turns it off too.
+----------------------------------------------------------*/
+void USI_TWI_Slave_Register_Map(volatile uint8_t *regs, const uint8_t *writable, uint8_t size) {
+  uint8_t oldSREG = SREG;
+  cli();
+  TWI_Regs = size ? regs : 0;
+  TWI_Regs_Writable = writable;
+  TWI_Regs_Size = size;
+  TWI_Regs_Index = 0;
+  SREG = oldSREG;
+}
+
 /*----------------------------------------------------------
  Detects the USI_TWI Start Condition and initializes the USI
  for reception of the "TWI Address" packet.
@@ -144,13 +156,11 @@ unsigned char USI_TWI_Slave_Is_Active() {
 
 ISR(USI_START_VECTOR) {
   unsigned char tmpPin;             // Temporary variable for pin state
-  unsigned char tmpRxHead;          // Temporary variable to store volatile
   // call slave receive callback on repeated start
   if (USI_TWI_On_Slave_Receive) {
-    tmpRxHead = TWI_RxHead;
-    if (TWI_RxTail != tmpRxHead) {  // data in receive buffer
-      USI_TWI_On_Slave_Receive(USI_TWI_Data_In_Receive_Buffer());
-      TWI_RxTail = tmpRxHead;       // reset rx buffer
+    if (!TWI_Rx.empty()) {          // data in receive buffer
+      USI_TWI_On_Slave_Receive(TWI_Rx.available());
+      TWI_Rx.clear();               // reset rx buffer
     }
   }
 
@@ -181,9 +191,12 @@ ISR(USI_START_VECTOR) {
  for new Start Condition.
 ----------------------------------------------------------*/
 ISR(USI_OVERFLOW_VECTOR) {
-  unsigned char tmpRxHead;
-  unsigned char tmpTxTail; // Temporary variables to store volatiles
-  unsigned char tmpUSIDR;
+  uint8_t data;
+
+  if (USI_TWI_Async_Phase) {        // Not a slave right now: a non-blocking master transfer is running
+    USI_TWI_Master_Async_Overflow();
+    return;
+  }
 
   switch (USI_TWI_Overflow_State) {
   // ---------- Address mode ----------
@@ -191,15 +204,15 @@ ISR(USI_OVERFLOW_VECTOR) {
   case USI_SLAVE_CHECK_ADDRESS:
     if ((USIDR == 0) || ((USIDR >> 1) == TWI_slaveAddress)) {
       if (USIDR & 0x01) {
-        if (USI_TWI_On_Slave_Transmit) {
+        if (USI_TWI_On_Slave_Transmit && !TWI_Regs) {
           // reset tx buffer and call callback
-          tmpTxTail = TWI_TxHead;
-          TWI_TxTail = tmpTxTail;
+          TWI_Tx.clear();
           USI_TWI_On_Slave_Transmit();
         }
         USI_TWI_Overflow_State = USI_SLAVE_SEND_DATA;
       } else {
         USI_TWI_Overflow_State = USI_SLAVE_REQUEST_DATA;
+        TWI_Regs_Index_Next = 1;
       }
       SET_USI_TO_SEND_ACK();
     } else {
@@ -220,11 +233,17 @@ ISR(USI_OVERFLOW_VECTOR) {
   /* Falls through. */
   case USI_SLAVE_SEND_DATA:
 
+    if (TWI_Regs) {
+      uint8_t index = TWI_Regs_Index;
+      USIDR = TWI_Regs[index];
+      if (++index == TWI_Regs_Size) {
+        index = 0;
+      }
+      TWI_Regs_Index = index;
+    }
     // Get data from Buffer
-    tmpTxTail = TWI_TxTail; // Not necessary, but prevents warnings
-    if (TWI_TxHead != tmpTxTail) {
-      TWI_TxTail = (TWI_TxTail + 1) & TWI_TX_BUFFER_MASK;
-      USIDR      = TWI_TxBuf[TWI_TxTail];
+    else if (TWI_Tx.pop(data)) {
+      USIDR = data;
     } else // If the buffer is empty then:
     {
       SET_USI_TO_TWI_START_CONDITION_MODE();
@@ -247,16 +266,15 @@ ISR(USI_OVERFLOW_VECTOR) {
     SET_USI_TO_READ_DATA();
     // call slave receive callback on stop condition
     if (USI_TWI_On_Slave_Receive) {
-      tmpRxHead = TWI_RxHead;
-      if (TWI_RxTail != tmpRxHead) { // data in receive buffer
+      if (!TWI_Rx.empty()) { // data in receive buffer
         // check for stop Condition
         while ((USISR & ((1 << USI_START_COND_INT) | (1 << USIPF) | (0xE << USICNT0))) == 0)
           ; // wait for either Start or Stop Condition
           // cancel after one SCL cycle
         if (USISR & (1 << USIPF)) { // Stop Condition
-          USI_TWI_On_Slave_Receive(USI_TWI_Data_In_Receive_Buffer());
+          USI_TWI_On_Slave_Receive(TWI_Rx.available());
           // reset rx buffer
-          TWI_RxTail = tmpRxHead;
+          TWI_Rx.clear();
         }
       }
     }
@@ -264,13 +282,29 @@ ISR(USI_OVERFLOW_VECTOR) {
 
   // Copy data from USIDR and send ACK. Next USI_SLAVE_REQUEST_DATA
   case USI_SLAVE_GET_DATA_AND_SEND_ACK:
-    // Put data into Buffer
     USI_TWI_Overflow_State = USI_SLAVE_REQUEST_DATA;
-    tmpUSIDR              = USIDR; // Not necessary, but prevents warnings
-    tmpRxHead = (TWI_RxHead + 1) & TWI_RX_BUFFER_MASK;
-    if (TWI_RxTail != tmpRxHead) {
-      TWI_RxHead            = tmpRxHead;
-      TWI_RxBuf[TWI_RxHead] = tmpUSIDR;
+    if (TWI_Regs) {
+      uint8_t index = TWI_Regs_Index;
+      data = USIDR;
+      if (TWI_Regs_Index_Next) {
+        TWI_Regs_Index_Next = 0;
+        if (data >= TWI_Regs_Size) {
+          SET_USI_TO_SEND_NACK();
+          break;
+        }
+        index = data;
+      } else {
+        uint8_t mask = TWI_Regs_Writable ? TWI_Regs_Writable[index] : 0xFF;
+        TWI_Regs[index] = (TWI_Regs[index] & ~mask) | (data & mask);
+        if (++index == TWI_Regs_Size) {
+          index = 0;
+        }
+      }
+      TWI_Regs_Index = index;
+      SET_USI_TO_SEND_ACK();
+    }
+    // Put data into Buffer
+    else if (TWI_Rx.push(USIDR)) {
       SET_USI_TO_SEND_ACK();
     } else // If the buffer is full then:
     {
@@ -23,9 +23,12 @@
  *
  *
  ****************************************************************************/
+#ifndef USI_TWI_Slave_h
+#define USI_TWI_Slave_h
 //********** Prototypes **********//
 #include <avr/io.h>
 #include <Arduino.h>
+#include <RingBuffer.h>
 #ifndef TWDR
 void          USI_TWI_Slave_Initialise(unsigned char);
 void          USI_TWI_Slave_Disable();
@@ -35,9 +38,10 @@ unsigned char USI_TWI_Peek_Receive_Byte(void);
 unsigned char USI_TWI_Data_In_Receive_Buffer(void);
 unsigned char USI_TWI_Space_In_Transmission_Buffer(void);
 unsigned char USI_TWI_Slave_Is_Active();
+void          USI_TWI_Slave_Register_Map(volatile uint8_t *, const uint8_t *, uint8_t);
 
-void (*USI_TWI_On_Slave_Transmit)(void);
-void (*USI_TWI_On_Slave_Receive)(int);
+extern void (*USI_TWI_On_Slave_Transmit)(void);
+extern void (*USI_TWI_On_Slave_Receive)(int);
 
 void Timer_Init(void);
 
@@ -49,26 +53,37 @@ typedef unsigned char uint8_t;
 //////////////////////////////////////////////////////////////////
 ///////////////// Driver Buffer Definitions //////////////////////
 //////////////////////////////////////////////////////////////////
-// 1,2,4,8,16,32,64,128 or 256 bytes are allowed buffer sizes
-extern uint8_t TWI_Buffer[];
-
-#define TWI_RX_BUFFER_SIZE (16)
-#define TWI_RX_BUFFER_MASK (TWI_RX_BUFFER_SIZE - 1)
-
-#if (TWI_RX_BUFFER_SIZE & TWI_RX_BUFFER_MASK)
-#error TWI RX buffer size is not a power of 2
+// 2,4,8,16,32,64,128 or 256 bytes are allowed buffer sizes (RingBuffer checks), and they hold one less than that.
+// 0 is allowed too, for no buffer. WIRE_BUFFER_SIZE (see Wire.h) is split evenly between them.
+#ifndef TWI_RX_BUFFER_SIZE
+  #ifdef WIRE_BUFFER_SIZE
+    #define TWI_RX_BUFFER_SIZE (WIRE_BUFFER_SIZE / 2)
+  #else
+    #define TWI_RX_BUFFER_SIZE (16)
+  #endif
 #endif
-
-// 1,2,4,8,16,32,64,128 or 256 bytes are allowed buffer sizes
-
-#define TWI_TX_BUFFER_SIZE (16)
-#define TWI_TX_BUFFER_MASK (TWI_TX_BUFFER_SIZE - 1)
-
-#if (TWI_TX_BUFFER_SIZE & TWI_TX_BUFFER_MASK)
-#error TWI TX buffer size is not a power of 2
+#ifndef TWI_TX_BUFFER_SIZE
+  #ifdef WIRE_BUFFER_SIZE
+    #define TWI_TX_BUFFER_SIZE (WIRE_BUFFER_SIZE / 2)
+  #else
+    #define TWI_TX_BUFFER_SIZE (16)
+  #endif
 #endif
 
 #define TWI_BUFFER_SIZE (TWI_RX_BUFFER_SIZE + TWI_TX_BUFFER_SIZE)
+
+/* Master and slave are never in use at once, so Wire's master buffer shares the memory
+ * of the two slave rings. USI_TWI_Slave_Initialise() empties the rings again after the
+ * master has been scribbling in them. */
+typedef union {
+  uint8_t master[TWI_BUFFER_SIZE];
+  struct {
+    RingBuffer<TWI_RX_BUFFER_SIZE> rx;
+    RingBuffer<TWI_TX_BUFFER_SIZE> tx;
+  } slave;
+} usi_twi_buffers_t;
+extern usi_twi_buffers_t TWI_Buffers;
+#define TWI_Buffer (TWI_Buffers.master)
 //////////////////////////////////////////////////////////////////
 
 #define USI_SLAVE_CHECK_ADDRESS (0x00)
@@ -136,3 +151,4 @@ extern uint8_t TWI_Buffer[];
             (0x0 << USICNT0); /* set USI to shift out 8 bits        */                   \
   }
 #endif
+#endif
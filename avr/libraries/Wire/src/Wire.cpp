@@ -321,6 +321,24 @@
     user_onRequest = function;
   }
 
+  // hands a sequence of segments to the twi transaction queue
+  uint8_t TwoWire::queue(const twi_segment_t *segments, uint8_t count, void (*callback)(uint8_t)) {
+    return twi_queue(segments, count, callback);
+  }
+
+  uint8_t TwoWire::queueSpace(void) {
+    return twi_queueSpace();
+  }
+
+  // twi.c reads into and writes from the caller's array directly
+  uint8_t TwoWire::readInto(uint8_t address, uint8_t *dst, uint8_t len, uint8_t sendStop) {
+    return twi_readFrom(address, dst, len, sendStop);
+  }
+
+  uint8_t TwoWire::writeFrom(uint8_t address, const uint8_t *src, uint8_t len, uint8_t sendStop) {
+    return twi_writeTo(address, (uint8_t *)src, len, 1, sendStop);
+  }
+
   /******************************/
   /* END TWI I2C IMPLEMENTATION */
   /******************************/
@@ -332,11 +350,11 @@
   #include <stdlib.h>
   #include <string.h>
   #include <inttypes.h>
-  #include "USI_TWI_Slave/USI_TWI_Slave.h"
   #include "USI_TWI_Master/USI_TWI_Master.h"
   }
+  #include "USI_TWI_Slave/USI_TWI_Slave.h"
 
-  const uint8_t WIRE_BUFFER_LENGTH = TWI_BUFFER_SIZE - 1; //reserve slave addr
+  const uint8_t WIRE_BUFFER_LENGTH = TWI_BUFFER_SIZE ? TWI_BUFFER_SIZE - 1 : 0; //reserve slave addr
 
   // Initialize Class Variables   *
 
@@ -348,11 +366,50 @@
 
   uint8_t TwoWire::transmitting = 0;
 
+  uint8_t TwoWire::asyncQuantity = 0;
+  void (*TwoWire::user_onAsyncDone)(uint8_t);
+
   // Constructors   *
 
   TwoWire::TwoWire() {
   }
 
+  // Private Methods   *
+
+  // What endTransmission() returns for a given USI_TWI_Get_State_Info()
+  static uint8_t usiErrorCode(uint8_t state) {
+    switch (state) {
+    case 0:
+      return 0; //success
+    case USI_TWI_DATA_OUT_OF_BOUND:
+      return 1; //data too long to fit in transmit buffer
+    case USI_TWI_NO_ACK_ON_ADDRESS:
+      return 2; //received NACK on transmit of address
+    case USI_TWI_NO_ACK_ON_DATA:
+      return 3; //received NACK on transmit of data
+    }
+    return 4; //other error
+  }
+
+  static inline void waitForAsync(void) {
+    while (USI_TWI_Async_State() == USI_TWI_ASYNC_BUSY);
+  }
+
+  // Called from the interrupt when a non-blocking transfer is over
+  void TwoWire::onAsyncDone(uint8_t state) {
+    uint8_t ret = usiErrorCode(state);
+    if (asyncQuantity) { // it was a read
+      BufferIndex = 1; // ignore slave address
+      BufferLength = ret ? 1 : asyncQuantity;
+    } else {
+      BufferIndex = 0;
+      BufferLength = 0;
+    }
+    if (user_onAsyncDone) {
+      user_onAsyncDone(ret);
+    }
+  }
+
   // Public Methods   *
 
   void TwoWire::begin(void) {
@@ -376,6 +433,11 @@
     begin((uint8_t)address);
   }
 
+  void TwoWire::beginRegisterMap(uint8_t address, volatile uint8_t *regs, uint8_t size, const uint8_t *writable) {
+    begin(address);
+    USI_TWI_Slave_Register_Map(regs, writable, size);
+  }
+
   void TwoWire::end(void) {
     USI_TWI_Slave_Disable();
     USI_CLOCK_DDR   &= ~(1 << USI_CLOCK_BIT); // Enable SCL as input.
@@ -395,6 +457,7 @@
   uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity,
                                uint32_t iaddress, uint8_t isize,
                                uint8_t sendStop) {
+    waitForAsync();
     if (isize > 0) {
       // send internal address; this mode allows sending a repeated
       // start to access some devices' internal registers. This function
@@ -415,6 +478,9 @@
       endTransmission(false);
     }
 
+    if (TWI_BUFFER_SIZE == 0) { // no room even for the address
+      return 0;
+    }
     // reserve one byte for slave address
     quantity++;
     // clamp to buffer length
@@ -455,6 +521,7 @@
   }
 
   void TwoWire::beginTransmission(uint8_t address) {
+    waitForAsync();
     // indicate that we are transmitting
     transmitting = 1;
     // set address of targeted slave and write mode
@@ -480,15 +547,7 @@
     transmitting = 0;
     // check for error
     if (ret == FALSE) {
-      switch (USI_TWI_Get_State_Info()) {
-      case USI_TWI_DATA_OUT_OF_BOUND:
-        return 1; //data too long to fit in transmit buffer
-      case USI_TWI_NO_ACK_ON_ADDRESS:
-        return 2; //received NACK on transmit of address
-      case USI_TWI_NO_ACK_ON_DATA:
-        return 3; //received NACK on transmit of data
-      }
-      return 4; //other error
+      return usiErrorCode(USI_TWI_Get_State_Info());
     }
     return 0; //success
   }
@@ -497,6 +556,68 @@
     return endTransmission(true);
   }
 
+  uint8_t TwoWire::endTransmissionAsync(uint8_t sendStop, void (*callback)(uint8_t)) {
+    if (USI_TWI_Async_State() == USI_TWI_ASYNC_BUSY) {
+      return 4;
+    }
+    uint8_t length = BufferLength;
+    asyncQuantity = 0;
+    user_onAsyncDone = callback;
+    transmitting = 0;
+    // nothing to read() until it's over
+    BufferIndex = 1;
+    BufferLength = 1;
+    USI_TWI_Start_Async(Buffer, length, sendStop, onAsyncDone);
+    return 0;
+  }
+
+  uint8_t TwoWire::requestFromAsync(uint8_t address, uint8_t quantity, uint8_t sendStop, void (*callback)(uint8_t)) {
+    if (USI_TWI_Async_State() == USI_TWI_ASYNC_BUSY || TWI_BUFFER_SIZE == 0) {
+      return 4;
+    }
+    // reserve one byte for slave address
+    quantity++;
+    // clamp to buffer length
+    if (quantity > TWI_BUFFER_SIZE) {
+      quantity = TWI_BUFFER_SIZE;
+    }
+    // set address of targeted slave and read mode
+    Buffer[0] = (address << TWI_ADR_BITS) | (1 << TWI_READ_BIT);
+    asyncQuantity = quantity;
+    user_onAsyncDone = callback;
+    // nothing to read() until it's over
+    BufferIndex = 1;
+    BufferLength = 1;
+    USI_TWI_Start_Async(Buffer, quantity, sendStop, onAsyncDone);
+    return 0;
+  }
+
+  // The address goes out on its own, so the data can go straight to or from the caller's array
+  uint8_t TwoWire::readInto(uint8_t address, uint8_t *dst, uint8_t len, uint8_t sendStop) {
+    waitForAsync();
+    if (!USI_TWI_Start_Transfer((address << TWI_ADR_BITS) | (1 << TWI_READ_BIT), dst, len, sendStop)) {
+      return 0;
+    }
+    return len;
+  }
+
+  uint8_t TwoWire::writeFrom(uint8_t address, const uint8_t *src, uint8_t len, uint8_t sendStop) {
+    waitForAsync();
+    if (!USI_TWI_Start_Transfer((address << TWI_ADR_BITS) | (0 << TWI_READ_BIT), (uint8_t *)src, len, sendStop)) {
+      return usiErrorCode(USI_TWI_Get_State_Info());
+    }
+    return 0;
+  }
+
+  uint8_t TwoWire::asyncStatus(void) {
+    uint8_t state = USI_TWI_Async_State();
+    __asm__ __volatile__ ("" ::: "memory"); // so that once this says it's done, read() sees what came in
+    if (state == USI_TWI_ASYNC_BUSY) {
+      return WIRE_ASYNC_BUSY;
+    }
+    return usiErrorCode(state);
+  }
+
   // must be called in:
   // slave tx event callback
   // or after beginTransmission(address)
@@ -638,8 +759,11 @@
   }
 
   void TwoWire::setClock(uint32_t clock) {
-    // XXX: to be implemented.
-    (void)clock; //disable warning
+    #ifndef WIRE_SLAVE_ONLY
+      softWire.setClock(clock);
+    #else
+      (void)clock; //disable warning
+    #endif
   }
   size_t TwoWire::write(const uint8_t *data, size_t quantity) {
     size_t numBytes = 0;
@@ -799,6 +923,18 @@
         }
         return 4; // other error
       }
+      uint8_t TwoWire::readInto(uint8_t address, uint8_t *dst, uint8_t len, uint8_t sendStop) {
+        if (!slaveMode) {
+          return softWire.readInto(address, dst, len, sendStop);
+        }
+        return 0;
+      }
+      uint8_t TwoWire::writeFrom(uint8_t address, const uint8_t *src, uint8_t len, uint8_t sendStop) {
+        if (!slaveMode) {
+          return softWire.writeFrom(address, src, len, sendStop);
+        }
+        return 4; // other error
+      }
     #elif defined(WIRE_MASTER_ONLY)
       void TwoWire::beginTransmission(uint8_t address) {
         softWire.beginTransmission(address);
@@ -809,6 +945,12 @@
       uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop) {
         return softWire.requestFrom(address, quantity, sendStop);
       }
+      uint8_t TwoWire::readInto(uint8_t address, uint8_t *dst, uint8_t len, uint8_t sendStop) {
+        return softWire.readInto(address, dst, len, sendStop);
+      }
+      uint8_t TwoWire::writeFrom(uint8_t address, const uint8_t *src, uint8_t len, uint8_t sendStop) {
+        return softWire.writeFrom(address, src, len, sendStop);
+      }
     #endif
   #endif
   /* END MASTER ONLY METHODS */
@@ -40,10 +40,19 @@
 
 #include <avr/io.h>
 
-
+/* WIRE_BUFFER_SIZE (from the Wire Buffers tools menu, or -D) sets the size of the buffers behind
+ * requestFrom()/beginTransmission() and the slave callbacks, in place of the defaults below. 0
+ * means no buffers at all: readInto() and writeFrom(), which move data straight between the bus
+ * and your own array, still work (on every implementation), but the buffered calls can't move any
+ * data, and slave mode is of no use. */
+#if defined(WIRE_BUFFER_SIZE) && WIRE_BUFFER_SIZE != 0 && (WIRE_BUFFER_SIZE < 4 || WIRE_BUFFER_SIZE > 128 || (WIRE_BUFFER_SIZE & (WIRE_BUFFER_SIZE - 1)))
+  #error "WIRE_BUFFER_SIZE must be 0 or a power of 2 from 4 to 128"
+#endif
 
 #ifdef TWDR
-  #if ((RAMEND + 1) - RAMSTART) > 128
+  #if defined(WIRE_BUFFER_SIZE)
+    #define BUFFER_LENGTH WIRE_BUFFER_SIZE
+  #elif ((RAMEND + 1) - RAMSTART) > 128
     #define BUFFER_LENGTH 32
   #else
     #define BUFFER_LENGTH 16
@@ -54,6 +63,7 @@
 
   #include <inttypes.h>
   #include "Stream.h"
+  #include "twi.h"
 
   // WIRE_HAS_END means Wire has end()
   #define WIRE_HAS_END 1
@@ -99,6 +109,18 @@
       virtual void flush(void);
       void onReceive( void (*)(int));
       void onRequest( void (*)(void));
+      /* Queue a whole sequence of segments (see twi.h) - e.g., write a register address, repeated
+       * start, read N bytes, then the same for the next device - to run from the TWI interrupt,
+       * and return right away. callback (if any) is called from the interrupt when it's over,
+       * with what endTransmission() would have returned for the first segment that failed, or 0.
+       * Returns 0 if queued, 1 if it can never fit, 2 if there's no room right now (see queueSpace()). */
+      uint8_t queue(const twi_segment_t *, uint8_t, void (*)(uint8_t) = NULL);
+      uint8_t queueSpace(void);
+      /* Read len bytes from, or write len bytes to, address - straight between the bus and your
+       * array, skipping Wire's buffer. readInto() returns how many bytes were read (0 if it failed),
+       * writeFrom() the same error code as endTransmission(). */
+      uint8_t readInto(uint8_t address, uint8_t *dst, uint8_t len, uint8_t sendStop = true);
+      uint8_t writeFrom(uint8_t address, const uint8_t *src, uint8_t len, uint8_t sendStop = true);
 
       inline size_t write(unsigned long n) { return write((uint8_t)n); }
       inline size_t write(long n) { return write((uint8_t)n); }
@@ -117,6 +139,7 @@
   // Buffer sizes are defined in USI_TWI_Slave/USI_TWI_Slave.h
   extern const uint8_t WIRE_BUFFER_LENGTH;
   #define BUFFER_LENGTH (WIRE_BUFFER_LENGTH)
+  #define WIRE_ASYNC_BUSY 0xFF
 
   // WIRE_HAS_END means Wire has end()
   #define WIRE_HAS_END 1
@@ -128,6 +151,9 @@
       static uint8_t BufferLength;
       static uint8_t fastmode;
       static uint8_t transmitting;
+      static uint8_t asyncQuantity;
+      static void (*user_onAsyncDone)(uint8_t);
+      static void onAsyncDone(uint8_t);
     public:
       TwoWire();
       void begin();
@@ -154,6 +180,22 @@
       void onReceive( void (*)(int));
       void onRequest( void (*)(void));
       uint8_t isActive(void);
+      /* Slave at address serving regs[size] like a register-mapped sensor, with no callbacks:
+       * the first byte the master writes selects a register, the rest are written from there on
+       * (only the bits set in writable[n] can change in regs[n] - NULL for all of them), and reads
+       * carry on from wherever the last read or write stopped. */
+      void beginRegisterMap(uint8_t address, volatile uint8_t *regs, uint8_t size, const uint8_t *writable = NULL);
+      /* Non-blocking versions of endTransmission() and requestFrom(): these return once the
+       * transfer has started (0), or 4 if one is already running, and the bus is then run from
+       * interrupts, borrowing Timer1. When it's done, callback (if any) is called - from the
+       * interrupt - with what endTransmission() would have returned, and asyncStatus() returns
+       * that too (it's WIRE_ASYNC_BUSY until then). Don't touch Wire in the meantime; anything
+       * that would, other than asyncStatus(), waits for the transfer to finish first. */
+      uint8_t endTransmissionAsync(uint8_t sendStop = true, void (*callback)(uint8_t) = NULL);
+      uint8_t requestFromAsync(uint8_t address, uint8_t quantity, uint8_t sendStop = true, void (*callback)(uint8_t) = NULL);
+      uint8_t asyncStatus(void);
+      uint8_t readInto(uint8_t address, uint8_t *dst, uint8_t len, uint8_t sendStop = true);
+      uint8_t writeFrom(uint8_t address, const uint8_t *src, uint8_t len, uint8_t sendStop = true);
 
       inline size_t write(unsigned long n) { return write((uint8_t)n); }
       inline size_t write(long n) { return write((uint8_t)n); }
@@ -200,6 +242,8 @@
     void onReceive(void(*)(int));
     void onReceive( void (*)(size_t));
     void onRequest(void(*)(void));
+    uint8_t readInto(uint8_t address, uint8_t *dst, uint8_t len, uint8_t sendStop = true);
+    uint8_t writeFrom(uint8_t address, const uint8_t *src, uint8_t len, uint8_t sendStop = true);
 
     inline size_t write(unsigned long n) { return write((uint8_t)n); }
     inline size_t write(long n) { return write((uint8_t)n); }
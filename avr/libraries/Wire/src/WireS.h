@@ -45,7 +45,11 @@
 #include <inttypes.h>
 #include "Arduino.h"
 
-#define I2C_BUFFER_LENGTH 32
+#ifdef WIRE_BUFFER_SIZE
+  #define I2C_BUFFER_LENGTH WIRE_BUFFER_SIZE
+#else
+  #define I2C_BUFFER_LENGTH 32
+#endif
 
 #if defined(I2C_INTR_FLAG_PIN)
     #define I2C_INTR_FLAG_INIT do {             \
@@ -48,7 +48,8 @@ static volatile uint8_t twi_inRepStart;     // in the middle of a repeated start
 static void (*twi_onSlaveTransmit)(void);
 static void (*twi_onSlaveReceive)(uint8_t*, int);
 
-static uint8_t twi_masterBuffer[TWI_BUFFER_LENGTH];
+static uint8_t twi_masterBuffer[TWI_BUFFER_LENGTH]; // only for twi_writeTo() without wait
+static uint8_t * volatile twi_masterData; // the ISR reads and writes through this
 static volatile uint8_t twi_masterBufferIndex;
 static volatile uint8_t twi_masterBufferLength;
 
@@ -61,6 +62,17 @@ static volatile uint8_t twi_rxBufferIndex;
 
 static volatile uint8_t twi_error;
 
+// Transaction queue: twi_queue() is the only thing that moves the head, the ISR the only thing that moves the tail
+#define TWI_QUEUE_MASK (TWI_QUEUE_LENGTH - 1)
+static twi_segment_t twi_queueSegments[TWI_QUEUE_LENGTH];
+static void (*twi_queueCallbacks[TWI_QUEUE_LENGTH])(uint8_t);
+static volatile uint8_t twi_queueHead;
+static volatile uint8_t twi_queueTail;
+
+#if (TWI_QUEUE_LENGTH & TWI_QUEUE_MASK) || TWI_QUEUE_LENGTH < 2 || TWI_QUEUE_LENGTH > 128
+  #error "TWI_QUEUE_LENGTH must be a power of 2 from 2 to 128"
+#endif
+
 /*
  * Function twi_init
  * Desc     readys twi pins and sets twi bitrate
@@ -126,10 +138,193 @@ void twi_setFrequency(uint32_t frequency) {
   It is 72 for a 16mhz Wiring board with 100kHz TWI */
 }
 
+/*
+ * Function twi_errorCode
+ * Desc     turns what the ISR left in twi_error into the code twi_writeTo returns
+ * Input    error: twi_error
+ * Output   0 .. 4, as for twi_writeTo
+ */
+static uint8_t twi_errorCode(uint8_t error) {
+  if (error == 0xFF)
+    return 0; // success
+  else if (error == TW_MT_SLA_NACK || error == TW_MR_SLA_NACK)
+    return 2; // error: address send, nack received
+  else if (error == TW_MT_DATA_NACK)
+    return 3; // error: data send, nack received
+  else
+    return 4; // other twi error
+}
+
+/*
+ * Function twi_queueStart
+ * Desc     points the ISR at the segment at the tail of the queue, and
+ *          optionally sends the start condition for it
+ * Input    start: write TWCR to send a start condition
+ * Output   none
+ */
+static void twi_queueStart(uint8_t start) {
+  twi_segment_t *seg = &twi_queueSegments[twi_queueTail];
+  uint8_t length = seg->length;
+  twi_slarw = seg->address << 1;
+  if (seg->flags & TWI_SEG_READ) {
+    twi_slarw |= TW_READ;
+    length--; // NACK goes out with the last byte, as in twi_readFrom
+  }
+  twi_masterData = seg->data;
+  twi_masterBufferIndex = 0;
+  twi_masterBufferLength = length;
+  twi_error = 0xFF;
+  if (start) {
+    TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE) | _BV(TWSTA);
+  }
+}
+
+/*
+ * Function twi_queueKick
+ * Desc     starts on the queue if there's something in it and the
+ *          bus is ours to take (not in the middle of another transfer,
+ *          and not held for the repeated start of a blocking one)
+ * Input    none
+ * Output   none
+ */
+static void twi_queueKick(void) {
+  uint8_t oldSREG = SREG;
+  cli();
+  if (TWI_READY == twi_state && !twi_inRepStart && twi_queueHead != twi_queueTail) {
+    twi_state = TWI_MQ;
+    twi_queueStart(1);
+  }
+  SREG = oldSREG;
+}
+
+/*
+ * Function twi_queueRetire
+ * Desc     takes the current segment off the queue - and if it failed,
+ *          the rest of its sequence with it - and calls the callback if
+ *          that was the end of a sequence. Called from the ISR only.
+ * Input    error: twi_error for the segment (0xFF .. no error)
+ * Output   the flags of the last segment taken off
+ */
+static uint8_t twi_queueRetire(uint8_t error) {
+  uint8_t tail = twi_queueTail;
+  if (error != 0xFF) {
+    while (!(twi_queueSegments[tail].flags & TWI_SEG_END)) {
+      tail = (tail + 1) & TWI_QUEUE_MASK;
+    }
+  }
+  uint8_t flags = twi_queueSegments[tail].flags;
+  void (*callback)(uint8_t) = twi_queueCallbacks[tail];
+  twi_queueTail = (tail + 1) & TWI_QUEUE_MASK;
+  if ((flags & TWI_SEG_END) && callback) {
+    callback(twi_errorCode(error));
+  }
+  return flags;
+}
+
+/*
+ * Function twi_queueNext
+ * Desc     finishes the current segment and moves the bus on to the
+ *          next one: repeated start within a sequence, stop (and start,
+ *          if there is more) after one, or hands the bus back if that
+ *          was the last. Called from the ISR only.
+ * Input    error: twi_error for the segment (0xFF .. no error)
+ * Output   none
+ */
+static void twi_queueNext(uint8_t error) {
+  uint8_t flags = twi_queueRetire(error);
+  // the callback may have queued more, so only look now
+  uint8_t more = (twi_queueHead != twi_queueTail);
+  if (more) {
+    twi_queueStart(0);
+  }
+  if (error == TW_MT_ARB_LOST) {
+    // someone else has the bus, so no stop - start again once it's free
+    if (more) {
+      TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE) | _BV(TWSTA);
+    } else {
+      twi_releaseBus();
+    }
+  } else if (error != 0xFF || (flags & (TWI_SEG_STOP | TWI_SEG_END))) {
+    if (more) {
+      // TWSTO and TWSTA together send a stop then a start, without waiting here for the stop
+      TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE) | _BV(TWSTO) | _BV(TWSTA);
+    } else {
+      twi_stop();
+    }
+  } else {
+    // repeated start; a sequence always ends with TWI_SEG_END, so there is more
+    TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE) | _BV(TWSTA);
+  }
+}
+
+/*
+ * Function twi_queue
+ * Desc     adds a sequence of segments to the transaction queue, to be
+ *          run one after another from the ISR: repeated start between
+ *          segments (unless one has TWI_SEG_STOP), and a stop after the
+ *          last. If one fails, the rest of that sequence is skipped.
+ *          The segments are copied, but the data they point at is used
+ *          in place. May be called from the callback.
+ * Input    segments: array of segments
+ *          count: how many
+ *          callback: called from the ISR when the sequence is over, with
+ *          0 .. 4 as for twi_writeTo (2 for a read that was NACKed too);
+ *          may be NULL
+ * Output   0 .. queued
+ *          1 .. can never fit: count is 0 or too big for the queue, or a read has length 0
+ *          2 .. no room in the queue right now
+ */
+uint8_t twi_queue(const twi_segment_t* segments, uint8_t count, void (*callback)(uint8_t)) {
+  uint8_t i;
+  if (0 == count || count >= TWI_QUEUE_LENGTH) {
+    return 1;
+  }
+  for (i = 0; i < count; ++i) {
+    if ((segments[i].flags & TWI_SEG_READ) && 0 == segments[i].length) {
+      return 1;
+    }
+  }
+
+  uint8_t oldSREG = SREG;
+  cli();
+  uint8_t head = twi_queueHead;
+  if (count > ((twi_queueTail - head - 1) & TWI_QUEUE_MASK)) {
+    SREG = oldSREG;
+    return 2;
+  }
+  uint8_t last = head;
+  for (i = 0; i < count; ++i) {
+    twi_queueSegments[head] = segments[i];
+    twi_queueSegments[head].flags &= ~TWI_SEG_END;
+    twi_queueCallbacks[head] = NULL;
+    last = head;
+    head = (head + 1) & TWI_QUEUE_MASK;
+  }
+  twi_queueSegments[last].flags |= TWI_SEG_END;
+  twi_queueCallbacks[last] = callback;
+  twi_queueHead = head;
+  SREG = oldSREG;
+
+  // if the ISR is already working through the queue, it'll get to these
+  twi_queueKick();
+  return 0;
+}
+
+/*
+ * Function twi_queueSpace
+ * Desc     how many segments twi_queue could take right now
+ * Input    none
+ * Output   number of free slots
+ */
+uint8_t twi_queueSpace(void) {
+  return (twi_queueTail - twi_queueHead - 1) & TWI_QUEUE_MASK;
+}
+
 /*
  * Function twi_readFrom
  * Desc     attempts to become twi bus master and read a
- *          series of bytes from a device on the bus
+ *          series of bytes from a device on the bus,
+ *          straight into data
  * Input    address: 7bit i2c device address
  *          data: pointer to byte array
  *          length: number of bytes to read into array
@@ -137,10 +332,7 @@ void twi_setFrequency(uint32_t frequency) {
  * Output   number of bytes read
  */
 uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length, uint8_t sendStop) {
-  uint8_t i;
-
-  // ensure data will fit into buffer
-  if (TWI_BUFFER_LENGTH < length) {
+  if (0 == length) {
     return 0;
   }
 
@@ -150,6 +342,7 @@ uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length, uint8_t sen
   }
   twi_state = TWI_MRX;
   twi_sendStop = sendStop;
+  twi_masterData = data;
   // reset error state (0xFF.. no error occurred)
   twi_error = 0xFF;
 
@@ -191,10 +384,8 @@ uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length, uint8_t sen
   if (twi_masterBufferIndex < length)
     length = twi_masterBufferIndex;
 
-  // copy twi buffer to data
-  for (i = 0; i < length; ++i) {
-    data[i] = twi_masterBuffer[i];
-  }
+  // anything queued meanwhile (from an interrupt) can go now
+  twi_queueKick();
 
   return length;
 }
@@ -217,8 +408,8 @@ uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length, uint8_t sen
 uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint8_t length, uint8_t wait, uint8_t sendStop) {
   uint8_t i;
 
-  // ensure data will fit into buffer
-  if (TWI_BUFFER_LENGTH < length) {
+  // if we're not waiting, the data has to be copied somewhere it'll stay put - ensure it will fit
+  if (!wait && TWI_BUFFER_LENGTH < length) {
     return 1;
   }
 
@@ -235,9 +426,14 @@ uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint8_t length, uint8_t wait
   twi_masterBufferIndex = 0;
   twi_masterBufferLength = length;
 
-  // copy data to twi buffer
-  for (i = 0; i < length; ++i) {
-    twi_masterBuffer[i] = data[i];
+  // if we're waiting, send it from where it is, otherwise copy data to twi buffer
+  if (wait) {
+    twi_masterData = data;
+  } else {
+    for (i = 0; i < length; ++i) {
+      twi_masterBuffer[i] = data[i];
+    }
+    twi_masterData = twi_masterBuffer;
   }
 
   // build sla + w, slave device address + w bit
@@ -268,15 +464,11 @@ uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint8_t length, uint8_t wait
   while(wait && (TWI_MTX == twi_state)) {
     continue;
   }
+  if (wait) {
+    twi_queueKick();
+  }
 
-  if (twi_error == 0xFF)
-    return 0; // success
-  else if (twi_error == TW_MT_SLA_NACK)
-    return 2; // error: address send, nack received
-  else if (twi_error == TW_MT_DATA_NACK)
-    return 3; // error: data send, nack received
-  else
-    return 4; // other twi error
+  return twi_errorCode(twi_error);
 }
 
 /*
@@ -396,8 +588,10 @@ ISR(TWI_vect) {
       // if there is data to send, send it, otherwise stop
       if (twi_masterBufferIndex < twi_masterBufferLength) {
         // copy data to output register and ack
-        TWDR = twi_masterBuffer[twi_masterBufferIndex++];
+        TWDR = twi_masterData[twi_masterBufferIndex++];
         twi_reply(1);
+      }else if (TWI_MQ == twi_state) {
+        twi_queueNext(0xFF);
       }else{
   if (twi_sendStop)
           twi_stop();
@@ -413,21 +607,33 @@ ISR(TWI_vect) {
       break;
     case TW_MT_SLA_NACK:  // address sent, nack received
       twi_error = TW_MT_SLA_NACK;
-      twi_stop();
+      if (TWI_MQ == twi_state) {
+        twi_queueNext(TW_MT_SLA_NACK);
+      }else{
+        twi_stop();
+      }
       break;
     case TW_MT_DATA_NACK: // data sent, nack received
       twi_error = TW_MT_DATA_NACK;
-      twi_stop();
+      if (TWI_MQ == twi_state) {
+        twi_queueNext(TW_MT_DATA_NACK);
+      }else{
+        twi_stop();
+      }
       break;
     case TW_MT_ARB_LOST: // lost bus arbitration
       twi_error = TW_MT_ARB_LOST;
-      twi_releaseBus();
+      if (TWI_MQ == twi_state) {
+        twi_queueNext(TW_MT_ARB_LOST);
+      }else{
+        twi_releaseBus();
+      }
       break;
 
     // Master Receiver
     case TW_MR_DATA_ACK: // data received, ack sent
       // put byte into buffer
-      twi_masterBuffer[twi_masterBufferIndex++] = TWDR;
+      twi_masterData[twi_masterBufferIndex++] = TWDR;
     case TW_MR_SLA_ACK:  // address sent, ack received
       // ack if more bytes are expected, otherwise nack
       if (twi_masterBufferIndex < twi_masterBufferLength) {
@@ -438,8 +644,10 @@ ISR(TWI_vect) {
       break;
     case TW_MR_DATA_NACK: // data received, nack sent
       // put final byte into buffer
-      twi_masterBuffer[twi_masterBufferIndex++] = TWDR;
-  if (twi_sendStop)
+      twi_masterData[twi_masterBufferIndex++] = TWDR;
+  if (TWI_MQ == twi_state)
+          twi_queueNext(0xFF);
+  else if (twi_sendStop)
           twi_stop();
   else {
     twi_inRepStart = true;  // we're going to send the START
@@ -451,7 +659,12 @@ ISR(TWI_vect) {
   }
   break;
     case TW_MR_SLA_NACK: // address sent, nack received
-      twi_stop();
+      twi_error = TW_MR_SLA_NACK;
+      if (TWI_MQ == twi_state) {
+        twi_queueNext(TW_MR_SLA_NACK);
+      }else{
+        twi_stop();
+      }
       break;
     // TW_MR_ARB_LOST handled by TW_MT_ARB_LOST case
 
@@ -460,6 +673,10 @@ ISR(TWI_vect) {
     case TW_SR_GCALL_ACK: // addressed generally, returned ack
     case TW_SR_ARB_LOST_SLA_ACK:   // lost arbitration, returned ack
     case TW_SR_ARB_LOST_GCALL_ACK: // lost arbitration, returned ack
+      // if that was a queued segment, that sequence is over; the rest waits until we're done here
+      if (TWI_MQ == twi_state) {
+        twi_queueRetire(TW_MT_ARB_LOST);
+      }
       // enter slave receiver mode
       twi_state = TWI_SRX;
       // indicate that rx buffer can be overwritten and ack
@@ -489,6 +706,7 @@ ISR(TWI_vect) {
       twi_onSlaveReceive(twi_rxBuffer, twi_rxBufferIndex);
       // since we submit rx buffer to "wire" library, we can reset it
       twi_rxBufferIndex = 0;
+      twi_queueKick();
       break;
     case TW_SR_DATA_NACK:       // data received, returned nack
     case TW_SR_GCALL_DATA_NACK: // data received generally, returned nack
@@ -499,6 +717,9 @@ ISR(TWI_vect) {
     // Slave Transmitter
     case TW_ST_SLA_ACK:          // addressed, returned ack
     case TW_ST_ARB_LOST_SLA_ACK: // arbitration lost, returned ack
+      if (TWI_MQ == twi_state) {
+        twi_queueRetire(TW_MT_ARB_LOST);
+      }
       // enter slave transmitter mode
       twi_state = TWI_STX;
       // ready the tx buffer index for iteration
@@ -530,6 +751,7 @@ ISR(TWI_vect) {
       twi_reply(1);
       // leave slave receiver state
       twi_state = TWI_READY;
+      twi_queueKick();
       break;
 
     // All
@@ -537,7 +759,11 @@ ISR(TWI_vect) {
       break;
     case TW_BUS_ERROR: // bus error, illegal stop/start
       twi_error = TW_BUS_ERROR;
-      twi_stop();
+      if (TWI_MQ == twi_state) {
+        twi_queueNext(TW_BUS_ERROR);
+      }else{
+        twi_stop();
+      }
       break;
   }
 }
@@ -29,7 +29,11 @@
   #endif
 
   #ifndef TWI_BUFFER_LENGTH
-  #define TWI_BUFFER_LENGTH 32
+    #ifdef WIRE_BUFFER_SIZE
+      #define TWI_BUFFER_LENGTH WIRE_BUFFER_SIZE
+    #else
+      #define TWI_BUFFER_LENGTH 32
+    #endif
   #endif
 
   #define TWI_READY 0
@@ -37,6 +41,30 @@
   #define TWI_MTX   2
   #define TWI_SRX   3
   #define TWI_STX   4
+  #define TWI_MQ    5
+
+  // Number of segments the transaction queue can hold, a power of 2 (one slot is always left empty)
+  #ifndef TWI_QUEUE_LENGTH
+  #define TWI_QUEUE_LENGTH 8
+  #endif
+
+  #define TWI_SEG_READ  0x01  // read length bytes into data, rather than writing them from it
+  #define TWI_SEG_STOP  0x02  // send a stop after this segment instead of a repeated start
+  #define TWI_SEG_END   0x80  // last segment of a twi_queue() call - set by twi_queue(), not by you
+
+  /* One segment (address, then bytes in one direction) of a queued transaction. The data is
+   * read from or written to the buffer in place, from the ISR, so it must stay valid (and
+   * for a read, untouched) until the callback for that sequence has been called. */
+  typedef struct {
+    uint8_t address;  // 7-bit address
+    uint8_t flags;    // TWI_SEG_READ and/or TWI_SEG_STOP
+    uint8_t length;   // for a read, must not be 0
+    uint8_t *data;
+  } twi_segment_t;
+
+  #ifdef __cplusplus
+  extern "C" {
+  #endif
 
   void twi_init(void);
   void twi_disable(void);
@@ -50,6 +78,12 @@
   void twi_reply(uint8_t);
   void twi_stop(void);
   void twi_releaseBus(void);
+  uint8_t twi_queue(const twi_segment_t*, uint8_t, void (*)(uint8_t));
+  uint8_t twi_queueSpace(void);
+
+  #ifdef __cplusplus
+  }
+  #endif
 
 #endif
 #endif